@@ -0,0 +1,184 @@
+/**
+ * Host (Linux) stand-in for the Arduino core.
+ *
+ * Provides just enough of the AVR Arduino API for the DW1000-ng library and
+ * the firmware in src/ to compile natively. Timing comes from the host
+ * monotonic clock, pin state is kept in memory, and attachInterrupt() wires
+ * the IRQ line of the emulated DW1000 (see DW1000Emulator.hpp).
+ *
+ * Only used by the native_* PlatformIO environments.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+// Arduino Uno pin map
+#define SS   10
+#define MOSI 11
+#define MISO 12
+#define SCK  13
+#define LED_BUILTIN 13
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define snprintf_P snprintf
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+/* Time */
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+/* Digital I/O */
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+/* Interrupts */
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void interrupts();
+void noInterrupts();
+
+/* AVR status register, only its global interrupt enable bit (7) is kept */
+struct HostStatusRegister {
+    operator uint8_t() const;
+    HostStatusRegister &operator=(uint8_t value);
+};
+extern HostStatusRegister SREG;
+inline void cli() { noInterrupts(); }
+inline void sei() { interrupts(); }
+
+/* Math helpers (templates rather than the AVR macros so the STL still compiles) */
+template<typename T, typename U> inline T min(T a, U b) { return (b < a) ? b : a; }
+template<typename T, typename U> inline T max(T a, U b) { return (a < b) ? b : a; }
+template<typename T, typename U, typename V> inline T constrain(T x, U lo, V hi) {
+    return x < lo ? lo : (x > hi ? hi : x);
+}
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+inline void randomSeed(unsigned long seed) { if (seed != 0) srand((unsigned)seed); }
+inline long random(long howBig) { return howBig <= 0 ? 0 : rand() % howBig; }
+inline long random(long howSmall, long howBig) {
+    return howSmall >= howBig ? howSmall : howSmall + random(howBig - howSmall);
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout);
+
+/**
+ * Minimal WString replacement: only what DW1000-ng touches.
+ */
+class String {
+public:
+    String(const char *cstr = "") : _s(cstr) {}
+    String(const std::string &s) : _s(s) {}
+
+    unsigned int length() const { return _s.length(); }
+    const char *c_str() const { return _s.c_str(); }
+    void remove(unsigned int index) { if (index < _s.length()) _s.erase(index); }
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const {
+        if (bufsize == 0) return;
+        unsigned int n = 0;
+        for (; n + 1 < bufsize && index + n < _s.length(); n++) buf[n] = _s[index + n];
+        buf[n] = 0;
+    }
+
+    String &operator=(const char *cstr) { _s = cstr; return *this; }
+    String &operator+=(char c) { _s += c; return *this; }
+    String &operator+=(const char *cstr) { _s += cstr; return *this; }
+    String &operator+=(const String &rhs) { _s += rhs._s; return *this; }
+
+private:
+    std::string _s;
+};
+
+/**
+ * Print/Serial on stdout.
+ */
+class HardwareSerial {
+public:
+    void begin(unsigned long) {}
+    void end() {}
+    int available() { return 0; }
+    int read() { return -1; }
+    void flush();
+    operator bool() const { return true; }
+
+    size_t write(uint8_t c);
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const String &s);
+    size_t print(const char s[]);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(long long n, int base = DEC);
+    size_t print(unsigned long long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println();
+    template<typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template<typename T> size_t println(T v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+};
+
+extern HardwareSerial Serial;
+
+/* Sketch entry points, defined by the firmware */
+void setup();
+void loop();
+
+#endif // HOST_ARDUINO_H
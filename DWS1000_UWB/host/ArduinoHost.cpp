@@ -0,0 +1,197 @@
+/**
+ * Host (Linux) implementation of the Arduino core subset declared in
+ * Arduino.h and SPI.h, plus the sketch main().
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include "DW1000Emulator.hpp"
+
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+namespace {
+
+    uint8_t _pinLevel[32];
+
+    uint64_t _monotonicUs() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+    }
+
+    const uint64_t _bootUs = _monotonicUs();
+
+    volatile sig_atomic_t _stopRequested = 0;
+
+    /* First SIGINT/SIGTERM ends the loop so atexit() handlers (SPI profile
+     * dump) run; a second one exits immediately. */
+    void _onStopSignal(int) {
+        if(_stopRequested)
+            _exit(1);
+        _stopRequested = 1;
+    }
+
+    size_t _printNumber(unsigned long long n, int base) {
+        char buf[8 * sizeof(n) + 1];
+        char *p = &buf[sizeof(buf) - 1];
+        *p = '\0';
+        if(base < 2) base = 10;
+        do {
+            unsigned digit = n % base;
+            *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+            n /= base;
+        } while(n);
+        return fputs(p, stdout) >= 0 ? strlen(p) : 0;
+    }
+
+    size_t _printSigned(long long n, int base) {
+        if(base == 10 && n < 0) {
+            putchar('-');
+            return 1 + _printNumber(-(unsigned long long)n, base);
+        }
+        return _printNumber((unsigned long long)n, base);
+    }
+
+}
+
+/* Time */
+
+unsigned long millis() {
+    return (unsigned long)((_monotonicUs() - _bootUs) / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)(_monotonicUs() - _bootUs);
+}
+
+void delay(unsigned long ms) {
+    uint64_t until = _monotonicUs() + ms * 1000ULL;
+    while(_monotonicUs() < until) {
+        yield();
+        sched_yield();
+    }
+}
+
+void delayMicroseconds(unsigned int us) {
+    uint64_t until = _monotonicUs() + us;
+    while(_monotonicUs() < until) {
+    }
+}
+
+void yield() {
+    DW1000Emulator::poll();
+}
+
+/* Digital I/O */
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    if(pin < sizeof(_pinLevel) && mode == INPUT_PULLUP)
+        _pinLevel[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    if(pin < sizeof(_pinLevel))
+        _pinLevel[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < sizeof(_pinLevel) ? _pinLevel[pin] : LOW;
+}
+
+/* Interrupts: the only interrupt source on the host is the emulated DW1000 IRQ line */
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode) {
+    (void)interruptNum;
+    (void)mode;
+    DW1000Emulator::setIrqHandler(userFunc);
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+    (void)interruptNum;
+    DW1000Emulator::setIrqHandler(nullptr);
+}
+
+void interrupts() {
+    DW1000Emulator::setInterruptsEnabled(true);
+}
+
+void noInterrupts() {
+    DW1000Emulator::setInterruptsEnabled(false);
+}
+
+HostStatusRegister SREG;
+
+HostStatusRegister::operator uint8_t() const {
+    return DW1000Emulator::getInterruptsEnabled() ? 0x80 : 0x00;
+}
+
+HostStatusRegister &HostStatusRegister::operator=(uint8_t value) {
+    DW1000Emulator::setInterruptsEnabled((value & 0x80) != 0);
+    return *this;
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *sout) {
+    sprintf(sout, "%*.*f", width, prec, val);
+    return sout;
+}
+
+/* SPI */
+
+void SPIClass::beginTransaction(SPISettings settings) {
+    (void)settings;
+    DW1000Emulator::select();
+}
+
+void SPIClass::endTransaction() {
+    DW1000Emulator::deselect();
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+    return DW1000Emulator::transfer(data);
+}
+
+void SPIClass::transfer(void *buf, size_t count) {
+    uint8_t *p = (uint8_t *)buf;
+    for(size_t i = 0; i < count; i++)
+        p[i] = DW1000Emulator::transfer(p[i]);
+}
+
+/* Serial */
+
+void HardwareSerial::flush() { fflush(stdout); }
+size_t HardwareSerial::write(uint8_t c) { putchar(c); return 1; }
+size_t HardwareSerial::print(const __FlashStringHelper *s) { return print(reinterpret_cast<const char *>(s)); }
+size_t HardwareSerial::print(const String &s) { return print(s.c_str()); }
+size_t HardwareSerial::print(const char s[]) { fputs(s, stdout); return strlen(s); }
+size_t HardwareSerial::print(char c) { return write((uint8_t)c); }
+size_t HardwareSerial::print(unsigned char n, int base) { return _printNumber(n, base); }
+size_t HardwareSerial::print(int n, int base) { return _printSigned(n, base); }
+size_t HardwareSerial::print(unsigned int n, int base) { return _printNumber(n, base); }
+size_t HardwareSerial::print(long n, int base) { return _printSigned(n, base); }
+size_t HardwareSerial::print(unsigned long n, int base) { return _printNumber(n, base); }
+size_t HardwareSerial::print(long long n, int base) { return _printSigned(n, base); }
+size_t HardwareSerial::print(unsigned long long n, int base) { return _printNumber(n, base); }
+size_t HardwareSerial::print(double n, int digits) { return printf("%.*f", digits, n); }
+size_t HardwareSerial::println() { putchar('\n'); fflush(stdout); return 1; }
+
+/* Sketch entry, same shape as the Arduino core main() */
+
+int main() {
+    signal(SIGINT, _onStopSignal);
+    signal(SIGTERM, _onStopSignal);
+    setup();
+    while(!_stopRequested) {
+        loop();
+        yield();
+        // lets the other radios' processes run when there are more than cores
+        sched_yield();
+    }
+    fflush(stdout);
+    return 0;
+}
@@ -0,0 +1,727 @@
+/**
+ * DW1000 register-level emulator for host builds, see DW1000Emulator.hpp.
+ */
+
+#include "DW1000Emulator.hpp"
+
+#include <Arduino.h>
+#include <DW1000NgRegisters.hpp>
+#include <DW1000NgConstants.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <vector>
+
+namespace DW1000Emulator {
+
+    namespace {
+
+        constexpr uint64_t TIME_MASK = 0xFFFFFFFFFFULL;
+        constexpr uint64_t SYS_TIME_MASK = TIME_MASK & ~0x1FFULL;
+        constexpr uint32_t FRAME_MAGIC = 0x4D455744; // "DWEM"
+        constexpr const char *MEDIUM_GROUP = "239.255.77.1";
+        constexpr uint16_t MAX_FRAME_LEN = 1023;
+        constexpr uint32_t DEVICE_ID = 0xDECA0130;
+
+        /* SYS_STATUS bit groups raised by the radio model */
+        constexpr uint32_t STATUS_TX_DONE = (1UL << TXFRB_BIT) | (1UL << TXPRS_BIT) | (1UL << TXPHS_BIT) | (1UL << TXFRS_BIT);
+        constexpr uint32_t STATUS_RX_GOOD = (1UL << RXPRD_BIT) | (1UL << RXSFDD_BIT) | (1UL << LDEDONE_BIT)
+                                          | (1UL << RXPHD_BIT) | (1UL << RXDFR_BIT) | (1UL << RXFCG_BIT);
+        constexpr uint32_t HPDWARN = 1UL << 27;
+        /* RX events that belong to a receive buffer and swing with it in double buffered mode */
+        constexpr uint32_t STATUS_RX_SWING = STATUS_RX_GOOD | (1UL << RXPHE_BIT) | (1UL << RXFCE_BIT)
+                                           | (1UL << RXRFSL_BIT) | (1UL << LDEERR_BIT);
+        /* buffer pointers, not cleared by writing one */
+        constexpr uint32_t STATUS_READ_ONLY = (1UL << HSRBP_BIT) | (1UL << ICRBP_BIT);
+        /* registers of a receive buffer (swing set) */
+        constexpr uint8_t RX_SWING_REGS[] = { RX_FINFO, RX_BUFFER, RX_FQUAL, RX_TIME };
+
+        /* A frame heard on the medium, times in global ticks */
+        struct AirFrame {
+            uint64_t preambleStart;
+            uint64_t rmarker;
+            uint64_t end;
+            uint16_t psr;
+            uint8_t dataRate;
+            uint8_t prf;
+            uint16_t len; // incl. 2 byte FCS
+            int32_t driftPpb; // crystal offset of the sender
+            double distance;  // from the sender (m)
+            bool collided;
+            byte data[MAX_FRAME_LEN];
+        };
+
+        struct PendingTx {
+            bool active;
+            bool sent;
+            uint64_t preambleStart;
+            uint64_t rmarker;
+            uint64_t end;
+            bool wait4resp;
+            AirFrame frame;
+        };
+
+        std::vector<byte> _regs[0x40];
+
+        /* SPI transaction state */
+        bool _selected = false;
+        byte _header[3];
+        uint8_t _headerLen = 0;
+        bool _headerDone = false;
+        bool _isWrite = false;
+        uint8_t _reg = 0;
+        uint16_t _sub = 0;
+        uint16_t _pos = 0;
+        std::vector<byte> _writeData;
+        uint32_t _transactions = 0;
+        uint32_t _bytes = 0;
+
+        /* radio state */
+        PendingTx _tx;
+        bool _rxOn = false;
+        uint64_t _rxOnSince = 0;
+        uint64_t _rxOnAt = 0;
+        uint64_t _rxTimeoutAt = 0;
+        std::vector<AirFrame> _air;
+
+        /* double buffering: the swing set the host side pointer does not select */
+        std::vector<byte> _rxSpare[sizeof(RX_SWING_REGS)];
+        uint32_t _rxSpareStatus = 0;
+
+        /* IRQ state */
+        void (*_irqHandler)(void) = nullptr;
+        bool _irqLine = false;
+        bool _irqPending = false;
+        bool _inIsr = false;
+        bool _interruptsEnabled = true;
+        bool _polling = false;
+
+        /* node parameters */
+        bool _started = false;
+        uint32_t _nodeId;
+        uint64_t _clockOffset;
+        uint32_t _partId;
+        uint32_t _lotId;
+        double _driftPpm = 0.0;
+        double _distance = 1.0;
+        bool _positioned = false;
+        double _position[3] = {0.0, 0.0, 0.0};
+        double _loss = 0.0;
+        uint64_t _antennaDelay = 16436;
+        uint16_t _port = 47000;
+        int _sock = -1;
+        sockaddr_in _group;
+
+        double _envDouble(const char *name, double fallback) {
+            const char *v = getenv(name);
+            return v != nullptr ? atof(v) : fallback;
+        }
+
+        /* 63.8976 GHz ticks since the host monotonic epoch, shared by every process */
+        uint64_t _globalNow() {
+            timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+            return ns * 63 + (ns * 8976) / 10000;
+        }
+
+        uint64_t _nsToTicks(double ns) {
+            return (uint64_t)(ns * 63.8976);
+        }
+
+        uint64_t _toLocal(uint64_t global) {
+            double drift = (double)global * _driftPpm * 1e-6;
+            return (global + _clockOffset + (int64_t)drift) & TIME_MASK;
+        }
+
+        /* next global instant at which the local clock reads 'local' */
+        uint64_t _toGlobal(uint64_t local) {
+            uint64_t now = _globalNow();
+            uint64_t ahead = (local - _toLocal(now)) & TIME_MASK;
+            return now + (uint64_t)((double)ahead / (1.0 + _driftPpm * 1e-6));
+        }
+
+        uint64_t _regValue(uint8_t reg, uint16_t sub, uint8_t len) {
+            uint64_t v = 0;
+            for(uint8_t i = 0; i < len; i++) {
+                uint16_t idx = sub + i;
+                byte b = idx < _regs[reg].size() ? _regs[reg][idx] : 0;
+                v |= (uint64_t)b << (8 * i);
+            }
+            return v;
+        }
+
+        void _setRegValue(uint8_t reg, uint16_t sub, uint64_t v, uint8_t len) {
+            if(_regs[reg].size() < (size_t)(sub + len))
+                _regs[reg].resize(sub + len, 0);
+            for(uint8_t i = 0; i < len; i++)
+                _regs[reg][sub + i] = (byte)(v >> (8 * i));
+        }
+
+        uint32_t _status() {
+            return (uint32_t)_regValue(SYS_STATUS, 0, 4);
+        }
+
+        void _updateIrqLine() {
+            uint32_t mask = (uint32_t)_regValue(SYS_MASK, 0, 4);
+            bool line = (_status() & mask) != 0;
+            if(line && !_irqLine)
+                _irqPending = true;
+            _irqLine = line;
+        }
+
+        void _raiseStatus(uint32_t bits) {
+            _setRegValue(SYS_STATUS, 0, _status() | bits, 4);
+            _updateIrqLine();
+        }
+
+        bool _sysCfgBit(uint8_t bit) {
+            return (_regValue(SYS_CFG, 0, 4) >> bit) & 1;
+        }
+
+        /* Preamble symbol repetitions from the TXPSR/PE fields of TX_FCTRL */
+        /* TX_FCTRL bits 18-21: TXPSR in the low two bits, PE above them */
+        uint16_t _preambleSymbols(uint8_t psrPe) {
+            switch(psrPe) {
+                case 0x1: return 64;
+                case 0x5: return 128;
+                case 0x9: return 256;
+                case 0xD: return 512;
+                case 0x2: return 1024;
+                case 0x6: return 1536;
+                case 0xA: return 2048;
+                default:  return 4096;
+            }
+        }
+
+        /* Frame timing (IEEE 802.15.4a UWB PHY): preamble + SFD, then PHR and Reed-Solomon coded payload */
+        void _frameTiming(AirFrame &f, uint64_t &preambleTicks, uint64_t &payloadTicks) {
+            double symbolNs = f.prf == 2 ? 1017.63 : 993.59;
+            double sfdSymbols = f.dataRate == 0 ? 64.0 : 8.0;
+            double bitNs = f.dataRate == 0 ? 8205.13 : (f.dataRate == 1 ? 1025.64 : 128.21);
+            double phrBitNs = f.dataRate == 0 ? 8205.13 : 1025.64;
+            double payloadBits = f.len * 8.0 * (1.0 + 48.0 / 330.0);
+            preambleTicks = _nsToTicks((f.psr + sfdSymbols) * symbolNs);
+            payloadTicks = _nsToTicks(21.0 * phrBitNs + payloadBits * bitNs);
+        }
+
+        void _openMedium() {
+            _sock = socket(AF_INET, SOCK_DGRAM, 0);
+            if(_sock < 0)
+                return;
+            int one = 1;
+            setsockopt(_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            setsockopt(_sock, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+
+            sockaddr_in addr;
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(_port);
+            addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            if(bind(_sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+                close(_sock);
+                _sock = -1;
+                return;
+            }
+
+            ip_mreq mreq;
+            mreq.imr_multiaddr.s_addr = inet_addr(MEDIUM_GROUP);
+            mreq.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+            setsockopt(_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+            in_addr loopback;
+            loopback.s_addr = htonl(INADDR_LOOPBACK);
+            setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+            setsockopt(_sock, IPPROTO_IP, IP_MULTICAST_LOOP, &one, sizeof(one));
+            fcntl(_sock, F_SETFL, fcntl(_sock, F_GETFL) | O_NONBLOCK);
+
+            memset(&_group, 0, sizeof(_group));
+            _group.sin_family = AF_INET;
+            _group.sin_port = htons(_port);
+            _group.sin_addr.s_addr = inet_addr(MEDIUM_GROUP);
+        }
+
+        void _powerOnReset() {
+            for(auto &r : _regs)
+                r.clear();
+            _setRegValue(DEV_ID, 0, DEVICE_ID, 4);
+            _setRegValue(PANADR, 0, 0xFFFFFFFF, 4);
+            _setRegValue(SYS_CFG, 0, 0x00001200, 4);
+            _setRegValue(TX_FCTRL, 0, 0x0015400C, 5);
+            _setRegValue(CHAN_CTRL, 0, 0x00004455, 4);
+            _setRegValue(SYS_STATUS, 0, 1UL << CPLOCK_BIT, 5);
+            _regs[TX_BUFFER].resize(LEN_TX_BUFFER, 0);
+            _regs[RX_BUFFER].resize(LEN_RX_BUFFER, 0);
+            for(auto &r : _rxSpare)
+                r.clear();
+            _rxSpare[1].resize(LEN_RX_BUFFER, 0);
+            _rxSpareStatus = 0;
+        }
+
+        void _start() {
+            _started = true;
+            _nodeId = ((uint32_t)getpid() << 8) ^ (uint32_t)_globalNow();
+            srand(_nodeId);
+            _clockOffset = (((uint64_t)rand() << 20) ^ (uint64_t)rand()) & TIME_MASK;
+            _partId = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+            _lotId = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+            _driftPpm = _envDouble("DW1000_EMU_DRIFT_PPM", 0.0);
+            _distance = _envDouble("DW1000_EMU_DISTANCE", 1.0);
+            const char *position = getenv("DW1000_EMU_POSITION");
+            _positioned = position != nullptr &&
+                sscanf(position, "%lf,%lf,%lf", &_position[0], &_position[1], &_position[2]) >= 2;
+            _loss = _envDouble("DW1000_EMU_LOSS", 0.0);
+            _antennaDelay = (uint64_t)_envDouble("DW1000_EMU_ANTENNA_DELAY", 16436);
+            _port = (uint16_t)_envDouble("DW1000_EMU_PORT", 47000);
+            _powerOnReset();
+            _openMedium();
+        }
+
+        /* ---- radio model ---- */
+
+        void _startTransmit(bool delayed, bool wait4resp) {
+            uint64_t txfctrl = _regValue(TX_FCTRL, 0, 5);
+            AirFrame &f = _tx.frame;
+            f.len = txfctrl & 0x3FF;
+            if(f.len > MAX_FRAME_LEN)
+                f.len = MAX_FRAME_LEN;
+            uint16_t txBufferOffset = (txfctrl >> 22) & 0x3FF;  // TXBOFFS
+            if(txBufferOffset + f.len > LEN_TX_BUFFER)
+                f.len = LEN_TX_BUFFER - txBufferOffset;
+            f.dataRate = (txfctrl >> 13) & 0x3;
+            f.prf = (txfctrl >> 16) & 0x3;
+            f.psr = _preambleSymbols((txfctrl >> 18) & 0xF);
+            f.collided = false;
+            memcpy(f.data, _regs[TX_BUFFER].data() + txBufferOffset, f.len);
+
+            uint64_t preambleTicks, payloadTicks;
+            _frameTiming(f, preambleTicks, payloadTicks);
+
+            uint64_t now = _globalNow();
+            uint64_t rmarker = now + preambleTicks;
+            if(delayed) {
+                uint64_t target = _toGlobal(_regValue(DX_TIME, 0, 5) & SYS_TIME_MASK);
+                if(target - preambleTicks >= now && target - now < (TIME_MASK >> 1)) {
+                    rmarker = target;
+                } else {
+                    /* too late: like the silicon, flag it and wait for the slot in the next counter period */
+                    rmarker = target + TIME_MASK + 1;
+                    _raiseStatus(HPDWARN);
+                }
+            }
+
+            _rxOn = false;
+            _tx.active = true;
+            _tx.sent = false;
+            _tx.wait4resp = wait4resp;
+            _tx.preambleStart = rmarker - preambleTicks;
+            _tx.rmarker = rmarker;
+            _tx.end = rmarker + payloadTicks;
+        }
+
+        void _enableReceiver(uint64_t at) {
+            _rxOn = true;
+            _rxOnSince = at;
+            _rxTimeoutAt = 0;
+            if(_sysCfgBit(RXWTOE_BIT)) {
+                /* RX_WFTO counts in units of 512/499.2 MHz ~= 1.026 us */
+                uint64_t units = _regValue(RX_WFTO, 0, LEN_RX_WFTO);
+                _rxTimeoutAt = at + units * 65536ULL;
+            }
+        }
+
+        bool _doubleBuffered() {
+            return !_sysCfgBit(DIS_DRXB_BIT);
+        }
+
+        /* exchanges the host side swing set with the other one, RX status bits included */
+        void _swapSwingSets() {
+            uint32_t status = _status();
+            _setRegValue(SYS_STATUS, 0, (status & ~STATUS_RX_SWING) | _rxSpareStatus, 4);
+            _rxSpareStatus = status & STATUS_RX_SWING;
+            for(uint8_t i = 0; i < sizeof(RX_SWING_REGS); i++)
+                _regs[RX_SWING_REGS[i]].swap(_rxSpare[i]);
+        }
+
+        void _handleSystemControl() {
+            uint32_t ctrl = (uint32_t)_regValue(SYS_CTRL, 0, 4);
+            if(ctrl & (1UL << TRXOFF_BIT)) {
+                _tx.active = false;
+                _rxOn = false;
+                _rxOnAt = 0;
+                _rxTimeoutAt = 0;
+            }
+            if(ctrl & (1UL << TXSTRT_BIT)) {
+                _startTransmit(ctrl & (1UL << TXDLYS_BIT), ctrl & (1UL << WAIT4RESP_BIT));
+            }
+            if(ctrl & (1UL << HRBPT_BIT)) {
+                _swapSwingSets();
+                _setRegValue(SYS_STATUS, 0, _status() ^ (1UL << HSRBP_BIT), 4);
+                _updateIrqLine();
+            }
+            if(ctrl & (1UL << RXENAB_BIT)) {
+                if(ctrl & (1UL << RXDLYS_BIT))
+                    _rxOnAt = _toGlobal(_regValue(DX_TIME, 0, 5) & SYS_TIME_MASK);
+                else
+                    _enableReceiver(_globalNow());
+            }
+            /* command bits are self clearing */
+            ctrl &= ~((1UL << SFCST_BIT) | (1UL << TXSTRT_BIT) | (1UL << TXDLYS_BIT) | (1UL << TRXOFF_BIT)
+                    | (1UL << WAIT4RESP_BIT) | (1UL << RXENAB_BIT) | (1UL << RXDLYS_BIT) | (1UL << HRBPT_BIT));
+            _setRegValue(SYS_CTRL, 0, ctrl, 4);
+        }
+
+        void _sendToMedium(const AirFrame &f, uint64_t rmarker, uint64_t preambleTicks, uint64_t payloadTicks) {
+            if(_sock < 0)
+                return;
+            byte pkt[32 + MAX_FRAME_LEN];
+            uint16_t n = 0;
+            auto put = [&](uint64_t v, uint8_t len) {
+                for(uint8_t i = 0; i < len; i++)
+                    pkt[n++] = (byte)(v >> (8 * i));
+            };
+            put(FRAME_MAGIC, 4);
+            put(_nodeId, 4);
+            put(rmarker, 8);
+            put(preambleTicks, 4);
+            put(payloadTicks, 4);
+            put(f.psr, 2);
+            put(f.dataRate, 1);
+            put(f.prf, 1);
+            put(f.len, 2);
+            put((uint32_t)(int32_t)lround(_driftPpm * 1000.0), 4);
+            put(_positioned, 1);
+            for(uint8_t axis = 0; axis < 3; axis++)
+                put((uint32_t)(int32_t)lround(_position[axis] * 1000.0), 4);
+            memcpy(pkt + n, f.data, f.len);
+            n += f.len;
+            sendto(_sock, pkt, n, 0, (sockaddr *)&_group, sizeof(_group));
+        }
+
+        void _receiveFromMedium() {
+            if(_sock < 0)
+                return;
+            byte pkt[32 + MAX_FRAME_LEN];
+            for(;;) {
+                ssize_t n = recv(_sock, pkt, sizeof(pkt), 0);
+                if(n < 47)
+                    return;
+                uint16_t i = 0;
+                auto get = [&](uint8_t len) {
+                    uint64_t v = 0;
+                    for(uint8_t b = 0; b < len; b++)
+                        v |= (uint64_t)pkt[i++] << (8 * b);
+                    return v;
+                };
+                if(get(4) != FRAME_MAGIC || get(4) == _nodeId)
+                    continue;
+                if(_loss > 0.0 && (double)rand() / RAND_MAX < _loss)
+                    continue;
+
+                AirFrame f;
+                uint64_t rmarker = get(8);
+                uint64_t preambleTicks = get(4);
+                uint64_t payloadTicks = get(4);
+                f.psr = get(2);
+                f.dataRate = get(1);
+                f.prf = get(1);
+                f.len = get(2);
+                f.driftPpb = (int32_t)get(4);
+                /* both ends placed: the distance between them, else ours to everyone */
+                bool senderPositioned = get(1) != 0;
+                double squares = 0.0;
+                for(uint8_t axis = 0; axis < 3; axis++) {
+                    double delta = (int32_t)get(4) / 1000.0 - _position[axis];
+                    squares += delta * delta;
+                }
+                f.distance = senderPositioned && _positioned ? sqrt(squares) : _distance;
+                uint64_t tof = (uint64_t)(f.distance / DISTANCE_OF_RADIO);
+                f.rmarker = rmarker + tof + _antennaDelay;
+                f.preambleStart = f.rmarker - preambleTicks;
+                f.end = f.rmarker + payloadTicks;
+                if(f.len > n - i)
+                    continue;
+                memcpy(f.data, pkt + i, f.len);
+                f.collided = false;
+
+                /* overlapping frames destroy each other at this receiver */
+                for(auto &other : _air) {
+                    if(f.preambleStart < other.end && other.preambleStart < f.end) {
+                        other.collided = true;
+                        f.collided = true;
+                    }
+                }
+                _air.push_back(f);
+            }
+        }
+
+        void _writeReceiveRegisters(const AirFrame &f) {
+            memcpy(_regs[RX_BUFFER].data(), f.data, f.len);
+
+            /* RXPACC roughly the preamble length minus acquisition, used by the power estimates */
+            uint32_t rxpacc = f.psr - f.psr / 10;
+            uint32_t psrBits = f.psr <= 512 ? 1 : (f.psr <= 2048 ? 2 : 3);
+            uint32_t finfo = (f.len & 0x3FF) | ((uint32_t)f.dataRate << 13) | ((uint32_t)f.prf << 16)
+                           | (psrBits << 18) | (rxpacc << 20);
+            _setRegValue(RX_FINFO, 0, finfo, LEN_RX_FINFO);
+
+            uint64_t local = _toLocal(f.rmarker);
+            uint64_t rxAntennaDelay = _regValue(LDE_IF, LDE_RXANTD_SUB, LEN_LDE_RXANTD);
+            _setRegValue(RX_TIME, RX_STAMP_SUB, (local - rxAntennaDelay) & TIME_MASK, 5);
+            _setRegValue(RX_TIME, 0x09, local, 5); // RX_RAWST
+
+            /* DRX_CAR_INT: the sender's carrier against ours, in integrator units of
+             * 998.4 MHz / 2 / 2^17 / (1024, 8192 at 110 kb/s); negative for a fast sender */
+            static const double CARRIER_MHZ[8] = {0, 3494.4, 3993.6, 4492.8, 3993.6, 6489.6, 0, 6489.6};
+            double carrierHz = CARRIER_MHZ[_regValue(CHAN_CTRL, 0, 1) & 0x7] * 1e6;
+            double offset = (1.0 + f.driftPpb * 1e-9) / (1.0 + _driftPpm * 1e-6) - 1.0;
+            double hzPerUnit = 998.4e6 / 2.0 / 131072.0 / (f.dataRate == 0 ? 8192.0 : 1024.0);
+            int32_t integrator = (int32_t)lround(-offset * carrierHz / hzPerUnit);
+            _setRegValue(DRX_TUNE, DRX_CAR_INT_SUB, (uint32_t)integrator & 0x1FFFFF, LEN_DRX_CAR_INT);
+
+            /* signal levels from a simple log-distance model, encoded the way getReceivePower() decodes them */
+            double d = f.distance < 0.1 ? 0.1 : f.distance;
+            double rxLevel = -79.0 - 20.0 * log10(d);
+            double a = f.prf == 2 ? 121.74 : 113.77;
+            double n2 = (double)rxpacc * rxpacc;
+            double cir = pow(10.0, (rxLevel + a) / 10.0) * n2 / 131072.0;
+            double fpAmpl = sqrt(pow(10.0, (rxLevel - 3.0 + a) / 10.0) * n2 / 3.0);
+            _setRegValue(RX_FQUAL, 0, 40, 2);                            // STD_NOISE
+            _setRegValue(RX_FQUAL, 2, (uint16_t)fpAmpl, 2);              // FP_AMPL2
+            _setRegValue(RX_FQUAL, 4, (uint16_t)fpAmpl, 2);              // FP_AMPL3
+            _setRegValue(RX_FQUAL, 6, (uint16_t)(cir > 65535 ? 65535 : cir), 2); // CIR_PWR
+            _setRegValue(RX_TIME, 0x07, (uint16_t)fpAmpl, 2);            // FP_AMPL1
+        }
+
+        /*
+         * Double buffered reception: the frame goes to the buffer ICRBP points at,
+         * which is either the one the host sees or the spare one, then ICRBP moves
+         * on and the receiver stays on. A frame for a buffer the host has not
+         * handed back yet is an overrun.
+         */
+        void _receiveDoubleBuffered(const AirFrame &f) {
+            uint32_t status = _status();
+            bool icOnHost = ((status >> ICRBP_BIT) & 1) == ((status >> HSRBP_BIT) & 1);
+            uint32_t target = icOnHost ? status : _rxSpareStatus;
+            if(target & (1UL << RXDFR_BIT)) {
+                _rxOn = false;
+                _rxTimeoutAt = 0;
+                _raiseStatus(1UL << RXOVRR_BIT);
+                return;
+            }
+            if(icOnHost) {
+                _writeReceiveRegisters(f);
+            } else {
+                _swapSwingSets();
+                _writeReceiveRegisters(f);
+                _swapSwingSets();
+                _rxSpareStatus |= STATUS_RX_GOOD;
+            }
+            _setRegValue(SYS_STATUS, 0, _status() ^ (1UL << ICRBP_BIT), 4);
+            _rxOnSince = f.end;
+            _rxTimeoutAt = 0;
+            if(icOnHost)
+                _raiseStatus(STATUS_RX_GOOD);
+        }
+
+        void _advance() {
+            uint64_t now = _globalNow();
+
+            if(_tx.active) {
+                uint64_t preambleTicks = _tx.rmarker - _tx.preambleStart;
+                if(!_tx.sent && now >= _tx.preambleStart) {
+                    /* the frame leaves the antenna one (physical) antenna delay after the digital RMARKER */
+                    _sendToMedium(_tx.frame, _tx.rmarker + _antennaDelay, preambleTicks, _tx.end - _tx.rmarker);
+                    _tx.sent = true;
+                }
+                if(now >= _tx.end) {
+                    _tx.active = false;
+                    uint64_t local = _toLocal(_tx.rmarker);
+                    uint64_t txAntennaDelay = _regValue(TX_ANTD, 0, LEN_TX_ANTD);
+                    _setRegValue(TX_TIME, TX_STAMP_SUB, (local + txAntennaDelay) & TIME_MASK, 5);
+                    _setRegValue(TX_TIME, 0x05, local & ~0x1FFULL, 5); // TX_RAWST
+                    _raiseStatus(STATUS_TX_DONE);
+                    if(_tx.wait4resp) {
+                        uint64_t w4r = _regValue(ACK_RESP_T, ACK_RESP_T_W4R_TIME_SUB, LEN_ACK_RESP_T_W4R_TIME_SUB) & 0xFFFFF;
+                        _enableReceiver(_tx.end + w4r * 65536ULL);
+                    }
+                }
+            }
+
+            if(_rxOnAt != 0 && now >= _rxOnAt) {
+                _enableReceiver(_rxOnAt);
+                _rxOnAt = 0;
+            }
+
+            _receiveFromMedium();
+            for(size_t i = 0; i < _air.size();) {
+                AirFrame &f = _air[i];
+                if(f.end > now) {
+                    i++;
+                    continue;
+                }
+                /* a receiver turned on during the first half of the preamble still acquires it */
+                uint64_t acquireBy = f.preambleStart + (f.rmarker - f.preambleStart) / 2;
+                if(!f.collided && _rxOn && _rxOnSince <= acquireBy) {
+                    if(_doubleBuffered()) {
+                        _receiveDoubleBuffered(f);
+                    } else {
+                        _writeReceiveRegisters(f);
+                        _rxOn = false;
+                        _rxTimeoutAt = 0;
+                        _raiseStatus(STATUS_RX_GOOD);
+                    }
+                }
+                _air.erase(_air.begin() + i);
+            }
+
+            if(_rxOn && _rxTimeoutAt != 0 && now >= _rxTimeoutAt) {
+                _rxOn = false;
+                _rxTimeoutAt = 0;
+                _raiseStatus(1UL << RXRFTO_BIT);
+            }
+        }
+
+        /* OTPREAD: the word at OTP_ADDR into OTP_RDAT. Only the part and lot ID
+           are programmed, every other word reads as blank OTP */
+        void _readOtp() {
+            uint16_t address = (uint16_t)_regValue(OTP_IF, OTP_ADDR_SUB, LEN_OTP_ADDR) & 0x7FF;
+            uint32_t word = address == 0x006 ? _partId : address == 0x007 ? _lotId : 0;
+            _setRegValue(OTP_IF, OTP_RDAT_SUB, word, LEN_OTP_RDAT);
+        }
+
+        void _commitWrite() {
+            if(_writeData.empty())
+                return;
+            uint16_t len = _writeData.size();
+            switch(_reg) {
+                case DEV_ID:
+                    break; // read only
+                case SYS_TIME:
+                    break; // read only
+                case SYS_STATUS: {
+                    /* write one to clear */
+                    for(uint16_t i = 0; i < len; i++) {
+                        uint16_t idx = _sub + i;
+                        byte readOnly = idx < 4 ? (byte)(STATUS_READ_ONLY >> (8 * idx)) : 0;
+                        if(idx < _regs[SYS_STATUS].size())
+                            _regs[SYS_STATUS][idx] &= ~(_writeData[i] & ~readOnly);
+                    }
+                    _updateIrqLine();
+                    break;
+                }
+                default:
+                    if(_regs[_reg].size() < (size_t)(_sub + len))
+                        _regs[_reg].resize(_sub + len, 0);
+                    memcpy(_regs[_reg].data() + _sub, _writeData.data(), len);
+                    if(_reg == SYS_CTRL)
+                        _handleSystemControl();
+                    else if(_reg == OTP_IF && _sub == OTP_CTRL_SUB && (_writeData[0] & 0x02))
+                        _readOtp();
+                    else if(_reg == SYS_MASK)
+                        _updateIrqLine();
+                    break;
+            }
+            _writeData.clear();
+        }
+
+        void _decodeHeader() {
+            _isWrite = _header[0] & 0x80;
+            _reg = _header[0] & 0x3F;
+            _sub = 0;
+            if(_headerLen >= 2)
+                _sub = _header[1] & 0x7F;
+            if(_headerLen == 3)
+                _sub |= (uint16_t)_header[2] << 7;
+            _pos = 0;
+            _headerDone = true;
+            if(!_isWrite && _reg == SYS_TIME)
+                _setRegValue(SYS_TIME, 0, _toLocal(_globalNow()) & SYS_TIME_MASK, 5);
+        }
+    }
+
+    void select() {
+        if(!_started)
+            _start();
+        _selected = true;
+        _transactions++;
+        _headerLen = 0;
+        _headerDone = false;
+        _writeData.clear();
+    }
+
+    void deselect() {
+        if(_selected && _headerDone && _isWrite)
+            _commitWrite();
+        _selected = false;
+    }
+
+    uint8_t transfer(uint8_t mosi) {
+        if(!_selected)
+            return 0xFF;
+        _bytes++;
+        if(!_headerDone) {
+            _header[_headerLen++] = mosi;
+            /* header length is implied by the sub-index (bit 6) and extended address (bit 7) flags */
+            bool needSub = _header[0] & 0x40;
+            bool needExt = _headerLen >= 2 && (_header[1] & 0x80);
+            if(_headerLen == 1 && !needSub)
+                _decodeHeader();
+            else if(_headerLen == 2 && !needExt)
+                _decodeHeader();
+            else if(_headerLen == 3)
+                _decodeHeader();
+            return 0x00;
+        }
+        uint16_t idx = _sub + _pos++;
+        if(_isWrite) {
+            _writeData.push_back(mosi);
+            return 0x00;
+        }
+        return idx < _regs[_reg].size() ? _regs[_reg][idx] : 0x00;
+    }
+
+    void setIrqHandler(void (*handler)(void)) {
+        _irqHandler = handler;
+    }
+
+    void setInterruptsEnabled(bool enabled) {
+        _interruptsEnabled = enabled;
+    }
+
+    bool getInterruptsEnabled() {
+        return _interruptsEnabled;
+    }
+
+    void poll() {
+        if(!_started || _polling)
+            return;
+        _polling = true;
+        _advance();
+        if(_irqPending && _irqHandler != nullptr && !_selected && !_inIsr && _interruptsEnabled) {
+            _irqPending = false;
+            _inIsr = true;
+            _irqHandler();
+            _inIsr = false;
+        }
+        _polling = false;
+    }
+
+    uint32_t transactionCount() {
+        return _transactions;
+    }
+
+    uint32_t byteCount() {
+        return _bytes;
+    }
+
+    uint64_t deviceTime() {
+        if(!_started)
+            _start();
+        return _toLocal(_globalNow());
+    }
+
+}
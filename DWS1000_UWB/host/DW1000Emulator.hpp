@@ -0,0 +1,71 @@
+/**
+ * DW1000 register-level emulator for host builds.
+ *
+ * Sits behind SPIporting: the host SPI.h forwards every transaction here, the
+ * header bytes are decoded exactly like the real chip does (register id,
+ * optional 7/15-bit sub-address, read/write) and the data bytes hit an
+ * in-memory register file. The registers the driver relies on for TX/RX are
+ * modelled rather than stored:
+ *
+ *   SYS_CTRL   TXSTRT/TXDLYS/WAIT4RESP/RXENAB/RXDLYS/TRXOFF start and stop the radio
+ *   SYS_STATUS write-one-to-clear, TX/RX/timeout events set the same bits as silicon
+ *   SYS_TIME   40-bit counter derived from the host monotonic clock (+ per-node offset/drift)
+ *   DX_TIME    delayed TX/RX start (RMARKER time, low 9 bits ignored, a late TX
+ *              start raises HPDWARN and waits for the next counter period)
+ *   TX_TIME    TX_STAMP = RMARKER + TX_ANTD, RX_TIME RX_STAMP = RMARKER - LDE_RXANTD
+ *   TX_FCTRL   frame length and TXBOFFS, the start of the frame in TX_BUFFER
+ *   TX_BUFFER / RX_BUFFER / RX_FINFO / RX_FQUAL filled from the frames on the air
+ *   double buffered RX (SYS_CFG DIS_DRXB clear): two swing sets, HSRBP/ICRBP, HRBPT and RXOVRR
+ *
+ * Frames travel between host processes over UDP multicast on the loopback
+ * interface, so an anchor and a tag built for the native environments range
+ * each other on one Linux machine. The IRQ line is (SYS_STATUS & SYS_MASK) != 0
+ * and its rising edge calls the handler registered through attachInterrupt(),
+ * i.e. DW1000Ng::interruptServiceRoutine().
+ *
+ * Environment variables (read once, at the first SPI access):
+ *   DW1000_EMU_DISTANCE   distance to the other nodes in meters (default 1.0)
+ *   DW1000_EMU_DRIFT_PPM  crystal offset of this node in ppm (default 0)
+ *   DW1000_EMU_LOSS       frame loss probability 0..1 (default 0)
+ *   DW1000_EMU_ANTENNA_DELAY  physical TX/RX antenna delay in ticks (default 16436,
+ *                         the factory value: firmware programmed with it ranges exactly)
+ *   DW1000_EMU_PORT       UDP port of the shared medium (default 47000)
+ */
+
+#ifndef DW1000_EMULATOR_HPP
+#define DW1000_EMULATOR_HPP
+
+#include <stdint.h>
+
+namespace DW1000Emulator {
+
+    /** Chip select asserted / released (SPIClass::beginTransaction / endTransaction). */
+    void select();
+    void deselect();
+
+    /** Clocks one byte in and returns the byte clocked out. */
+    uint8_t transfer(uint8_t mosi);
+
+    /** IRQ wiring, called by the host attachInterrupt()/detachInterrupt(). */
+    void setIrqHandler(void (*handler)(void));
+    void setInterruptsEnabled(bool enabled);
+    bool getInterruptsEnabled();
+
+    /**
+    Advances the emulated radio to the current host time: sends due frames,
+    picks up frames from the medium, fires RX timeouts and, outside of SPI
+    transactions and interrupt context, runs the IRQ handler on a rising edge.
+    Called from yield(), so every delay() and every pass of the main loop pumps it.
+    */
+    void poll();
+
+    /** SPI traffic so far: chip-select windows and bytes clocked, header included. */
+    uint32_t transactionCount();
+    uint32_t byteCount();
+
+    /** Current 40-bit device time of this node, in DW1000 ticks (15.65 ps). */
+    uint64_t deviceTime();
+
+}
+
+#endif // DW1000_EMULATOR_HPP
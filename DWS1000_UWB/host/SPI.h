@@ -0,0 +1,41 @@
+/**
+ * Host (Linux) stand-in for the Arduino SPI library.
+ *
+ * There is no bus: every transaction goes straight into the emulated DW1000
+ * register file (DW1000Emulator.hpp). beginTransaction()/endTransaction()
+ * frame the chip-select window, exactly like SPIporting uses them.
+ */
+
+#ifndef HOST_SPI_H
+#define HOST_SPI_H
+
+#include <Arduino.h>
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+public:
+    SPISettings(uint32_t clock = 4000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class SPIClass {
+public:
+    void begin() {}
+    void end() {}
+    void usingInterrupt(int) {}
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    uint8_t transfer(uint8_t data);
+    void transfer(void *buf, size_t count);
+};
+
+extern SPIClass SPI;
+
+#endif // HOST_SPI_H
@@ -0,0 +1,614 @@
+/**
+ * Discrete-event swarm simulator
+ *
+ * Runs N virtual DW1000 nodes (A anchors + N-A tags) through the ranging
+ * protocol of tests/test_08_multi_node_swarm (legacy DW1000Ranging):
+ *
+ *   tag    POLL (broadcast, anchor list)          every 80 + 21*A ms
+ *   anchor POLL_ACK after (2i+1) * reply delay    i = position in the list
+ *   tag    RANGE (broadcast) reply delay after the last POLL_ACK
+ *   anchor RANGE_REPORT as soon as the range is computed (all anchors at
+ *          once, so reports collide at the tag; --stagger-reports spaces
+ *          them like the POLL_ACKs)
+ *
+ * Every node has its own 40-bit DW1000 clock (random offset, crystal drift),
+ * frames take real airtime for the configured data rate / preamble, arrive
+ * after the propagation delay, collide when they overlap at a receiver, are
+ * lost when the receiver is transmitting (half duplex) and with a random
+ * loss probability. Ranges are computed from the simulated timestamps with
+ * the asymmetric DS-TWR formula, so clock drift shows up as range error.
+ *
+ * MAC options:
+ *   tdma  --sync millis  test_08 as flashed: slot = NODE_ID-2, frame = N * slot,
+ *                        each node counts slots on its own millis() from boot
+ *                        and re-bases the frame every 10 s (no common time base)
+ *   tdma  --sync beacon  same slots, aligned on a common frame start
+ *   aloha                no slots, tags poll on their own timer
+ *
+ * Reports per N: ranging throughput, collision rate, position fix latency.
+ *
+ * Build: pio run -e native_swarm_sim   (or: g++ -O2 -std=gnu++11 swarm_sim.cpp)
+ * Usage: swarm_sim --sweep 5,10,20,50,100,200,500 --mac tdma --sync beacon
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+    /* ---- DW1000 constants (DW1000NgConstants.hpp) ---- */
+    constexpr double TICKS_PER_SECOND = 63.8976e9;
+    constexpr double DISTANCE_OF_RADIO = 0.0046917639786159; // m per tick
+    constexpr double SPEED_OF_LIGHT = 299702547.0;
+    constexpr uint64_t TIME_MASK = 0xFFFFFFFFFFULL;
+
+    /* ---- legacy DW1000Ranging / test_08 constants ---- */
+    constexpr double DEFAULT_TIMER_DELAY_S = 0.080;
+    constexpr double FRAME_RESYNC_S = 10.0;
+    constexpr double IDLE_LOOP_S = 0.010;       // delay(10) outside the own slot
+    constexpr double RANGE_TIMEOUT_S = 5.0;     // RANGE_TIMEOUT_MS
+    constexpr int SHORT_MAC_LEN = 9;
+    constexpr int FCS_LEN = 2;
+
+    struct Options {
+        std::vector<int> nodes;
+        int anchors = 4;
+        std::string mac = "tdma";
+        std::string sync = "millis";
+        double slotS = 0.150;
+        double replyS = 0.007;
+        double durationS = 60.0;
+        double loss = 0.01;
+        double ppm = 20.0;
+        double area = 20.0;
+        double jitterS = 0.001;
+        bool staggerReports = false;
+        int dataRateKbps = 110;
+        int preamble = 2048;
+        unsigned seed = 1;
+        bool csv = false;
+    };
+
+    enum FrameKind { POLL, POLL_ACK, RANGE, RANGE_REPORT };
+
+    struct Clock {
+        double drift;     // fractional frequency error
+        double offset;    // ticks at t = 0
+
+        uint64_t ticks(double t) const {
+            double v = offset + t * TICKS_PER_SECOND * (1.0 + drift);
+            return (uint64_t)fmod(v, (double)(TIME_MASK + 1));
+        }
+        /* local seconds (millis()) since boot */
+        double local(double t) const { return t * (1.0 + drift); }
+        double global(double local) const { return local / (1.0 + drift); }
+    };
+
+    struct Transmission {
+        int src;
+        FrameKind kind;
+        int round;        // tag round the frame belongs to
+        int tag;          // tag that owns the round
+        double start;     // preamble start, global seconds
+        double rmarker;
+        double end;
+        uint64_t txStamp; // sender clock at RMARKER
+    };
+
+    struct AnchorRound {
+        int round = -1;
+        uint64_t pollRx = 0;
+        uint64_t ackTx = 0;
+        bool acked = false;
+    };
+
+    struct Node {
+        bool anchor;
+        double x, y;
+        Clock clock;
+        double busyUntil = 0;   // own transmission in progress
+
+        /* anchor state, per tag */
+        std::vector<AnchorRound> perTag;
+
+        /* tag state */
+        int slot = 0;
+        double boot = 0;
+        double frameStartLocal = 0;
+        int round = 0;
+        uint64_t pollTx = 0;
+        std::vector<uint64_t> ackRx;
+        std::vector<bool> ackOk;
+        std::vector<double> rangeAt;
+        double lastFix = -1;
+        int fixedRound = -1;
+        double firstRoundAt = -1;
+    };
+
+    enum EventKind { EV_TAG_TIMER, EV_TX, EV_RX_END };
+
+    struct Event {
+        double t;
+        uint64_t seq;
+        EventKind kind;
+        int node;
+        int tx;       // index into transmissions
+        bool operator<(const Event &o) const { return t != o.t ? t > o.t : seq > o.seq; }
+    };
+
+    struct Stats {
+        uint64_t txFrames = 0;
+        uint64_t txDropped = 0;      // node already transmitting
+        uint64_t rxAttempts = 0;
+        uint64_t rxCollided = 0;
+        uint64_t rxHalfDuplex = 0;
+        uint64_t rxLost = 0;
+        uint64_t rounds = 0;
+        uint64_t ranges = 0;
+        uint64_t reports = 0;
+        double rangeErrSq = 0;
+        uint64_t fixes = 0;
+        std::vector<double> fixIntervals;
+        std::vector<double> firstFix;
+        int tagsWithoutFix = 0;
+    };
+
+    class Simulator {
+    public:
+        Simulator(const Options &opt, int n) : _opt(opt), _rng(opt.seed * 7919u + n), _n(n) {}
+
+        Stats run();
+
+    private:
+        const Options &_opt;
+        std::mt19937_64 _rng;
+        int _n;
+        std::vector<Node> _nodes;
+        std::vector<int> _anchorIds;
+        std::vector<Transmission> _tx;
+        std::vector<int> _active;    // transmissions that may still overlap a reception
+        std::priority_queue<Event> _events;
+        uint64_t _seq = 0;
+        Stats _stats;
+        double _preambleS = 0;
+        double _now = 0;
+
+        double _uniform(double a, double b) { return std::uniform_real_distribution<double>(a, b)(_rng); }
+
+        void _schedule(double t, EventKind kind, int node, int tx = -1) {
+            _events.push(Event{t, _seq++, kind, node, tx});
+        }
+
+        double _distance(int a, int b) const {
+            double dx = _nodes[a].x - _nodes[b].x, dy = _nodes[a].y - _nodes[b].y;
+            return sqrt(dx * dx + dy * dy);
+        }
+
+        int _frameLength(FrameKind kind) const {
+            int a = (int)_anchorIds.size();
+            switch(kind) {
+                case POLL:         return SHORT_MAC_LEN + 2 + 4 * a + FCS_LEN;
+                case POLL_ACK:     return SHORT_MAC_LEN + 1 + FCS_LEN;
+                case RANGE:        return SHORT_MAC_LEN + 2 + 17 * a + FCS_LEN;
+                default:           return SHORT_MAC_LEN + 9 + FCS_LEN;
+            }
+        }
+
+        /* IEEE 802.15.4a UWB PHY airtime after the RMARKER: PHR + Reed-Solomon coded payload */
+        double _payloadTime(int len) const {
+            double bitS = _opt.dataRateKbps <= 110 ? 8205.13e-9 : (_opt.dataRateKbps <= 850 ? 1025.64e-9 : 128.21e-9);
+            double phrBitS = _opt.dataRateKbps <= 110 ? 8205.13e-9 : 1025.64e-9;
+            return 21 * phrBitS + len * 8.0 * (1.0 + 48.0 / 330.0) * bitS;
+        }
+
+        void _setup();
+        void _transmit(int src, FrameKind kind, int tag, int round, double at);
+        void _onTagTimer(int tag);
+        void _onTx(int txId);
+        void _onRxEnd(int rx, int txId);
+        void _deliver(int rx, const Transmission &t, double rmarkerAtRx);
+        bool _inSlot(Node &tag, double t);
+        double _nextSlotStart(Node &tag, double t);
+        void _checkFix(int tag);
+    };
+
+    void Simulator::_setup() {
+        double symbolS = 993.59e-9; // 16 MHz PRF
+        double sfd = _opt.dataRateKbps <= 110 ? 64 : 8;
+        _preambleS = (_opt.preamble + sfd) * symbolS;
+
+        int anchors = std::min(_opt.anchors, _n - 1);
+        _nodes.resize(_n);
+        for(int i = 0; i < _n; i++) {
+            Node &node = _nodes[i];
+            node.anchor = i < anchors;
+            node.clock.drift = _uniform(-_opt.ppm, _opt.ppm) * 1e-6;
+            node.clock.offset = _uniform(0, (double)TIME_MASK);
+            if(node.anchor) {
+                /* anchors spread on a circle around the area centre */
+                double phi = 2.0 * M_PI * i / anchors;
+                node.x = _opt.area / 2 * (1 + cos(phi));
+                node.y = _opt.area / 2 * (1 + sin(phi));
+                _anchorIds.push_back(i);
+            } else {
+                node.x = _uniform(0, _opt.area);
+                node.y = _uniform(0, _opt.area);
+            }
+        }
+        for(int i = 0; i < _n; i++) {
+            Node &node = _nodes[i];
+            if(node.anchor) {
+                node.perTag.resize(_n);
+                continue;
+            }
+            node.slot = i - anchors;
+            node.boot = _uniform(0, 1.0);
+            node.frameStartLocal = node.clock.local(node.boot);
+            node.ackRx.assign(anchors, 0);
+            node.ackOk.assign(anchors, false);
+            node.rangeAt.assign(anchors, -1);
+            _schedule(node.boot, EV_TAG_TIMER, i);
+        }
+    }
+
+    bool Simulator::_inSlot(Node &tag, double t) {
+        if(_opt.mac != "tdma")
+            return true;
+        double frame = _n * _opt.slotS;
+        if(_opt.sync == "beacon") {
+            double inFrame = fmod(t, frame);
+            return (int)(inFrame / _opt.slotS) == tag.slot % _n;
+        }
+        double local = tag.clock.local(t);
+        while(local - tag.frameStartLocal > FRAME_RESYNC_S)
+            tag.frameStartLocal += FRAME_RESYNC_S + _uniform(0, IDLE_LOOP_S);
+        double inFrame = fmod(local - tag.frameStartLocal, frame);
+        return (int)(inFrame / _opt.slotS) == tag.slot % _n;
+    }
+
+    double Simulator::_nextSlotStart(Node &tag, double t) {
+        double frame = _n * _opt.slotS;
+        double slotOffset = (tag.slot % _n) * _opt.slotS;
+        if(_opt.sync == "beacon") {
+            double inFrame = fmod(t, frame);
+            double wait = inFrame <= slotOffset ? slotOffset - inFrame : frame - inFrame + slotOffset;
+            return t + wait + 1e-6; // land inside the slot despite rounding
+        }
+        double local = tag.clock.local(t);
+        double inFrame = fmod(local - tag.frameStartLocal, frame);
+        double wait = inFrame <= slotOffset ? slotOffset - inFrame : frame - inFrame + slotOffset;
+        /* the idle loop only looks at the slot every delay(10) */
+        return tag.clock.global(local + wait) + _uniform(0, IDLE_LOOP_S);
+    }
+
+    void Simulator::_transmit(int src, FrameKind kind, int tag, int round, double at) {
+        Transmission t;
+        t.src = src;
+        t.kind = kind;
+        t.tag = tag;
+        t.round = round;
+        t.start = at;
+        t.rmarker = at + _preambleS;
+        t.end = t.rmarker + _payloadTime(_frameLength(kind));
+        t.txStamp = _nodes[src].clock.ticks(t.rmarker);
+        _tx.push_back(t);
+        _schedule(at, EV_TX, src, (int)_tx.size() - 1);
+    }
+
+    void Simulator::_onTagTimer(int id) {
+        Node &tag = _nodes[id];
+        double period = DEFAULT_TIMER_DELAY_S + _anchorIds.size() * 3 * _opt.replyS;
+        if(_opt.mac == "tdma" && !_inSlot(tag, _now)) {
+            _schedule(_nextSlotStart(tag, _now), EV_TAG_TIMER, id);
+            return;
+        }
+        tag.round++;
+        std::fill(tag.ackOk.begin(), tag.ackOk.end(), false);
+        if(tag.firstRoundAt < 0)
+            tag.firstRoundAt = _now;
+        _stats.rounds++;
+        _transmit(id, POLL, id, tag.round, _now);
+        double next = _now + period;
+        if(_opt.mac == "aloha")
+            next += _uniform(0, period);
+        _schedule(next, EV_TAG_TIMER, id);
+    }
+
+    void Simulator::_onTx(int txId) {
+        Transmission &t = _tx[txId];
+        Node &src = _nodes[t.src];
+        if(src.busyUntil > t.start) {
+            _stats.txDropped++;
+            return;
+        }
+        src.busyUntil = t.end;
+        _stats.txFrames++;
+        if(t.kind == POLL)
+            src.pollTx = t.txStamp;
+        if(t.kind == POLL_ACK) {
+            AnchorRound &st = src.perTag[t.tag];
+            if(st.round == t.round) {
+                st.ackTx = t.txStamp;
+                st.acked = true;
+            }
+        }
+        _active.push_back(txId);
+
+        /* only intended receivers are tracked: the anchors for POLL/RANGE, the tag otherwise */
+        if(t.kind == POLL || t.kind == RANGE) {
+            for(int a : _anchorIds) {
+                double prop = _distance(t.src, a) / SPEED_OF_LIGHT;
+                _schedule(t.end + prop, EV_RX_END, a, txId);
+            }
+        } else {
+            double prop = _distance(t.src, t.tag) / SPEED_OF_LIGHT;
+            _schedule(t.end + prop, EV_RX_END, t.tag, txId);
+        }
+    }
+
+    void Simulator::_onRxEnd(int rx, int txId) {
+        const Transmission t = _tx[txId];
+        double prop = _distance(t.src, rx) / SPEED_OF_LIGHT;
+        double start = t.start + prop, end = t.end + prop;
+        _stats.rxAttempts++;
+
+        /* drop transmissions that can no longer overlap anything */
+        double horizon = _now - 0.05;
+        _active.erase(std::remove_if(_active.begin(), _active.end(),
+            [&](int id) { return _tx[id].end < horizon; }), _active.end());
+
+        for(int id : _active) {
+            if(id == txId)
+                continue;
+            const Transmission &o = _tx[id];
+            if(o.src == rx) {
+                if(o.start < end && start < o.end) {
+                    _stats.rxHalfDuplex++;
+                    return;
+                }
+                continue;
+            }
+            double oprop = _distance(o.src, rx) / SPEED_OF_LIGHT;
+            if(o.start + oprop < end && start < o.end + oprop) {
+                _stats.rxCollided++;
+                return;
+            }
+        }
+        if(_uniform(0, 1) < _opt.loss) {
+            _stats.rxLost++;
+            return;
+        }
+        _deliver(rx, t, t.rmarker + prop);
+    }
+
+    void Simulator::_deliver(int rx, const Transmission &t, double rmarkerAtRx) {
+        Node &node = _nodes[rx];
+        uint64_t rxStamp = node.clock.ticks(rmarkerAtRx);
+        int anchorIndex = node.anchor ? rx : t.src;
+
+        switch(t.kind) {
+            case POLL: {
+                AnchorRound &st = node.perTag[t.tag];
+                st.round = t.round;
+                st.pollRx = rxStamp;
+                st.acked = false;
+                double at = _now + (2 * anchorIndex + 1) * _opt.replyS;
+                _transmit(rx, POLL_ACK, t.tag, t.round, at);
+                break;
+            }
+            case POLL_ACK: {
+                if(t.round != node.round)
+                    break;
+                node.ackRx[anchorIndex] = rxStamp;
+                node.ackOk[anchorIndex] = true;
+                /* the tag sends RANGE when the last anchor of its list has answered */
+                if(anchorIndex == (int)_anchorIds.size() - 1 && _inSlot(node, _now))
+                    _transmit(rx, RANGE, rx, node.round, _now + _opt.replyS);
+                break;
+            }
+            case RANGE: {
+                AnchorRound &st = node.perTag[t.tag];
+                const Node &tag = _nodes[t.tag];
+                if(st.round != t.round || !st.acked || tag.round != t.round || !tag.ackOk[anchorIndex])
+                    break;
+                /* asymmetric DS-TWR on 40-bit timestamps */
+                double round1 = (double)((tag.ackRx[anchorIndex] - tag.pollTx) & TIME_MASK);
+                double reply1 = (double)((st.ackTx - st.pollRx) & TIME_MASK);
+                double round2 = (double)((rxStamp - st.ackTx) & TIME_MASK);
+                double reply2 = (double)((t.txStamp - tag.ackRx[anchorIndex]) & TIME_MASK);
+                double tof = (round1 * round2 - reply1 * reply2) / (round1 + round2 + reply1 + reply2);
+                double range = tof * DISTANCE_OF_RADIO;
+                double err = range - _distance(rx, t.tag);
+                _stats.ranges++;
+                _stats.rangeErrSq += err * err;
+                st.round = -1;
+                double delay = _uniform(0, _opt.jitterS);
+                if(_opt.staggerReports)
+                    delay += (2 * anchorIndex + 1) * _opt.replyS;
+                _transmit(rx, RANGE_REPORT, t.tag, t.round, _now + delay);
+                break;
+            }
+            case RANGE_REPORT: {
+                _stats.reports++;
+                node.rangeAt[anchorIndex] = _now;
+                if(t.round == node.round)
+                    _checkFix(rx);
+                break;
+            }
+        }
+    }
+
+    void Simulator::_checkFix(int id) {
+        Node &tag = _nodes[id];
+        int fresh = 0;
+        for(double at : tag.rangeAt)
+            if(at >= 0 && _now - at < RANGE_TIMEOUT_S)
+                fresh++;
+        /* one position update per round, once three anchors are fresh (updatePosition()) */
+        if(fresh < 3 || tag.fixedRound == tag.round)
+            return;
+        tag.fixedRound = tag.round;
+        _stats.fixes++;
+        if(tag.lastFix < 0)
+            _stats.firstFix.push_back(_now - tag.firstRoundAt);
+        else
+            _stats.fixIntervals.push_back(_now - tag.lastFix);
+        tag.lastFix = _now;
+    }
+
+    Stats Simulator::run() {
+        _setup();
+        while(!_events.empty()) {
+            Event ev = _events.top();
+            if(ev.t > _opt.durationS)
+                break;
+            _events.pop();
+            _now = ev.t;
+            switch(ev.kind) {
+                case EV_TAG_TIMER:
+                    _onTagTimer(ev.node);
+                    break;
+                case EV_TX:
+                    _onTx(ev.tx);
+                    break;
+                case EV_RX_END:
+                    _onRxEnd(ev.node, ev.tx);
+                    break;
+            }
+        }
+        for(const Node &node : _nodes)
+            if(!node.anchor && node.lastFix < 0)
+                _stats.tagsWithoutFix++;
+        return _stats;
+    }
+
+    double percentile(std::vector<double> v, double p) {
+        if(v.empty())
+            return NAN;
+        std::sort(v.begin(), v.end());
+        size_t i = (size_t)(p * (v.size() - 1));
+        return v[i];
+    }
+
+    double mean(const std::vector<double> &v) {
+        if(v.empty())
+            return NAN;
+        double s = 0;
+        for(double x : v)
+            s += x;
+        return s / v.size();
+    }
+
+    void usage() {
+        printf("Usage: swarm_sim [options]\n"
+               "  --nodes N            number of nodes, anchors included (default 5)\n"
+               "  --sweep a,b,c        run several node counts (e.g. 5,10,20,50,100,200,500)\n"
+               "  --anchors A          anchors among the nodes (default 4)\n"
+               "  --mac tdma|aloha     channel access (default tdma)\n"
+               "  --sync millis|beacon tdma frame alignment (default millis, as test_08)\n"
+               "  --slot-ms MS         tdma slot length (default 150)\n"
+               "  --reply-us US        DW1000Ranging reply delay (default 7000)\n"
+               "  --jitter-us US       anchor RANGE_REPORT processing jitter (default 1000)\n"
+               "  --stagger-reports    anchors send RANGE_REPORT in (2i+1) * reply slots like POLL_ACK\n"
+               "  --rate 110|850|6800  data rate in kbps (default 110)\n"
+               "  --preamble N         preamble symbols (default 2048)\n"
+               "  --duration-s S       simulated time (default 60)\n"
+               "  --loss P             random frame loss probability (default 0.01)\n"
+               "  --ppm P              crystal tolerance, +/- (default 20)\n"
+               "  --area M             side of the square area in meters (default 20)\n"
+               "  --seed S             random seed (default 1)\n"
+               "  --csv                machine readable output\n");
+    }
+
+    bool parse(int argc, char **argv, Options &opt) {
+        for(int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+            auto need = [&]() { if(v == nullptr) { usage(); exit(1); } i++; return v; };
+            if(a == "--nodes") opt.nodes.assign(1, atoi(need()));
+            else if(a == "--sweep") {
+                opt.nodes.clear();
+                std::string s = need();
+                for(size_t p = 0; p < s.size();) {
+                    size_t q = s.find(',', p);
+                    opt.nodes.push_back(atoi(s.substr(p, q - p).c_str()));
+                    p = q == std::string::npos ? s.size() : q + 1;
+                }
+            }
+            else if(a == "--anchors") opt.anchors = atoi(need());
+            else if(a == "--mac") opt.mac = need();
+            else if(a == "--sync") opt.sync = need();
+            else if(a == "--slot-ms") opt.slotS = atof(need()) / 1000.0;
+            else if(a == "--reply-us") opt.replyS = atof(need()) / 1e6;
+            else if(a == "--jitter-us") opt.jitterS = atof(need()) / 1e6;
+            else if(a == "--rate") opt.dataRateKbps = atoi(need());
+            else if(a == "--preamble") opt.preamble = atoi(need());
+            else if(a == "--duration-s") opt.durationS = atof(need());
+            else if(a == "--loss") opt.loss = atof(need());
+            else if(a == "--ppm") opt.ppm = atof(need());
+            else if(a == "--area") opt.area = atof(need());
+            else if(a == "--seed") opt.seed = (unsigned)atoi(need());
+            else if(a == "--stagger-reports") opt.staggerReports = true;
+            else if(a == "--csv") opt.csv = true;
+            else { usage(); return false; }
+        }
+        if(opt.nodes.empty())
+            opt.nodes.push_back(5);
+        return true;
+    }
+
+}
+
+int main(int argc, char **argv) {
+    Options opt;
+    if(!parse(argc, argv, opt))
+        return 1;
+
+    if(opt.csv) {
+        printf("nodes,tags,tx_per_s,ranges_per_s,ranges_per_s_per_tag,collision_rate,half_duplex_rate,"
+               "fixes_per_s_per_tag,fix_interval_mean_s,fix_interval_p95_s,first_fix_mean_s,tags_without_fix,range_rmse_m\n");
+    } else {
+        printf("mac=%s sync=%s slot=%.0fms reply=%.0fus reports=%s rate=%dkbps preamble=%d anchors=%d duration=%.0fs loss=%.3f ppm=%.0f\n\n",
+               opt.mac.c_str(), opt.sync.c_str(), opt.slotS * 1000, opt.replyS * 1e6,
+               opt.staggerReports ? "staggered" : "immediate", opt.dataRateKbps,
+               opt.preamble, opt.anchors, opt.durationS, opt.loss, opt.ppm);
+        printf("%6s %5s %8s %9s %10s %8s %8s %11s %10s %10s %10s %7s %8s\n",
+               "nodes", "tags", "tx/s", "ranges/s", "rng/s/tag", "collide", "halfdup",
+               "fix/s/tag", "fix-avg s", "fix-p95 s", "1st-fix s", "no-fix", "rmse cm");
+    }
+
+    for(int n : opt.nodes) {
+        if(n < 2) {
+            fprintf(stderr, "need at least 2 nodes\n");
+            return 1;
+        }
+        Simulator sim(opt, n);
+        Stats s = sim.run();
+        int tags = n - std::min(opt.anchors, n - 1);
+        double dur = opt.durationS;
+        double collide = s.rxAttempts ? (double)s.rxCollided / s.rxAttempts : 0;
+        double halfDup = s.rxAttempts ? (double)s.rxHalfDuplex / s.rxAttempts : 0;
+        double rmse = s.ranges ? sqrt(s.rangeErrSq / s.ranges) : NAN;
+        double fixInterval = mean(s.fixIntervals), fixP95 = percentile(s.fixIntervals, 0.95);
+        double firstFix = mean(s.firstFix);
+        if(opt.csv) {
+            printf("%d,%d,%.2f,%.2f,%.4f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%d,%.4f\n",
+                   n, tags, s.txFrames / dur, s.ranges / dur, s.ranges / dur / tags, collide, halfDup,
+                   s.fixes / dur / tags, fixInterval, fixP95, firstFix, s.tagsWithoutFix, rmse);
+        } else {
+            printf("%6d %5d %8.1f %9.2f %10.3f %7.1f%% %7.1f%% %11.3f %10.2f %10.2f %10.2f %7d %8.2f\n",
+                   n, tags, s.txFrames / dur, s.ranges / dur, s.ranges / dur / tags, collide * 100, halfDup * 100,
+                   s.fixes / dur / tags, fixInterval, fixP95, firstFix, s.tagsWithoutFix, rmse * 100);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,260 @@
+/**
+ * TDOA position solver
+ *
+ * Reads the blink lines of the TDOA anchors (src/tdoa_anchor_main.cpp) from
+ * stdin, any number of serial logs merged into one stream:
+ *
+ *   TDOA <anchor> <tag EUI> <sequence> <reference time, hex ticks>
+ *
+ * and prints one position per blink heard by enough anchors:
+ *
+ *   POS <tag EUI> <sequence> <x> <y> [<z>] anchors=<n> rms=<m>
+ *
+ * Every anchor time is on the clock of the reference anchor 0, but counted
+ * from when the beacon reached that anchor: the flight time reference ->
+ * anchor i is added back from the anchor positions. What is left is the
+ * blink TX time plus the flight tag -> anchor i, so the unknowns are the
+ * position and the TX time, solved by Gauss-Newton on
+ *
+ *   c * t_i = |p - a_i| + c * t_0
+ *
+ * from the anchor centroid. A blink needs one anchor more than the position
+ * has coordinates (3 in 2D, 4 in 3D), more anchors average the noise down.
+ *
+ * Build: pio run -e native_tdoa_solver   (or: g++ -O2 -std=gnu++11 tdoa_solver.cpp)
+ * Usage: cat anchor*.log | tdoa_solver --anchor 0,0 --anchor 10,0 --anchor 0,10 --anchor 10,10
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    /* ---- DW1000 constants (DW1000NgConstants.hpp) ---- */
+    constexpr double DISTANCE_OF_RADIO = 0.0046917639786159; // m per tick
+    constexpr uint64_t TIME_MASK = 0xFFFFFFFFFFULL;
+
+    constexpr int MAX_ANCHORS = 16;
+    constexpr int MAX_ITERATIONS = 20;
+
+    struct Options {
+        std::vector<std::vector<double>> anchors;
+        int dims = 2;
+        int minAnchors = 0;         // 0: dims + 1
+        bool verbose = false;
+    };
+
+    /* one blink of one tag, as heard so far */
+    struct Blink {
+        unsigned sequence = 0;
+        int count = 0;
+        bool heard[MAX_ANCHORS] = {};
+        uint64_t time[MAX_ANCHORS] = {};
+    };
+
+    double distance(const std::vector<double> &a, const double *p, int dims) {
+        double squares = 0.0;
+        for(int k = 0; k < dims; k++)
+            squares += (p[k] - a[k]) * (p[k] - a[k]);
+        return sqrt(squares);
+    }
+
+    /* solves the n x n system m * x = v in place, false if singular */
+    bool solveLinear(double m[4][4], double v[4], int n) {
+        for(int col = 0; col < n; col++) {
+            int pivot = col;
+            for(int row = col + 1; row < n; row++)
+                if(fabs(m[row][col]) > fabs(m[pivot][col]))
+                    pivot = row;
+            if(fabs(m[pivot][col]) < 1e-12)
+                return false;
+            for(int k = 0; k < n; k++)
+                std::swap(m[col][k], m[pivot][k]);
+            std::swap(v[col], v[pivot]);
+            for(int row = 0; row < n; row++) {
+                if(row == col)
+                    continue;
+                double f = m[row][col] / m[col][col];
+                for(int k = col; k < n; k++)
+                    m[row][k] -= f * m[col][k];
+                v[row] -= f * v[col];
+            }
+        }
+        for(int k = 0; k < n; k++)
+            v[k] /= m[k][k];
+        return true;
+    }
+
+    /* Gauss-Newton for the position p and the TX offset b (metres) */
+    bool solve(const Options &opt, const Blink &blink, double p[3], double &rms) {
+        const std::vector<double> &ref = opt.anchors[0];
+        std::vector<int> ids;
+        std::vector<double> measured;
+        uint64_t base = 0;
+        for(int i = 0; i < (int)opt.anchors.size(); i++) {
+            if(!blink.heard[i])
+                continue;
+            if(ids.empty())
+                base = blink.time[i];
+            /* signed 40 bit difference, the clock may wrap between anchors */
+            int64_t ticks = (int64_t)((blink.time[i] - base) & TIME_MASK);
+            if(ticks > (int64_t)(TIME_MASK / 2))
+                ticks -= (int64_t)(TIME_MASK + 1);
+            ids.push_back(i);
+            measured.push_back(ticks * DISTANCE_OF_RADIO + distance(ref, opt.anchors[i].data(), opt.dims));
+        }
+        int n = (int)ids.size();
+        int unknowns = opt.dims + 1;
+
+        for(int k = 0; k < 3; k++) {
+            p[k] = 0.0;
+            for(int i : ids)
+                p[k] += k < opt.dims ? opt.anchors[i][k] / n : 0.0;
+        }
+        double b = 0.0;
+        for(int j = 0; j < n; j++)
+            b += (measured[j] - distance(opt.anchors[ids[j]], p, opt.dims)) / n;
+
+        for(int iteration = 0; iteration < MAX_ITERATIONS; iteration++) {
+            double jtj[4][4] = {};
+            double jtr[4] = {};
+            for(int j = 0; j < n; j++) {
+                const std::vector<double> &a = opt.anchors[ids[j]];
+                double d = distance(a, p, opt.dims);
+                if(d < 1e-6)
+                    d = 1e-6;
+                double row[4];
+                for(int k = 0; k < opt.dims; k++)
+                    row[k] = (p[k] - a[k]) / d;
+                row[opt.dims] = 1.0;
+                double r = measured[j] - d - b;
+                for(int u = 0; u < unknowns; u++) {
+                    jtr[u] += row[u] * r;
+                    for(int w = 0; w < unknowns; w++)
+                        jtj[u][w] += row[u] * row[w];
+                }
+            }
+            if(!solveLinear(jtj, jtr, unknowns))
+                return false;
+            double step = 0.0;
+            for(int k = 0; k < opt.dims; k++) {
+                p[k] += jtr[k];
+                step += jtr[k] * jtr[k];
+            }
+            b += jtr[opt.dims];
+            if(step < 1e-8)
+                break;
+        }
+
+        double squares = 0.0;
+        for(int j = 0; j < n; j++) {
+            double r = measured[j] - distance(opt.anchors[ids[j]], p, opt.dims) - b;
+            squares += r * r;
+        }
+        rms = sqrt(squares / n);
+        return true;
+    }
+
+    void report(const Options &opt, const std::string &eui, const Blink &blink) {
+        if(blink.count < opt.minAnchors) {
+            if(opt.verbose)
+                printf("SKIP %s %u anchors=%d\n", eui.c_str(), blink.sequence, blink.count);
+            return;
+        }
+        double p[3];
+        double rms;
+        if(!solve(opt, blink, p, rms)) {
+            printf("FAIL %s %u anchors=%d\n", eui.c_str(), blink.sequence, blink.count);
+            return;
+        }
+        printf("POS %s %u", eui.c_str(), blink.sequence);
+        for(int k = 0; k < opt.dims; k++)
+            printf(" %.3f", p[k]);
+        printf(" anchors=%d rms=%.3f\n", blink.count, rms);
+        fflush(stdout);
+    }
+
+    void usage() {
+        fprintf(stderr,
+            "Usage: tdoa_solver --anchor x,y[,z] ... [options] < anchor logs\n"
+            "  --anchor x,y[,z]   anchor position (m), once per anchor in index order;\n"
+            "                     the first one is the reference anchor 0\n"
+            "  --3d               solve x,y,z (default x,y)\n"
+            "  --min-anchors N    anchors a blink needs (default: 3 in 2D, 4 in 3D)\n"
+            "  --verbose          report blinks heard by too few anchors\n");
+    }
+
+    bool parse(int argc, char **argv, Options &opt) {
+        for(int i = 1; i < argc; i++) {
+            std::string a = argv[i];
+            const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+            auto need = [&]() { if(v == nullptr) { usage(); exit(1); } i++; return v; };
+            if(a == "--anchor") {
+                std::vector<double> pos(3, 0.0);
+                if(sscanf(need(), "%lf,%lf,%lf", &pos[0], &pos[1], &pos[2]) < 2) { usage(); return false; }
+                opt.anchors.push_back(pos);
+            }
+            else if(a == "--3d") opt.dims = 3;
+            else if(a == "--min-anchors") opt.minAnchors = atoi(need());
+            else if(a == "--verbose") opt.verbose = true;
+            else { usage(); return false; }
+        }
+        if(opt.minAnchors < opt.dims + 1)
+            opt.minAnchors = opt.dims + 1;
+        if((int)opt.anchors.size() < opt.minAnchors || (int)opt.anchors.size() > MAX_ANCHORS) {
+            fprintf(stderr, "need %d to %d anchors\n", opt.minAnchors, MAX_ANCHORS);
+            return false;
+        }
+        return true;
+    }
+
+}
+
+int main(int argc, char **argv) {
+    Options opt;
+    if(!parse(argc, argv, opt))
+        return 1;
+
+    /* per tag, the blink being collected: solved once every anchor reported,
+     * or with what it has when the next blink of that tag shows up */
+    std::map<std::string, Blink> pending;
+    char line[256];
+    while(fgets(line, sizeof(line), stdin) != nullptr) {
+        const char *record = strstr(line, "TDOA ");
+        int anchor;
+        char eui[17];
+        unsigned sequence;
+        unsigned long long time;
+        if(record == nullptr ||
+           sscanf(record, "TDOA %d %16s %u %llx", &anchor, eui, &sequence, &time) != 4 ||
+           anchor < 0 || anchor >= (int)opt.anchors.size())
+            continue;
+
+        Blink &blink = pending[eui];
+        if(blink.count > 0 && blink.sequence != sequence) {
+            report(opt, eui, blink);
+            blink = Blink();
+        }
+        blink.sequence = sequence;
+        if(!blink.heard[anchor]) {
+            blink.heard[anchor] = true;
+            blink.count++;
+        }
+        blink.time[anchor] = time & TIME_MASK;
+        if(blink.count == (int)opt.anchors.size()) {
+            report(opt, eui, blink);
+            blink = Blink();
+        }
+    }
+    for(auto &entry : pending)
+        if(entry.second.count > 0)
+            report(opt, entry.first, entry.second);
+    return 0;
+}
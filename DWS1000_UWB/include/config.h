@@ -59,6 +59,47 @@
 #define RADIO_PREAMBLE_LEN      256     // Preamble symbols
 #define RADIO_PREAMBLE_CODE     3       // Preamble code
 
+// Response window (WAIT4RESP): the chip turns its receiver on by itself this
+// long after every TX, so a reply is caught even while the MCU is busy.
+// Units are ~1 us (1.026 us). The tag also gives up on a reply that has not
+// arrived within the timeout (max 65535).
+#define RESPONSE_RX_DELAY_US    100     // TX end -> receiver on (0 is "off")
+#define RESPONSE_TIMEOUT_US     20000   // receiver on -> RX timeout
+
+// 3-message DS-TWR (TWR_REPORT_IN_POLL_ACK): the tag's next POLL is a delayed
+// TX starting this long after the end of the RANGE (FINAL in
+// multi_tag_main.cpp), time for the anchors to re-arm their receivers.
+#define NEXT_POLL_GUARD_US      1000
+
+// One-to-many DS-TWR (multi_tag_main.cpp): one POLL, then each anchor answers
+// in its own slot. A slot is one RESPONSE air time plus the guard; the first
+// slot leaves the anchors their turnaround, the FINAL gap leaves the tag its.
+#define MULTI_ANCHOR_COUNT      4       // anchors polled, slots 0..n-1 (max 16)
+#define MULTI_FIRST_SLOT_US     3000    // POLL RX -> first RESPONSE
+#define MULTI_SLOT_GUARD_US     100     // clock drift and antenna turnaround
+#define MULTI_FINAL_GAP_US      1500    // end of the last slot -> FINAL
+
+// TDOA (tdoa_anchor_main.cpp, tdoa_tag_main.cpp): the reference anchor beacons
+// its clock, the others track it; tags only blink. Two beacons make a skew,
+// so a shorter period follows temperature faster at the cost of air time.
+#define TDOA_SYNC_PERIOD_MS     100     // reference beacon period
+#define TDOA_SYNC_LEAD_US       1000    // beacon scheduled this long before its TX
+#define TDOA_BLINK_PERIOD_MS    100     // tag blink period
+#define TDOA_BLINK_JITTER_MS    20      // random extra delay per blink
+
+// TDMA superframe (tdma_coordinator_main.cpp, tdma_node_main.cpp): the
+// coordinator's beacon opens each superframe, the nodes time their slot from
+// its RX timestamp on the DW1000 clock. A slot is one SS-TWR exchange with the
+// coordinator: its reply delay plus the RESPONSE air time plus the guard.
+// One slot per live node plus a last one where new nodes send their JOIN.
+#define TDMA_MAX_SLOTS          8       // nodes at most (max 16)
+#define TDMA_SLOT_TIMEOUT       20      // superframes without a POLL, then the slot is reclaimed
+#define TDMA_JOIN_BACKOFF       3       // a node skips 0..n superframes between JOINs
+#define TDMA_FIRST_SLOT_US      2000    // beacon -> slot 0, the nodes' turnaround
+#define TDMA_REPLY_DELAY_US     1500    // POLL RX -> RESPONSE TX, the coordinator's
+#define TDMA_SLOT_GUARD_US      100     // between a RESPONSE and the next POLL
+#define TDMA_BEACON_LEAD_US     1000    // coordinator stops listening before a beacon
+
 // =============================================================================
 // Calibration Values — Antenna Delay
 // =============================================================================
@@ -94,6 +135,8 @@
 // #define USE_OLED_DISPLAY         // Enable OLED output (SSD1306 128x32)
 // #define USE_OUTLIER_FILTER       // Enable statistical outlier rejection
 // #define USE_MOVING_AVERAGE       // Enable moving average smoothing
+// #define TWR_REPORT_IN_POLL_ACK   // Tag: 3-message DS-TWR, range comes back in the next POLL_ACK
+// #define TWR_SINGLE_SIDED         // Tag: 2-message SS-TWR, anchor clock offset from the carrier integrator
 
 // Outlier filter settings (if USE_OUTLIER_FILTER defined)
 #define OUTLIER_THRESHOLD_M     2.0f    // Reject readings > this far from mean
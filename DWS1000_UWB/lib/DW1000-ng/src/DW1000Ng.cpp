@@ -48,10 +48,16 @@
 #if defined(__AVR__)
 	#include <EEPROM.h>
 #endif
+#if DW1000NG_ESP32_SPI_DMA
+	#include <freertos/FreeRTOS.h>
+	#include <freertos/semphr.h>
+	#include <freertos/task.h>
+#endif
 #include "DW1000Ng.hpp"
 #include "DW1000NgUtils.hpp"
 #include "DW1000NgConstants.hpp"
 #include "DW1000NgRegisters.hpp"
+#include "DW1000NgRanging.hpp"
 #include "SPIporting.hpp"
 
 namespace DW1000Ng {
@@ -74,6 +80,14 @@ namespace DW1000Ng {
 		void (* _handleReceiveTimeout)(void)            = nullptr;
 		void (* _handleReceiveTimestampAvailable)(void) = nullptr;
 
+		/* SPI completion callbacks */
+		void (* _handleReceivedData)(void)              = nullptr;
+		void (* _handleAccumulatorData)(void)           = nullptr;
+
+		/* PMSC_CTRL0 bytes for accumulator reads, must outlive the queued writes */
+		byte _accClockOn[2];
+		byte _accClockOff[2];
+
 		/* registers */
 		byte       _syscfg[LEN_SYS_CFG];
 		byte       _sysctrl[LEN_SYS_CTRL];
@@ -83,6 +97,29 @@ namespace DW1000Ng {
 		byte       _chanctrl[LEN_CHAN_CTRL];
 		byte       _networkAndAddress[LEN_PANADR];
 
+		/* write-through cache: what the chip holds for the registers above that
+		 * the driver owns, so writes only send the bytes a setter changed */
+		constexpr byte CACHED_SYS_CFG   = 0x01;
+		constexpr byte CACHED_TX_FCTRL  = 0x02;
+		constexpr byte CACHED_SYS_MASK  = 0x04;
+		constexpr byte CACHED_CHAN_CTRL = 0x08;
+		byte       _syscfgChip[LEN_SYS_CFG];
+		byte       _txfctrlChip[LEN_TX_FCTRL];
+		byte       _sysmaskChip[LEN_SYS_MASK];
+		byte       _chanctrlChip[LEN_CHAN_CTRL];
+		byte       _cachedRegisters = 0;
+
+#if DW1000NG_RX_QUEUE
+		/* receive queue: the ISR is the only writer of _rxQueueHead, popFrame()
+		 * the only writer of _rxQueueTail, so no locking is needed */
+		static_assert((DW1000NG_RX_QUEUE_SLOTS & (DW1000NG_RX_QUEUE_SLOTS - 1)) == 0 && DW1000NG_RX_QUEUE_SLOTS <= 128,
+			"DW1000NG_RX_QUEUE_SLOTS must be a power of two up to 128");
+		rx_frame_t        _rxQueue[DW1000NG_RX_QUEUE_SLOTS];
+		volatile uint8_t  _rxQueueHead = 0;
+		volatile uint8_t  _rxQueueTail = 0;
+		volatile uint16_t _rxQueueDropped = 0;
+#endif
+
 		/* Temperature and Voltage monitoring */
 		byte _vmeas3v3 = 0;
 		byte _tmeas23C = 0;
@@ -98,16 +135,57 @@ namespace DW1000Ng {
 		boolean     	_smartPower;
 		boolean     	_frameCheck;
 		boolean     	_debounceClockEnabled = false;
+		boolean     	_doubleBuffering = false;
+		volatile boolean _inInterruptServiceRoutine = false;
+
+	#if DW1000NG_ESP32_SPI_DMA
+		/* Register accesses wait on the spi_master queue, which a GPIO ISR must
+		 * not do: the IRQ pin only wakes _irqTask, which runs
+		 * interruptServiceRoutine() while holding _irqMutex */
+		TaskHandle_t _irqTask = nullptr;
+		SemaphoreHandle_t _irqMutex = nullptr;
+	#elif defined(ESP32)
+		portMUX_TYPE _irqMux = portMUX_INITIALIZER_UNLOCKED;
+	#endif
 		boolean     	_nlos = false;
 		boolean			_standardSFD = true;
 		boolean     	_autoTXPower = true;
 		boolean     	_autoTCPGDelay = true;
 		boolean 		_wait4resp = false;
+
+		/* Reply scheduling, see scheduleReplyAfterRx() */
+		uint32_t		_replyDelayUs = DW1000NG_REPLY_DELAY_US;
+		uint64_t		_replyRxTimestamp = 0;
+		boolean			_replyScheduled = false;
+		uint8_t			_replyTuningLeft = 0;
+		uint64_t		_replyTurnaroundMax = 0;
+		boolean			_transmitLate = false;
 		uint16_t		_antennaTxDelay = 0;
 		uint16_t		_antennaRxDelay = 0;
 
 		/* ############################# PRIVATE METHODS ################################### */
 		
+		/*
+		* Builds the 1 to 3 byte SPI header for a register access, returns its length.
+		*/
+		uint8_t _buildHeader(byte header[], byte mode, byte modeSub, byte cmd, uint16_t offset) {
+			uint8_t headerLen = 1;
+			if(offset == NO_SUB) {
+				header[0] = mode | cmd;
+			} else {
+				header[0] = modeSub | cmd;
+				if(offset < 128) {
+					header[1] = (byte)offset;
+					headerLen++;
+				} else {
+					header[1] = RW_SUB_EXT | (byte)offset;
+					header[2] = (byte)(offset >> 7);
+					headerLen += 2;
+				}
+			}
+			return headerLen;
+		}
+
 		/*
 		* Write bytes to the DW1000. Single bytes can be written to registers via sub-addressing.
 		* @param[in] cmd
@@ -124,23 +202,8 @@ namespace DW1000Ng {
 		// TODO offset really bigger than byte?
 		void _writeBytesToRegister(byte cmd, uint16_t offset, byte data[], uint16_t data_size) {
 			byte header[3];
-			uint8_t headerLen = 1;
-			
 			// TODO proper error handling: address out of bounds
-			// build SPI header
-			if(offset == NO_SUB) {
-				header[0] = WRITE | cmd;
-			} else {
-				header[0] = WRITE_SUB | cmd;
-				if(offset < 128) {
-					header[1] = (byte)offset;
-					headerLen++;
-				} else {
-					header[1] = RW_SUB_EXT | (byte)offset;
-					header[2] = (byte)(offset >> 7);
-					headerLen += 2;
-				}
-			}
+			uint8_t headerLen = _buildHeader(header, WRITE, WRITE_SUB, cmd, offset);
 			
 			SPIporting::writeToSPI(_ss, headerLen, header, data_size, data);
 		}
@@ -190,22 +253,7 @@ namespace DW1000Ng {
 		*/
 		void _readBytesFromRegister(byte cmd, uint16_t offset, byte data[], uint16_t data_size) {
 			byte header[3];
-			uint8_t headerLen = 1;
-			
-			// build SPI header
-			if(offset == NO_SUB) {
-				header[0] = READ | cmd;
-			} else {
-				header[0] = READ_SUB | cmd;
-				if(offset < 128) {
-					header[1] = (byte)offset;
-					headerLen++;
-				} else {
-					header[1] = RW_SUB_EXT | (byte)offset;
-					header[2] = (byte)(offset >> 7);
-					headerLen += 2;
-				}
-			}
+			uint8_t headerLen = _buildHeader(header, READ, READ_SUB, cmd, offset);
 
 			SPIporting::readFromSPI(_ss, headerLen, header, data_size, data);
 		}
@@ -814,20 +862,55 @@ namespace DW1000Ng {
 			_writeBytesToRegister(PANADR, NO_SUB, _networkAndAddress, LEN_PANADR);
 		}
 
+		/*
+		* Writes the bytes of a cached register whose shadow differs from the chip
+		* (the dirty mask), as one burst from the first to the last dirty byte.
+		* Everything is written while the chip content is unknown.
+		*/
+		void _flushRegister(byte cmd, byte shadow[], byte chip[], uint16_t len, byte cachedBit) {
+			byte dirty = 0;
+			for(uint16_t i = 0; i < len; i++) {
+				if(!(_cachedRegisters & cachedBit) || shadow[i] != chip[i])
+					dirty |= (1 << i);
+			}
+			if(dirty == 0)
+				return;
+			uint16_t first = 0;
+			uint16_t last = len - 1;
+			while(!(dirty & (1 << first)))
+				first++;
+			while(!(dirty & (1 << last)))
+				last--;
+			_writeBytesToRegister(cmd, first == 0 ? NO_SUB : first, shadow + first, last - first + 1);
+			memcpy(chip + first, shadow + first, last - first + 1);
+			_cachedRegisters |= cachedBit;
+		}
+
+		/* Chip content read back: shadow and cache both hold it */
+		void _fillRegisterCache(byte shadow[], byte chip[], uint16_t len, byte cachedBit) {
+			memcpy(chip, shadow, len);
+			_cachedRegisters |= cachedBit;
+		}
+
+		/* After resets, wake-ups or raw writes the chip content is unknown */
+		void _invalidateRegisterCache() {
+			_cachedRegisters = 0;
+		}
+
 		void _writeSystemConfigurationRegister() {
-			_writeBytesToRegister(SYS_CFG, NO_SUB, _syscfg, LEN_SYS_CFG);
+			_flushRegister(SYS_CFG, _syscfg, _syscfgChip, LEN_SYS_CFG, CACHED_SYS_CFG);
 		}
 
 		void _writeChannelControlRegister() {
-			_writeBytesToRegister(CHAN_CTRL, NO_SUB, _chanctrl, LEN_CHAN_CTRL);
+			_flushRegister(CHAN_CTRL, _chanctrl, _chanctrlChip, LEN_CHAN_CTRL, CACHED_CHAN_CTRL);
 		}
 
 		void _writeTransmitFrameControlRegister() {
-			_writeBytesToRegister(TX_FCTRL, NO_SUB, _txfctrl, LEN_TX_FCTRL);
+			_flushRegister(TX_FCTRL, _txfctrl, _txfctrlChip, LEN_TX_FCTRL, CACHED_TX_FCTRL);
 		}
 
 		void _writeSystemEventMaskRegister() {
-			_writeBytesToRegister(SYS_MASK, NO_SUB, _sysmask, LEN_SYS_MASK);
+			_flushRegister(SYS_MASK, _sysmask, _sysmaskChip, LEN_SYS_MASK, CACHED_SYS_MASK);
 		}
 
 		void _writeAntennaDelayRegisters() {
@@ -1113,7 +1196,9 @@ namespace DW1000Ng {
 			_writeBytesToRegister(FS_CTRL, FS_XTALT_SUB, fsxtalt, LEN_FS_XTALT);
 		}
 
-		void _clearReceiveStatus() {
+		/* The _mark* helpers set the write-1-to-clear bits of an event in
+		 * _sysstatus, _writeSystemEventStatusRegister() then clears them all at once */
+		void _markReceiveStatus() {
 			// clear latched RX bits (i.e. write 1 to clear)
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXDFR_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXFCG_BIT, true);
@@ -1121,39 +1206,62 @@ namespace DW1000Ng {
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXSFDD_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXPHD_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, LDEDONE_BIT, true);
-			_writeBytesToRegister(SYS_STATUS, NO_SUB, _sysstatus, LEN_SYS_STATUS);
 		}
 
-		void _clearReceiveTimestampAvailableStatus() {
+		void _markReceiveTimestampAvailableStatus() {
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, LDEDONE_BIT, true);
-			_writeBytesToRegister(SYS_STATUS, NO_SUB, _sysstatus, LEN_SYS_STATUS);
 		}
 
-		void _clearReceiveTimeoutStatus() {
+		void _markReceiveOverrunStatus() {
+			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXOVRR_BIT, true);
+		}
+
+		void _markReceiveTimeoutStatus() {
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXRFTO_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXPTO_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXSFDTO_BIT, true);
-			_writeBytesToRegister(SYS_STATUS, NO_SUB, _sysstatus, LEN_SYS_STATUS);
 		}
 
-		void _clearReceiveFailedStatus() {
+		void _markReceiveFailedStatus() {
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXPHE_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXFCE_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, RXRFSL_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, AFFREJ_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, LDEERR_BIT, true);
-			_writeBytesToRegister(SYS_STATUS, NO_SUB, _sysstatus, LEN_SYS_STATUS);
 		}
 
-		void _clearTransmitStatus() {
+		void _markTransmitStatus() {
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, AAT_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, TXFRB_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, TXPRS_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, TXPHS_BIT, true);
 			DW1000NgUtils::setBit(_sysstatus, LEN_SYS_STATUS, TXFRS_BIT, true);
+		}
+
+		void _writeSystemEventStatusRegister() {
 			_writeBytesToRegister(SYS_STATUS, NO_SUB, _sysstatus, LEN_SYS_STATUS);
 		}
 
+		void _clearReceiveStatus() {
+			_markReceiveStatus();
+			_writeSystemEventStatusRegister();
+		}
+
+		void _clearReceiveTimeoutStatus() {
+			_markReceiveTimeoutStatus();
+			_writeSystemEventStatusRegister();
+		}
+
+		void _clearReceiveFailedStatus() {
+			_markReceiveFailedStatus();
+			_writeSystemEventStatusRegister();
+		}
+
+		void _clearTransmitStatus() {
+			_markTransmitStatus();
+			_writeSystemEventStatusRegister();
+		}
+
 		void _resetReceiver() {
 			/* Set to 0 only bit 28 */
 			_writeValueToRegister(PMSC, PMSC_SOFTRESET_SUB, 0xE0, LEN_PMSC_SOFTRESET);
@@ -1161,10 +1269,26 @@ namespace DW1000Ng {
 			_writeValueToRegister(PMSC, PMSC_SOFTRESET_SUB, 0xF0, LEN_PMSC_SOFTRESET);
 		}
 
+#if DW1000NG_RX_QUEUE
+		/* Copies the frame just received into the next free queue slot, or counts it as dropped */
+		void _queueReceivedFrame() {
+			uint8_t head = _rxQueueHead;
+			if((uint8_t)(head - _rxQueueTail) >= DW1000NG_RX_QUEUE_SLOTS) {
+				_rxQueueDropped++;
+				return;
+			}
+			rx_frame_t& slot = _rxQueue[head & (DW1000NG_RX_QUEUE_SLOTS - 1)];
+			slot.snapshot = readFrameSnapshot(slot.data, DW1000NG_RX_QUEUE_FRAME_LEN);
+			slot.length = slot.snapshot.length < DW1000NG_RX_QUEUE_FRAME_LEN ? slot.snapshot.length : DW1000NG_RX_QUEUE_FRAME_LEN;
+			_rxQueueHead = head + 1;
+		}
+#endif
+
 		/* Internal helpers to read configuration */
 
 		void _readSystemConfigurationRegister() {
 			_readBytesFromRegister(SYS_CFG, NO_SUB, _syscfg, LEN_SYS_CFG);
+			_fillRegisterCache(_syscfg, _syscfgChip, LEN_SYS_CFG, CACHED_SYS_CFG);
 		}
 
 		void _readSystemEventStatusRegister() {
@@ -1177,14 +1301,135 @@ namespace DW1000Ng {
 
 		void _readSystemEventMaskRegister() {
 			_readBytesFromRegister(SYS_MASK, NO_SUB, _sysmask, LEN_SYS_MASK);
+			_fillRegisterCache(_sysmask, _sysmaskChip, LEN_SYS_MASK, CACHED_SYS_MASK);
 		}
 
 		void _readChannelControlRegister() {
 			_readBytesFromRegister(CHAN_CTRL, NO_SUB, _chanctrl, LEN_CHAN_CTRL);
+			_fillRegisterCache(_chanctrl, _chanctrlChip, LEN_CHAN_CTRL, CACHED_CHAN_CTRL);
 		}
 
 		void _readTransmitFrameControlRegister() {
 			_readBytesFromRegister(TX_FCTRL, NO_SUB, _txfctrl, LEN_TX_FCTRL);
+			_fillRegisterCache(_txfctrl, _txfctrlChip, LEN_TX_FCTRL, CACHED_TX_FCTRL);
+		}
+
+		/* Double buffering: hands the host side buffer back to the receiver and
+		 * shows the other one, with its RX status bits, in its place */
+		void _toggleHostReceiveBuffer() {
+			memset(_sysctrl, 0, LEN_SYS_CTRL);
+			DW1000NgUtils::setBit(_sysctrl, LEN_SYS_CTRL, HRBPT_BIT, true);
+			_writeBytesToRegister(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
+		}
+
+		/* Keep interruptServiceRoutine() from running until _restoreIrq(), which
+		 * puts back the interrupt state the caller had */
+	#if defined(__AVR__) || defined(DW1000NG_HOST)
+		typedef uint8_t irq_state_t;
+
+		irq_state_t _maskIrq() {
+			irq_state_t state = SREG;
+			cli();
+			return state;
+		}
+
+		void _restoreIrq(irq_state_t state) {
+			SREG = state;
+		}
+	#elif DW1000NG_ESP32_SPI_DMA
+		typedef boolean irq_state_t;
+
+		irq_state_t _maskIrq() {
+			xSemaphoreTakeRecursive(_irqMutex, portMAX_DELAY);
+			return true;
+		}
+
+		void _restoreIrq(irq_state_t) {
+			xSemaphoreGiveRecursive(_irqMutex);
+		}
+	#elif defined(ESP32)
+		typedef boolean irq_state_t;
+
+		irq_state_t _maskIrq() {
+			portENTER_CRITICAL(&_irqMux);
+			return true;
+		}
+
+		void _restoreIrq(irq_state_t) {
+			portEXIT_CRITICAL(&_irqMux);
+		}
+	#elif defined(ESP8266)
+		typedef uint32_t irq_state_t;
+
+		irq_state_t _maskIrq() {
+			return xt_rsil(15);
+		}
+
+		void _restoreIrq(irq_state_t state) {
+			xt_wsr_ps(state);
+		}
+	#elif defined(__arm__)
+		typedef uint32_t irq_state_t;
+
+		irq_state_t _maskIrq() {
+			irq_state_t state = __get_PRIMASK();
+			__disable_irq();
+			return state;
+		}
+
+		void _restoreIrq(irq_state_t state) {
+			__set_PRIMASK(state);
+		}
+	#else
+		#error "DW1000Ng: no interrupt masking for this architecture"
+	#endif
+
+	#if DW1000NG_ESP32_SPI_DMA
+		void IRAM_ATTR _notifyIrqTask() {
+			BaseType_t woken = pdFALSE;
+			vTaskNotifyGiveFromISR(_irqTask, &woken);
+			if(woken == pdTRUE)
+				portYIELD_FROM_ISR();
+		}
+
+		void _runIrqTask(void*) {
+			for(;;) {
+				ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+				xSemaphoreTakeRecursive(_irqMutex, portMAX_DELAY);
+				interruptServiceRoutine();
+				xSemaphoreGiveRecursive(_irqMutex);
+			}
+		}
+
+		void _attachIrq() {
+			if(_irqTask == nullptr) {
+				_irqMutex = xSemaphoreCreateRecursiveMutex();
+				xTaskCreate(_runIrqTask, "DW1000Ng IRQ", DW1000NG_ESP32_IRQ_TASK_STACK, nullptr,
+							DW1000NG_ESP32_IRQ_TASK_PRIORITY, &_irqTask);
+			}
+			attachInterrupt(digitalPinToInterrupt(_irq), _notifyIrqTask, RISING);
+		}
+	#else
+		void _attachIrq() {
+			attachInterrupt(digitalPinToInterrupt(_irq), interruptServiceRoutine, RISING);
+		}
+	#endif
+
+		/* Double buffering: points the host side at the buffer the receiver fills next.
+		 * The status read and the toggle are two SPI transactions; outside the ISR,
+		 * the ISR is held off in between so it cannot toggle the pointer first. */
+		void _syncReceiveBufferPointers() {
+			if(!_doubleBuffering)
+				return;
+			boolean masked = !_inInterruptServiceRoutine;
+			irq_state_t state = 0;
+			if(masked)
+				state = _maskIrq();
+			_readSystemEventStatusRegister();
+			if(DW1000NgUtils::getBit(_sysstatus, LEN_SYS_STATUS, HSRBP_BIT) != DW1000NgUtils::getBit(_sysstatus, LEN_SYS_STATUS, ICRBP_BIT))
+				_toggleHostReceiveBuffer();
+			if(masked)
+				_restoreIrq(state);
 		}
 
 		boolean _isTransmitDone() {
@@ -1210,6 +1455,11 @@ namespace DW1000Ng {
 					DW1000NgUtils::getBit(_sysstatus, LEN_SYS_STATUS, LDEERR_BIT));
 		}
 
+		/* Both receive buffers were full when another frame arrived (double buffering only) */
+		boolean _isReceiveOverrun() {
+			return DW1000NgUtils::getBit(_sysstatus, LEN_SYS_STATUS, RXOVRR_BIT);
+		}
+
 		boolean _isReceiveTimeout() {
 			return (DW1000NgUtils::getBit(_sysstatus, LEN_SYS_STATUS, RXRFTO_BIT) || 
 					DW1000NgUtils::getBit(_sysstatus, LEN_SYS_STATUS, RXPTO_BIT) || 
@@ -1241,11 +1491,164 @@ namespace DW1000Ng {
 			/* Clear the register */
 			_writeValueToRegister(AON, AON_CTRL_SUB, 0x00, LEN_AON_CTRL);
 		}
+
+		uint16_t _preambleAccumulation(byte rxFrameInfo[]) {
+			return (((uint16_t)rxFrameInfo[2] >> 4) & 0xFF) | ((uint16_t)rxFrameInfo[3] << 4);
+		}
+
+		/* int16_t limits of the Q8.8 powers, no power at all reads as the minimum */
+		constexpr int32_t POWER_Q8_MIN = -32768;
+		constexpr int32_t POWER_Q8_MAX = 32767;
+
+		/* log2(1 + i/32) in Q0.16, interpolated linearly by _log2Q12() */
+		const uint16_t _log2Table[32] PROGMEM = {
+			0, 2909, 5732, 8473, 11136, 13727, 16248, 18704,
+			21098, 23433, 25711, 27936, 30109, 32234, 34312, 36346,
+			38336, 40286, 42196, 44068, 45904, 47705, 49472, 51207,
+			52911, 54584, 56229, 57845, 59434, 60997, 62534, 64047
+		};
+
+		/* log2(x) in Q20.12, x > 0 */
+		int32_t _log2Q12(uint32_t x) {
+			int8_t msb = 31;
+			while(!(x & 0x80000000)) {
+				x <<= 1;
+				msb--;
+			}
+			uint8_t i = (x >> 26) & 0x1F;
+			uint32_t frac = (x >> 10) & 0xFFFF;
+			uint32_t lo = pgm_read_word(&_log2Table[i]);
+			uint32_t hi = i < 31 ? pgm_read_word(&_log2Table[i + 1]) : 65536;
+			return (int32_t)msb * 4096 + ((lo + (((hi - lo) * frac) >> 16)) >> 4);
+		}
+
+		/* 10*log10(x) in Q8.8 from log2(x) in Q12: 12330 = 10*log10(2) in Q12 */
+		int32_t _decibelQ8(int32_t log2Q12) {
+			return (log2Q12 * 12330 + 32768) >> 16;
+		}
+
+		/* Power in dBm (Q8.8) from the estimated level, user manual 4.7.1/4.7.2
+		 * with the approximation of Fig. 22 above -88 dBm */
+		int16_t _correctedPowerQ8(int32_t estPwr) {
+			int32_t A, corrFac;
+			if(_pulseFrequency == PulseFrequency::FREQ_16MHZ) {
+				A       = 29125; // 113.77 in Q8.8
+				corrFac = 9558;  // 2.3334 in Q12
+			} else {
+				A       = 31165; // 121.74 in Q8.8
+				corrFac = 4779;  // 1.1667 in Q12
+			}
+			estPwr -= A;
+			if(estPwr > -88 * 256) {
+				estPwr += ((estPwr + 88 * 256) * corrFac) >> 12;
+			}
+			if(estPwr < POWER_Q8_MIN) {
+				return POWER_Q8_MIN;
+			}
+			if(estPwr > POWER_Q8_MAX) {
+				return POWER_Q8_MAX;
+			}
+			return estPwr;
+		}
+
+		int16_t _firstPathPowerQ8(uint16_t f1, uint16_t f2, uint16_t f3, uint16_t N) {
+			uint32_t sum = 0;
+			uint8_t shift = 0;
+			uint16_t f[3] = {f1, f2, f3};
+			for(uint8_t i = 0; i < 3; i++) {
+				uint32_t square = (uint32_t)f[i] * f[i];
+				/* keep the sum of squares in 32 bits, at most two halvings */
+				while(sum + (square >> shift) < sum) {
+					sum >>= 1;
+					shift++;
+				}
+				sum += square >> shift;
+			}
+			if(sum == 0 || N == 0) {
+				return POWER_Q8_MIN;
+			}
+			return _correctedPowerQ8(_decibelQ8(_log2Q12(sum) + (int32_t)shift * 4096 - 2 * _log2Q12(N)));
+		}
+
+		int16_t _receivePowerQ8(uint16_t C, uint16_t N) {
+			if(C == 0 || N == 0) {
+				return POWER_Q8_MIN;
+			}
+			// C * 2^17 / N^2
+			return _correctedPowerQ8(_decibelQ8(_log2Q12(C) + 17 * 4096 - 2 * _log2Q12(N)));
+		}
+
+		/* TX_FCTRL TFLEN and TFLE, frame length with FCS */
+		void _setTransmitFrameLength(uint16_t n) {
+			_txfctrl[0] = (byte)(n & 0xFF); // 1 byte (regular length + 1 bit)
+			_txfctrl[1] &= 0xE0;
+			_txfctrl[1] |= (byte)((n >> 8) & 0x03);  // 2 added bits if extended length
+		}
+
+		/* TX_FCTRL TXBOFFS, bits 22-31: where in TX_BUFFER the frame starts */
+		void _setTransmitBufferOffset(uint16_t offset) {
+			_txfctrl[2] &= 0x3F;
+			_txfctrl[2] |= (byte)((offset << 6) & 0xC0);
+			_txfctrl[3] = (byte)((offset >> 2) & 0xFF);
+		}
+
+		/* TX_BUFFER write at any index, index NO_SUB (255) would otherwise mean no sub-address */
+		void _writeTransmitBuffer(uint16_t index, byte data[], uint16_t n) {
+			if(index != NO_SUB) {
+				_writeBytesToRegister(TX_BUFFER, index, data, n);
+				return;
+			}
+			byte header[] = {(byte)(WRITE_SUB | TX_BUFFER), (byte)(RW_SUB_EXT | (index & 0x7F)), (byte)(index >> 7)};
+			SPIporting::writeToSPI(_ss, 3, header, n, data);
+		}
+
+		boolean _checkTransmitTemplate(const tx_template_t& frame) {
+			uint16_t n = _frameCheck ? frame.length + 2 : frame.length;
+			if(n > (_extendedFrameLength ? LEN_EXT_UWB_FRAMES : LEN_UWB_FRAMES)) {
+				return false;
+			}
+			return frame.bufferOffset + n <= LEN_TX_BUFFER;
+		}
+
+		/* UWB ticks per 10 us, 63.8976 GHz */
+		constexpr uint64_t TICKS_PER_10US = 638976;
+
+		/* preamble and SFD airtime before the RMARKER, rounded up */
+		uint16_t _preambleDurationUs() {
+			uint32_t symbols;
+			switch(_preambleLength) {
+				case PreambleLength::LEN_64:   symbols = 64; break;
+				case PreambleLength::LEN_128:  symbols = 128; break;
+				case PreambleLength::LEN_256:  symbols = 256; break;
+				case PreambleLength::LEN_512:  symbols = 512; break;
+				case PreambleLength::LEN_1024: symbols = 1024; break;
+				case PreambleLength::LEN_1536: symbols = 1536; break;
+				case PreambleLength::LEN_2048: symbols = 2048; break;
+				default:                       symbols = 4096; break;
+			}
+			symbols += _dataRate == DataRate::RATE_110KBPS ? 64 : 16;
+			/* a symbol lasts 993.6 ns at 16 MHz PRF, 1017.6 ns at 64 MHz PRF */
+			return symbols * 1018 / 1000 + 1;
+		}
+
+		/* tuning: how long after the RX timestamp the delayed transmit got started */
+		void _measureReplyTurnaround() {
+			byte data[LEN_SYS_TIME];
+			_readBytesFromRegister(SYS_TIME, NO_SUB, data, LEN_SYS_TIME);
+			uint64_t turnaround = (DW1000NgUtils::bytesAsValue(data, LEN_SYS_TIME) - _replyRxTimestamp) & TIME_MAX;
+			if(turnaround > _replyTurnaroundMax)
+				_replyTurnaroundMax = turnaround;
+			uint32_t needed = _replyTurnaroundMax * 10 / TICKS_PER_10US + _preambleDurationUs() + DW1000NG_REPLY_MARGIN_US;
+			/* grow at once so the rest of the run is not late, shrink only at the end */
+			if(--_replyTuningLeft == 0 || needed > _replyDelayUs)
+				_replyDelayUs = needed;
+		}
 	}
 
 	/* ####################### PUBLIC ###################### */
 
 	void initialize(uint8_t ss, uint8_t irq, uint8_t rst, SPIClass&spi) {
+		DW1000NG_PROFILE_API("initialize");
 		// generous initial init/wake-up-idle delay
 		delay(5);
 		_ss = ss;
@@ -1262,7 +1665,7 @@ namespace DW1000Ng {
 		// attach interrupt
 		// TODO throw error if pin is not a interrupt pin
 		if(_irq != 0xff)
-			attachInterrupt(digitalPinToInterrupt(_irq), interruptServiceRoutine, RISING);
+			_attachIrq();
 		SPIporting::SPIselect(_ss, _irq);
 		// reset chip (either soft or hard)
 		reset();
@@ -1294,6 +1697,7 @@ namespace DW1000Ng {
 
 		_readNetworkIdAndDeviceAddress();
 		_readSystemConfigurationRegister();
+		_doubleBuffering = !DW1000NgUtils::getBit(_syscfg, LEN_SYS_CFG, DIS_DRXB_BIT);
 		_readChannelControlRegister();
 		_readTransmitFrameControlRegister();
 		_readSystemEventMaskRegister();
@@ -1332,79 +1736,122 @@ namespace DW1000Ng {
 		_handleReceiveTimestampAvailable = handleReceiveTimestampAvailable;
 	}
 
+	void attachReceivedDataHandler(void (* handleReceivedData)(void)) {
+		_handleReceivedData = handleReceivedData;
+	}
+
+	void attachAccumulatorDataHandler(void (* handleAccumulatorData)(void)) {
+		_handleAccumulatorData = handleAccumulatorData;
+	}
+
 #if defined(ESP8266)
 	void ICACHE_RAM_ATTR interruptServiceRoutine() {
 #else
 	void interruptServiceRoutine() {
 #endif		// read current status and handle via callbacks
+		DW1000NG_PROFILE_API("interruptServiceRoutine");
+		_inInterruptServiceRoutine = true;
 		_readSystemEventStatusRegister();
-		if(_isClockProblem() /* TODO and others */ && _handleError != 0) {
+		/* decide on this one status read, then clear every handled event with a
+		 * single write before any handler can start new activity */
+		boolean clockProblem = _isClockProblem();
+		boolean transmitDone = _isTransmitDone();
+		boolean receiveTimestampAvailable = _isReceiveTimestampAvailable();
+		boolean receiveOverrun = _doubleBuffering && _isReceiveOverrun();
+		boolean receiveFailed = _isReceiveFailed() || receiveOverrun;
+		boolean receiveTimeout = !receiveFailed && _isReceiveTimeout();
+		boolean receiveDone = !receiveFailed && !receiveTimeout && _isReceiveDone();
+		if(transmitDone)
+			_markTransmitStatus();
+		if(receiveTimestampAvailable)
+			_markReceiveTimestampAvailableStatus();
+		if(receiveFailed)
+			_markReceiveFailedStatus();
+		if(receiveOverrun)
+			_markReceiveOverrunStatus();
+		if(receiveTimeout)
+			_markReceiveTimeoutStatus();
+		if(receiveDone)
+			_markReceiveStatus();
+		if(transmitDone || receiveTimestampAvailable || receiveFailed || receiveTimeout || receiveDone)
+			_writeSystemEventStatusRegister();
+
+		if(clockProblem /* TODO and others */ && _handleError != 0) {
 			(*_handleError)();
 		}
-		if(_isTransmitDone()) {
-			_clearTransmitStatus();
-			if(_handleSent != nullptr)
-				(*_handleSent)();
+		if(transmitDone && _handleSent != nullptr) {
+			(*_handleSent)();
 		}
-		if(_isReceiveTimestampAvailable()) {
-			_clearReceiveTimestampAvailableStatus();
-			if(_handleReceiveTimestampAvailable != nullptr)
-				(*_handleReceiveTimestampAvailable)();
+		if(receiveTimestampAvailable && _handleReceiveTimestampAvailable != nullptr) {
+			(*_handleReceiveTimestampAvailable)();
 		}
-		if(_isReceiveFailed()) {
-			_clearReceiveFailedStatus();
+		if(receiveFailed) {
 			forceTRxOff();
 			_resetReceiver();
 			if(_handleReceiveFailed != nullptr)
 				(*_handleReceiveFailed)();
-		} else if(_isReceiveTimeout()) {
-			_clearReceiveTimeoutStatus();
+		} else if(receiveTimeout) {
 			forceTRxOff();
 			_resetReceiver();
 			if(_handleReceiveTimeout != nullptr)
 				(*_handleReceiveTimeout)();
-		} else if(_isReceiveDone()) {
-			_clearReceiveStatus();
+		} else if(receiveDone) {
+#if DW1000NG_RX_QUEUE
+			_queueReceivedFrame();
+#endif
 			if(_handleReceived != nullptr)
 				(*_handleReceived)();
+			/* the frame has been read (queue or handler), give its buffer back to the
+			 * receiver; a frame already in the other one raises the IRQ line again */
+			if(_doubleBuffering)
+				_toggleHostReceiveBuffer();
 		}
+		_inInterruptServiceRoutine = false;
 	}
 
 	boolean isTransmitDone(){
+		DW1000NG_PROFILE_API("isTransmitDone");
 		_readSystemEventStatusRegister();
 		return _isTransmitDone();
 	}
 
 	void clearTransmitStatus() {
+		DW1000NG_PROFILE_API("clearTransmitStatus");
 		_clearTransmitStatus();
 	}
 
 	boolean isReceiveDone() {
+		DW1000NG_PROFILE_API("isReceiveDone");
 		_readSystemEventStatusRegister();
 		return _isReceiveDone();
 	}
 
 	void clearReceiveStatus() {
+		DW1000NG_PROFILE_API("clearReceiveStatus");
 		_clearReceiveStatus();
 	}
 
 	boolean isReceiveFailed() {
+		DW1000NG_PROFILE_API("isReceiveFailed");
 		_readSystemEventStatusRegister();
 		return _isReceiveFailed();
 	}
 
 	void clearReceiveFailedStatus() {
+		DW1000NG_PROFILE_API("clearReceiveFailedStatus");
 		_clearReceiveFailedStatus();
 		forceTRxOff();
 		_resetReceiver();
 	}
 
 	boolean isReceiveTimeout() {
+		DW1000NG_PROFILE_API("isReceiveTimeout");
 		_readSystemEventMaskRegister();
 		return _isReceiveTimeout();
 	}
 
 	void clearReceiveTimeoutStatus() {
+		DW1000NG_PROFILE_API("clearReceiveTimeoutStatus");
 		_clearReceiveTimeoutStatus();
 		forceTRxOff();
 		_resetReceiver();
@@ -1467,6 +1914,7 @@ namespace DW1000Ng {
 		_writeValueToRegister(AON, AON_CTRL_SUB, 0x00, LEN_AON_CTRL);
 		/* Write 1 in SAVE_BIT */
 		_writeValueToRegister(AON, AON_CTRL_SUB, 0x02, LEN_AON_CTRL);
+		_invalidateRegisterCache();
 	}
 
 	void spiWakeup(){
@@ -1479,6 +1927,7 @@ namespace DW1000Ng {
 			delay(1);
 			digitalWrite(_ss, HIGH);
 			delay(5);
+			_invalidateRegisterCache();
 			setTxAntennaDelay(_antennaTxDelay);
 			if (_debounceClockEnabled){
 					enableDebounceClock();
@@ -1487,6 +1936,7 @@ namespace DW1000Ng {
 	}
 
 	void reset() {
+		DW1000NG_PROFILE_API("reset");
 		if(_rst == 0xff) { /* Fallback to Software Reset */
 			softwareReset();
 		} else {
@@ -1497,9 +1947,12 @@ namespace DW1000Ng {
 			pinMode(_rst, INPUT);
 			delay(5); // dw1000Ng data sheet v1.2 page 5: nominal 3 ms, to be safe take more time
 		}
+		_invalidateRegisterCache();
 	}
 
 	void softwareReset() {
+		DW1000NG_PROFILE_API("softwareReset");
+		_invalidateRegisterCache();
 		SPIporting::setSPIspeed(SPIClock::SLOW);
 		
 		/* Disable sequencing and go to state "INIT" - (a) Sets SYSCLKS to 01 */
@@ -1619,6 +2072,7 @@ namespace DW1000Ng {
 	* ######################################################################### */
 
 	void setNetworkId(uint16_t val) {
+		DW1000NG_PROFILE_API("setNetworkId");
 		_networkAndAddress[2] = (byte)(val & 0xFF);
 		_networkAndAddress[3] = (byte)((val >> 8) & 0xFF);
 		_writeNetworkIdAndDeviceAddress();
@@ -1631,6 +2085,7 @@ namespace DW1000Ng {
 	}
 
 	void setDeviceAddress(uint16_t val) {
+		DW1000NG_PROFILE_API("setDeviceAddress");
 		_networkAndAddress[0] = (byte)(val & 0xFF);
 		_networkAndAddress[1] = (byte)((val >> 8) & 0xFF);
 		_writeNetworkIdAndDeviceAddress();
@@ -1662,6 +2117,14 @@ namespace DW1000Ng {
 		_readBytesFromRegister(EUI, NO_SUB, eui, LEN_EUI);
 	}
 
+	void getPartAndLotId(uint32_t& partId, uint32_t& lotId) {
+		byte buf_otp[4];
+		_readBytesOTP(0x006, buf_otp); // PARTID, see 6.3.1 OTP memory map
+		partId = (uint32_t)DW1000NgUtils::bytesAsValue(buf_otp, 4);
+		_readBytesOTP(0x007, buf_otp); // LOTID
+		lotId = (uint32_t)DW1000NgUtils::bytesAsValue(buf_otp, 4);
+	}
+
 	float getTemperature() {
 		_vbatAndTempSteps();
 		byte sar_ltemp = 0; _readBytesFromRegister(TX_CAL, 0x04, &sar_ltemp, 1);
@@ -1675,6 +2138,7 @@ namespace DW1000Ng {
 	}
 
 	void getTemperatureAndBatteryVoltage(float& temp, float& vbat) {
+		DW1000NG_PROFILE_API("getTemperatureAndBatteryVoltage");
 		// follow the procedure from section 6.4 of the User Manual
 		_vbatAndTempSteps();
 		delay(1);
@@ -1706,10 +2170,16 @@ namespace DW1000Ng {
 	}
 
 	void setDoubleBuffering(boolean val) {
+		DW1000NG_PROFILE_API("setDoubleBuffering");
+		forceTRxOff();
+		_doubleBuffering = val;
 		DW1000NgUtils::setBit(_syscfg, LEN_SYS_CFG, DIS_DRXB_BIT, !val);
+		_writeSystemConfigurationRegister();
+		_syncReceiveBufferPointers();
 	}
 
 	void setAntennaDelay(uint16_t value) {
+		DW1000NG_PROFILE_API("setAntennaDelay");
 		_antennaTxDelay = value;
 		_antennaRxDelay = value;
 		_writeAntennaDelayRegisters();
@@ -1752,12 +2222,16 @@ namespace DW1000Ng {
 	}
 
 	void forceTRxOff() {
+		DW1000NG_PROFILE_API("forceTRxOff");
 		memset(_sysctrl, 0, LEN_SYS_CTRL);
 		DW1000NgUtils::setBit(_sysctrl, LEN_SYS_CTRL, TRXOFF_BIT, true);
 		_writeBytesToRegister(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
+		_syncReceiveBufferPointers();
 	}
 
 	void startReceive(ReceiveMode mode) {
+		DW1000NG_PROFILE_API("startReceive");
+		_syncReceiveBufferPointers();
 		memset(_sysctrl, 0, LEN_SYS_CTRL);
 		DW1000NgUtils::setBit(_sysctrl, LEN_SYS_CTRL, SFCST_BIT, !_frameCheck);
 		if(mode == ReceiveMode::DELAYED)
@@ -1767,6 +2241,7 @@ namespace DW1000Ng {
 	}
 
 	void startTransmit(TransmitMode mode) {
+		DW1000NG_PROFILE_API("startTransmit");
 		memset(_sysctrl, 0, LEN_SYS_CTRL);
 		DW1000NgUtils::setBit(_sysctrl, LEN_SYS_CTRL, SFCST_BIT, !_frameCheck);
 		if(mode == TransmitMode::DELAYED)
@@ -1776,6 +2251,38 @@ namespace DW1000Ng {
 
 		DW1000NgUtils::setBit(_sysctrl, LEN_SYS_CTRL, TXSTRT_BIT, true);
 		_writeBytesToRegister(SYS_CTRL, NO_SUB, _sysctrl, LEN_SYS_CTRL);
+
+		_transmitLate = false;
+		if(mode == TransmitMode::DELAYED) {
+			if(_replyScheduled && _replyTuningLeft > 0)
+				_measureReplyTurnaround();
+			_replyScheduled = false;
+
+			/* started after the DX_TIME slot: the chip would send one counter period (17 s) later, cancel it */
+			byte status;
+			_readBytesFromRegister(SYS_STATUS, HPDWARN_BIT / 8, &status, 1);
+			if(status & (1 << (HPDWARN_BIT % 8))) {
+				forceTRxOff();
+				status = 1 << (HPDWARN_BIT % 8);
+				_writeBytesToRegister(SYS_STATUS, HPDWARN_BIT / 8, &status, 1);
+				_transmitLate = true;
+			}
+		}
+	}
+
+	boolean isTransmitLate() {
+		return _transmitLate;
+	}
+
+	uint32_t getFrameDuration(uint16_t frameLength) {
+		if(_frameCheck)
+			frameLength += 2;
+		/* 48 parity bits per 330 data bits; PHR at 850 kb/s, or 110 kb/s in that mode */
+		uint32_t bits = frameLength * 8UL;
+		bits += (bits * 48 + 329) / 330;
+		uint32_t bitNs = _dataRate == DataRate::RATE_110KBPS ? 8206 : (_dataRate == DataRate::RATE_850KBPS ? 1026 : 129);
+		uint32_t phrNs = _dataRate == DataRate::RATE_110KBPS ? 21 * 8206UL : 21 * 1026UL;
+		return _preambleDurationUs() + (phrNs + bits * bitNs + 999) / 1000;
 	}
 
 	void setInterruptPolarity(boolean val) {
@@ -1784,6 +2291,7 @@ namespace DW1000Ng {
 	}
 
 	void applyConfiguration(device_configuration_t config) {
+		DW1000NG_PROFILE_API("applyConfiguration");
 		forceTRxOff();
 
 		_useExtendedFrameLength(config.extendedFrameLength);
@@ -1808,6 +2316,8 @@ namespace DW1000Ng {
 		_writeConfiguration();
 		// tune according to configuration
 		_tune();
+
+		DW1000NgRanging::selectBiasTable(_channel, _pulseFrequency);
 	}
 
 	Channel getChannel() {
@@ -1831,6 +2341,7 @@ namespace DW1000Ng {
 	}
 
 	void setReceiveFrameWaitTimeoutPeriod(uint16_t timeMicroSeconds) {
+		DW1000NG_PROFILE_API("setReceiveFrameWaitTimeoutPeriod");
 		if (timeMicroSeconds > 0) {
 			byte rx_wfto[LEN_RX_WFTO];
 			DW1000NgUtils::writeValueToBytes(rx_wfto, timeMicroSeconds, LEN_RX_WFTO);
@@ -1846,6 +2357,7 @@ namespace DW1000Ng {
 	}
 
 	void applyInterruptConfiguration(interrupt_configuration_t interrupt_config) {
+		DW1000NG_PROFILE_API("applyInterruptConfiguration");
 		forceTRxOff();
 
 		_interruptOnSent(interrupt_config.interruptOnSent);
@@ -1859,6 +2371,7 @@ namespace DW1000Ng {
 	}
 
 	void setWait4Response(uint32_t timeMicroSeconds) {
+		DW1000NG_PROFILE_API("setWait4Response");
 		_wait4resp = timeMicroSeconds == 0 ? false : true;
 
 		/* Check if it overflows 20 bits */
@@ -1939,11 +2452,49 @@ namespace DW1000Ng {
     }
 
 	void setDelayedTRX(byte futureTimeBytes[]) {
+		DW1000NG_PROFILE_API("setDelayedTRX");
 		/* the least significant 9-bits are ignored in DX_TIME in functional modes */
 		_writeBytesToRegister(DX_TIME, NO_SUB, futureTimeBytes, LEN_DX_TIME);
 	}
 
+	uint64_t scheduleReplyAfterRx(uint32_t replyDelayUs) {
+		return scheduleReplyAfterRx(getReceiveTimestamp(), replyDelayUs);
+	}
+
+	uint64_t scheduleReplyAfterRx(uint64_t rxTimestamp, uint32_t replyDelayUs) {
+		DW1000NG_PROFILE_API("scheduleReplyAfterRx");
+		if(replyDelayUs == REPLY_DELAY_AUTO)
+			replyDelayUs = _replyDelayUs;
+		/* the least significant 9-bits are ignored in DX_TIME, drop them here so the returned time is exact */
+		uint64_t txTime = (rxTimestamp + replyDelayUs * TICKS_PER_10US / 10) & TIME_MAX & ~0x1FFULL;
+		byte dx_time[LEN_DX_TIME];
+		DW1000NgUtils::writeValueToBytes(dx_time, txTime, LEN_DX_TIME);
+		_writeBytesToRegister(DX_TIME, NO_SUB, dx_time, LEN_DX_TIME);
+		_replyRxTimestamp = rxTimestamp;
+		_replyScheduled = true;
+		return (txTime + _antennaTxDelay) & TIME_MAX;
+	}
+
+	void startReplyDelayTuning() {
+		_replyTurnaroundMax = 0;
+		_replyTuningLeft = DW1000NG_REPLY_TUNING_SAMPLES;
+	}
+
+	boolean isReplyDelayTuning() {
+		return _replyTuningLeft > 0;
+	}
+
+	uint32_t getReplyDelay() {
+		return _replyDelayUs;
+	}
+
+	void setReplyDelay(uint32_t replyDelayUs) {
+		_replyTuningLeft = 0;
+		_replyDelayUs = replyDelayUs;
+	}
+
 	void setTransmitData(byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("setTransmitData");
 		if(_frameCheck) {
 			n += 2; // two bytes CRC-16
 		}
@@ -1957,12 +2508,41 @@ namespace DW1000Ng {
 		_writeBytesToRegister(TX_BUFFER, NO_SUB, data, n);
 		
 		/* Sets up transmit frame control length based on data length */
-		_txfctrl[0] = (byte)(n & 0xFF); // 1 byte (regular length + 1 bit)
-		_txfctrl[1] &= 0xE0;
-		_txfctrl[1] |= (byte)((n >> 8) & 0x03);  // 2 added bits if extended length
+		_setTransmitFrameLength(n);
+		_setTransmitBufferOffset(0);
 		_writeTransmitFrameControlRegister();
 	}
 
+	boolean writeTransmitTemplate(const tx_template_t& frame, byte data[]) {
+		DW1000NG_PROFILE_API("writeTransmitTemplate");
+		if(!_checkTransmitTemplate(frame)) {
+			return false;
+		}
+		_writeTransmitBuffer(frame.bufferOffset, data, frame.length);
+		return true;
+	}
+
+	boolean patchTransmitTemplate(const tx_template_t& frame, uint16_t fieldOffset, byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("patchTransmitTemplate");
+		if(!_checkTransmitTemplate(frame) || fieldOffset + n > frame.length) {
+			return false;
+		}
+		_writeTransmitBuffer(frame.bufferOffset + fieldOffset, data, n);
+		return true;
+	}
+
+	boolean selectTransmitTemplate(const tx_template_t& frame) {
+		DW1000NG_PROFILE_API("selectTransmitTemplate");
+		if(!_checkTransmitTemplate(frame)) {
+			return false;
+		}
+		_setTransmitFrameLength(_frameCheck ? frame.length + 2 : frame.length);
+		_setTransmitBufferOffset(frame.bufferOffset);
+		/* cached: no SPI traffic when the same template is sent again */
+		_writeTransmitFrameControlRegister();
+		return true;
+	}
+
 	void setTransmitData(const String& data) {
 		uint16_t n = data.length()+1;
 		byte* dataBytes = (byte*)malloc(n);
@@ -1973,6 +2553,7 @@ namespace DW1000Ng {
 
 	// TODO reorder
 	uint16_t getReceivedDataLength() {
+		DW1000NG_PROFILE_API("getReceivedDataLength");
 		uint16_t len = 0;
 
 		// 10 bits of RX frame control register
@@ -1987,12 +2568,51 @@ namespace DW1000Ng {
 	}
 
 	void getReceivedData(byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("getReceivedData");
 		if(n <= 0) {
 			return;
 		}
 		_readBytesFromRegister(RX_BUFFER, NO_SUB, data, n);
 	}
 
+	void getReceivedDataAsync(byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("getReceivedDataAsync");
+		if(n <= 0) {
+			return;
+		}
+		byte header[3];
+		uint8_t headerLen = _buildHeader(header, READ, READ_SUB, RX_BUFFER, NO_SUB);
+		SPIporting::readFromSPIAsync(_ss, headerLen, header, n, data, _handleReceivedData);
+	}
+
+	void getAccumulatorDataAsync(uint16_t offset, byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("getAccumulatorDataAsync");
+		byte header[3];
+		uint8_t headerLen;
+		byte pmscctrl0[2];
+
+		// user manual 7.2.36: FACE and AMCE on while reading, written one byte at a time
+		SPIporting::flushSPI();
+		_readBytesFromRegister(PMSC, PMSC_CTRL0_SUB, pmscctrl0, 2);
+		_accClockOn[0] = 0x48 | (pmscctrl0[0] & 0xB3);
+		_accClockOn[1] = 0x80 | pmscctrl0[1];
+		_accClockOff[0] = pmscctrl0[0] & 0xB3;
+		_accClockOff[1] = pmscctrl0[1] & 0x7F;
+
+		headerLen = _buildHeader(header, WRITE, WRITE_SUB, PMSC, PMSC_CTRL0_FACE_SUB);
+		SPIporting::writeToSPIAsync(_ss, headerLen, header, 1, &_accClockOn[0], nullptr);
+		headerLen = _buildHeader(header, WRITE, WRITE_SUB, PMSC, PMSC_CTRL0_AMCE_SUB);
+		SPIporting::writeToSPIAsync(_ss, headerLen, header, 1, &_accClockOn[1], nullptr);
+
+		headerLen = _buildHeader(header, READ, READ_SUB, ACC_MEM, offset == 0 ? NO_SUB : offset);
+		SPIporting::readFromSPIAsync(_ss, headerLen, header, n + 1, data, nullptr);
+
+		headerLen = _buildHeader(header, WRITE, WRITE_SUB, PMSC, PMSC_CTRL0_FACE_SUB);
+		SPIporting::writeToSPIAsync(_ss, headerLen, header, 1, &_accClockOff[0], nullptr);
+		headerLen = _buildHeader(header, WRITE, WRITE_SUB, PMSC, PMSC_CTRL0_AMCE_SUB);
+		SPIporting::writeToSPIAsync(_ss, headerLen, header, 1, &_accClockOff[1], _handleAccumulatorData);
+	}
+
 	void getReceivedData(String& data) {
 		uint16_t i;
 		uint16_t n = getReceivedDataLength(); // number of bytes w/o the two FCS ones
@@ -2012,6 +2632,7 @@ namespace DW1000Ng {
 	}
 
 	uint64_t getTransmitTimestamp() {
+		DW1000NG_PROFILE_API("getTransmitTimestamp");
 		byte data[LENGTH_TIMESTAMP];
 		memset(data, 0 , LENGTH_TIMESTAMP);
 		_readBytesFromRegister(TX_TIME, TX_STAMP_SUB, data, LEN_TX_STAMP);
@@ -2019,6 +2640,7 @@ namespace DW1000Ng {
 	}
 
 	uint64_t getReceiveTimestamp() {
+		DW1000NG_PROFILE_API("getReceiveTimestamp");
 		byte data[LEN_RX_STAMP];
 		memset(data, 0, LEN_RX_STAMP);
 		_readBytesFromRegister(RX_TIME, RX_STAMP_SUB, data, LEN_RX_STAMP);
@@ -2026,6 +2648,7 @@ namespace DW1000Ng {
 	}
 
 	uint64_t getSystemTimestamp() {
+		DW1000NG_PROFILE_API("getSystemTimestamp");
 		byte data[LEN_SYS_TIME];
 		memset(data, 0, LEN_SYS_TIME);
 		_readBytesFromRegister(SYS_TIME, NO_SUB, data, LEN_SYS_TIME);
@@ -2033,6 +2656,7 @@ namespace DW1000Ng {
 	}
 
 	float getReceiveQuality() {
+		DW1000NG_PROFILE_API("getReceiveQuality");
 		byte         noiseBytes[LEN_STD_NOISE];
 		byte         fpAmpl2Bytes[LEN_FP_AMPL2];
 		uint16_t     noise, f2;
@@ -2043,13 +2667,45 @@ namespace DW1000Ng {
 		return (float)f2/noise;
 	}
 
+	int32_t getClockOffsetPpb() {
+		DW1000NG_PROFILE_API("getClockOffsetPpb");
+		byte carInt[LEN_DRX_CAR_INT];
+		_readBytesFromRegister(DRX_TUNE, DRX_CAR_INT_SUB, carInt, LEN_DRX_CAR_INT);
+		/* 21 bit two's complement */
+		int32_t integrator = static_cast<int32_t>(DW1000NgUtils::bytesAsValue(carInt, LEN_DRX_CAR_INT) & 0x1FFFFF);
+		if(integrator & 0x100000)
+			integrator -= 0x200000;
+
+		/* Hz = integrator * 998.4 MHz / 2 / 2^17 / (1024, 8192 at 110 kb/s), over the carrier:
+		 * 998.4 MHz is 2/7, 1/4, 2/9 or 2/13 of channel 1, 2 and 4, 3, 5 and 7 */
+		int64_t numerator = 2000000000LL;
+		int64_t denominator;
+		if(_channel == Channel::CHANNEL_1) {
+			denominator = 7;
+		} else if(_channel == Channel::CHANNEL_2 || _channel == Channel::CHANNEL_4) {
+			numerator = 1000000000LL;
+			denominator = 4;
+		} else if(_channel == Channel::CHANNEL_3) {
+			denominator = 9;
+		} else {
+			denominator = 13;
+		}
+		denominator <<= (_dataRate == DataRate::RATE_110KBPS ? 31 : 28);
+		/* a positive integrator is a sender running slow */
+		return static_cast<int32_t>(-integrator * numerator / denominator);
+	}
+
 	float getFirstPathPower() {
+		return getFirstPathPowerQ8() / 256.0f;
+	}
+
+	int16_t getFirstPathPowerQ8() {
+		DW1000NG_PROFILE_API("getFirstPathPower");
 		byte         fpAmpl1Bytes[LEN_FP_AMPL1];
 		byte         fpAmpl2Bytes[LEN_FP_AMPL2];
 		byte         fpAmpl3Bytes[LEN_FP_AMPL3];
 		byte         rxFrameInfo[LEN_RX_FINFO];
-		uint16_t     f1, f2, f3, N;
-		float        A, corrFac;
+		uint16_t     f1, f2, f3;
 		_readBytesFromRegister(RX_TIME, FP_AMPL1_SUB, fpAmpl1Bytes, LEN_FP_AMPL1);
 		_readBytesFromRegister(RX_FQUAL, FP_AMPL2_SUB, fpAmpl2Bytes, LEN_FP_AMPL2);
 		_readBytesFromRegister(RX_FQUAL, FP_AMPL3_SUB, fpAmpl3Bytes, LEN_FP_AMPL3);
@@ -2057,52 +2713,99 @@ namespace DW1000Ng {
 		f1 = (uint16_t)fpAmpl1Bytes[0] | ((uint16_t)fpAmpl1Bytes[1] << 8);
 		f2 = (uint16_t)fpAmpl2Bytes[0] | ((uint16_t)fpAmpl2Bytes[1] << 8);
 		f3 = (uint16_t)fpAmpl3Bytes[0] | ((uint16_t)fpAmpl3Bytes[1] << 8);
-		N  = (((uint16_t)rxFrameInfo[2] >> 4) & 0xFF) | ((uint16_t)rxFrameInfo[3] << 4);
-
-		if(_pulseFrequency == PulseFrequency::FREQ_16MHZ) {
-			A       = 113.77;
-			corrFac = 2.3334;
-		} else {
-			A       = 121.74;
-			corrFac = 1.1667;
-		}
-		float estFpPwr = 10.0*log10(((float)f1*(float)f1+(float)f2*(float)f2+(float)f3*(float)f3)/((float)N*(float)N))-A;
-		if(estFpPwr <= -88) {
-			return estFpPwr;
-		} else {
-			// approximation of Fig. 22 in user manual for dbm correction
-			estFpPwr += (estFpPwr+88)*corrFac;
-		}
-		return estFpPwr;
+		return _firstPathPowerQ8(f1, f2, f3, _preambleAccumulation(rxFrameInfo));
 	}
 
 	float getReceivePower() {
+		return getReceivePowerQ8() / 256.0f;
+	}
+
+	int16_t getReceivePowerQ8() {
+		DW1000NG_PROFILE_API("getReceivePower");
 		byte     cirPwrBytes[LEN_CIR_PWR];
 		byte     rxFrameInfo[LEN_RX_FINFO];
-		uint32_t twoPower17 = 131072;
-		uint16_t C, N;
-		float    A, corrFac;
+		uint16_t C;
 		_readBytesFromRegister(RX_FQUAL, CIR_PWR_SUB, cirPwrBytes, LEN_CIR_PWR);
 		_readBytesFromRegister(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
 		C = (uint16_t)cirPwrBytes[0] | ((uint16_t)cirPwrBytes[1] << 8);
-		N = (((uint16_t)rxFrameInfo[2] >> 4) & 0xFF) | ((uint16_t)rxFrameInfo[3] << 4);
+		return _receivePowerQ8(C, _preambleAccumulation(rxFrameInfo));
+	}
 
-		if(_pulseFrequency == PulseFrequency::FREQ_16MHZ) {
-			A       = 113.77;
-			corrFac = 2.3334;
-		} else {
-			A       = 121.74;
-			corrFac = 1.1667;
+	frame_snapshot_t readFrameSnapshot(byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("readFrameSnapshot");
+		frame_snapshot_t snapshot;
+		byte rxFrameInfo[LEN_RX_FINFO];
+		byte rxFrameQuality[LEN_RX_FQUAL];
+		byte rxTime[LEN_RX_STAMP + LEN_FP_INDEX + LEN_FP_AMPL1];
+
+		_readBytesFromRegister(RX_FINFO, NO_SUB, rxFrameInfo, LEN_RX_FINFO);
+		snapshot.length = (((uint16_t)rxFrameInfo[1] << 8) | (uint16_t)rxFrameInfo[0]) & 0x03FF;
+		if(_frameCheck && snapshot.length > 2) {
+			snapshot.length -= 2;
 		}
-		
-		float estRxPwr = 10.0*log10(((float)C*(float)twoPower17)/((float)N*(float)N))-A;
-		if(estRxPwr <= -88) {
-			return estRxPwr;
-		} else {
-			// approximation of Fig. 22 in user manual for dbm correction
-			estRxPwr += (estRxPwr+88)*corrFac;
+		snapshot.preambleAccumulation = _preambleAccumulation(rxFrameInfo);
+
+		if(n > snapshot.length) {
+			n = snapshot.length;
+		}
+		if(n > 0) {
+			_readBytesFromRegister(RX_BUFFER, NO_SUB, data, n);
+		}
+
+		// RX_FQUAL is read whole: STD_NOISE, FP_AMPL2, FP_AMPL3 and CIR_PWR are contiguous
+		_readBytesFromRegister(RX_FQUAL, NO_SUB, rxFrameQuality, LEN_RX_FQUAL);
+		snapshot.noise = (uint16_t)DW1000NgUtils::bytesAsValue(rxFrameQuality + STD_NOISE_SUB, LEN_STD_NOISE);
+		snapshot.firstPathAmplitude2 = (uint16_t)DW1000NgUtils::bytesAsValue(rxFrameQuality + FP_AMPL2_SUB, LEN_FP_AMPL2);
+		snapshot.firstPathAmplitude3 = (uint16_t)DW1000NgUtils::bytesAsValue(rxFrameQuality + FP_AMPL3_SUB, LEN_FP_AMPL3);
+		snapshot.cirPower = (uint16_t)DW1000NgUtils::bytesAsValue(rxFrameQuality + CIR_PWR_SUB, LEN_CIR_PWR);
+
+		// RX_TIME up to FP_AMPL1, RX_RAWST is not needed
+		_readBytesFromRegister(RX_TIME, RX_STAMP_SUB, rxTime, sizeof(rxTime));
+		snapshot.timestamp = DW1000NgUtils::bytesAsValue(rxTime + RX_STAMP_SUB, LEN_RX_STAMP);
+		snapshot.firstPathIndex = (uint16_t)DW1000NgUtils::bytesAsValue(rxTime + FP_INDEX_SUB, LEN_FP_INDEX);
+		snapshot.firstPathAmplitude1 = (uint16_t)DW1000NgUtils::bytesAsValue(rxTime + FP_AMPL1_SUB, LEN_FP_AMPL1);
+
+		return snapshot;
+	}
+
+#if DW1000NG_RX_QUEUE
+	boolean popFrame(rx_frame_t& frame) {
+		uint8_t tail = _rxQueueTail;
+		if(tail == _rxQueueHead) {
+			return false;
 		}
-		return estRxPwr;
+		memcpy(&frame, &_rxQueue[tail & (DW1000NG_RX_QUEUE_SLOTS - 1)], sizeof(rx_frame_t));
+		_rxQueueTail = tail + 1;
+		return true;
+	}
+
+	uint8_t getQueuedFrameCount() {
+		return _rxQueueHead - _rxQueueTail;
+	}
+
+	uint16_t getDroppedFrameCount() {
+		return _rxQueueDropped;
+	}
+#endif
+
+	float getReceivePower(const frame_snapshot_t& snapshot) {
+		return getReceivePowerQ8(snapshot) / 256.0f;
+	}
+
+	int16_t getReceivePowerQ8(const frame_snapshot_t& snapshot) {
+		return _receivePowerQ8(snapshot.cirPower, snapshot.preambleAccumulation);
+	}
+
+	float getFirstPathPower(const frame_snapshot_t& snapshot) {
+		return getFirstPathPowerQ8(snapshot) / 256.0f;
+	}
+
+	int16_t getFirstPathPowerQ8(const frame_snapshot_t& snapshot) {
+		return _firstPathPowerQ8(snapshot.firstPathAmplitude1, snapshot.firstPathAmplitude2, snapshot.firstPathAmplitude3, snapshot.preambleAccumulation);
+	}
+
+	float getReceiveQuality(const frame_snapshot_t& snapshot) {
+		return (float)snapshot.firstPathAmplitude2/snapshot.noise;
 	}
 
 	#if DW1000NG_DEBUG
@@ -2157,10 +2860,14 @@ namespace DW1000Ng {
 	#endif
 
 	void readBytes(byte cmd, uint16_t offset, byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("readBytes");
 		_readBytesFromRegister(cmd, offset, data, n);
 	}
 
 	void writeBytes(byte cmd, uint16_t offset, byte data[], uint16_t n) {
+		DW1000NG_PROFILE_API("writeBytes");
 		_writeBytesToRegister(cmd, offset, data, n);
+		if(cmd == SYS_CFG || cmd == TX_FCTRL || cmd == SYS_MASK || cmd == CHAN_CTRL)
+			_invalidateRegisterCache();
 	}
 }
@@ -172,6 +172,15 @@ namespace DW1000Ng {
 	*/
 	void getEUI(byte eui[]);
 
+	/**
+	Gets the part and lot ID written to OTP at production test, which
+	together tell one chip from every other.
+
+	@param[out] partId The part ID, 0 if the OTP was never programmed.
+	@param[out] lotId The lot ID, 0 if the OTP was never programmed.
+	*/
+	void getPartAndLotId(uint32_t& partId, uint32_t& lotId);
+
 	/**
 	Sets the transmission power of the device.
 	Be careful to respect your current country limitations.
@@ -228,6 +237,59 @@ namespace DW1000Ng {
 	*/
 	void setDelayedTRX(byte futureTimeBytes[]);
 
+	/* use the tuned reply delay, see scheduleReplyAfterRx() */
+	constexpr uint32_t REPLY_DELAY_AUTO = 0;
+
+	/**
+	Schedules the next delayed transmission a fixed time after the RX timestamp
+	of the last received frame, read from the chip. Call startTransmit(TransmitMode::DELAYED)
+	to send it.
+
+	@param [in] replyDelayUs delay from the RX timestamp in microseconds, REPLY_DELAY_AUTO for the tuned one
+
+	returns the transmit timestamp (antenna delay included), to embed in the reply
+	*/
+	uint64_t scheduleReplyAfterRx(uint32_t replyDelayUs);
+
+	/**
+	Schedules the next delayed transmission a fixed time after an RX timestamp
+	the caller already holds, with no SPI read. Unlike a reply timed from
+	getSystemTimestamp(), the exchange does not depend on how long the MCU took
+	to get here, as long as it starts the transmission before the slot.
+
+	@param [in] rxTimestamp RX timestamp of the frame to reply to
+	@param [in] replyDelayUs delay from rxTimestamp in microseconds, REPLY_DELAY_AUTO for the tuned one
+
+	returns the transmit timestamp (antenna delay included), to embed in the reply
+	*/
+	uint64_t scheduleReplyAfterRx(uint64_t rxTimestamp, uint32_t replyDelayUs);
+
+	/**
+	Self-tunes the REPLY_DELAY_AUTO delay. Each of the next DW1000NG_REPLY_TUNING_SAMPLES
+	scheduled replies reads SYS_TIME once the delayed transmission is started.
+	The tuned delay is then the slowest RX to start time measured, plus the preamble
+	airtime and DW1000NG_REPLY_MARGIN_US. Until then the previous delay stays in use.
+	Tune again when the work done between receiving and replying changes.
+	*/
+	void startReplyDelayTuning();
+
+	/**
+	returns true while startReplyDelayTuning() is still measuring
+	*/
+	boolean isReplyDelayTuning();
+
+	/**
+	returns the reply delay REPLY_DELAY_AUTO stands for, in microseconds
+	*/
+	uint32_t getReplyDelay();
+
+	/**
+	Sets the reply delay REPLY_DELAY_AUTO stands for, stopping any tuning
+
+	@param [in] replyDelayUs the delay in microseconds
+	*/
+	void setReplyDelay(uint32_t replyDelayUs);
+
 	/**
 	Sets the transmission bytes inside the tx buffer of the DW1000
 
@@ -243,6 +305,44 @@ namespace DW1000Ng {
 	*/
 	void setTransmitData(const String& data);
 
+	/**
+	Stages a frame template in the tx buffer. Templates at different buffer
+	offsets stay there side by side until reset or sleep, so a frame whose
+	bytes barely change is written once, patched with patchTransmitTemplate()
+	and sent with selectTransmitTemplate() and startTransmit().
+	setTransmitData() overwrites the start of the buffer.
+
+	@param [in] frame where the template goes in the tx buffer and its length
+	@param [in] data the frame.length bytes of the frame
+
+	returns false if the frame does not fit the buffer or the frame length
+	*/
+	boolean writeTransmitTemplate(const tx_template_t& frame, byte data[]);
+
+	/**
+	Overwrites a field of a staged template, e.g. a sequence number or a
+	timestamp, in one SPI write of just those bytes
+
+	@param [in] frame the template
+	@param [in] fieldOffset offset of the field in the frame
+	@param [in] data the new bytes of the field
+	@param [in] n the length of the field
+
+	returns false if the field is not inside the frame
+	*/
+	boolean patchTransmitTemplate(const tx_template_t& frame, uint16_t fieldOffset, byte data[], uint16_t n);
+
+	/**
+	Makes the next transmission send a staged template: sets the frame length
+	and the tx buffer offset in TX_FCTRL. Nothing is written when the same
+	template was selected last.
+
+	@param [in] frame the template
+
+	returns false if the frame does not fit the buffer or the frame length
+	*/
+	boolean selectTransmitTemplate(const tx_template_t& frame);
+
 	/**
 	Gets the received bytes and stores them in a byte array
 
@@ -251,6 +351,31 @@ namespace DW1000Ng {
 	*/
 	void getReceivedData(byte data[], uint16_t n);
 
+	/**
+	Starts reading the received bytes into a byte array and returns. With the
+	ESP32 DMA backend (DW1000NG_ESP32_SPI_DMA) the RX buffer is copied by DMA
+	while the caller prepares the next frame; elsewhere the read completes
+	before returning. The handler set with attachReceivedDataHandler() runs once
+	data[] is filled, with the DMA backend from the SPI interrupt.
+
+	@param [out] data The array of byte to store the data, must stay valid until the handler runs
+	@param [in] n The length of the byte array
+	*/
+	void getReceivedDataAsync(byte data[], uint16_t n);
+
+	/**
+	Starts reading the channel impulse response from the accumulator memory,
+	like getReceivedDataAsync(). The accumulator clocks are switched on and back
+	off around the read; the handler set with attachAccumulatorDataHandler()
+	runs once all of it is done.
+
+	@param [in] offset byte offset inside ACC_MEM, 4 bytes per complex sample
+	@param [out] data n + 1 bytes: data[0] is the dummy byte the DW1000 sends first,
+	the samples (int16 real, int16 imaginary) start at data[1]
+	@param [in] n The number of accumulator bytes to read
+	*/
+	void getAccumulatorDataAsync(uint16_t offset, byte data[], uint16_t n);
+
 	/**
 	Stores the received data inside a string
 
@@ -295,6 +420,13 @@ namespace DW1000Ng {
 	*/
 	float getReceivePower();
 
+	/**
+	Gets the receive power of the device (last receive) with integer math only
+
+	returns the last receive power in dBm, Q8.8 fixed point (divide by 256)
+	*/
+	int16_t getReceivePowerQ8();
+
 	/**
 	Gets the power of the first path
 
@@ -302,6 +434,13 @@ namespace DW1000Ng {
 	*/ 
 	float getFirstPathPower();
 
+	/**
+	Gets the power of the first path with integer math only
+
+	returns the first path power in dBm, Q8.8 fixed point (divide by 256)
+	*/
+	int16_t getFirstPathPowerQ8();
+
 	/**
 	Gets the last receive quality
 
@@ -309,6 +448,95 @@ namespace DW1000Ng {
 	*/
 	float getReceiveQuality();
 
+	/**
+	Clock offset of the sender of the last received frame against this chip,
+	from the receiver carrier integrator (DRX_CAR_INT). Scales a duration the
+	sender measured to this clock, see DW1000NgRanging::computeTofSingleSided().
+
+	returns the offset in parts per billion, positive when the sender's clock
+	runs fast (0.57 ppb resolution, 0.07 ppb at 110 kb/s)
+	*/
+	int32_t getClockOffsetPpb();
+
+	/**
+	Reads everything about the last received frame in four SPI transactions
+	(RX_FINFO, RX_BUFFER, RX_FQUAL and RX_TIME), instead of one or more per field
+	with getReceivedData(), getReceiveTimestamp(), getReceivePower() & co.
+
+	@param [out] data The array of byte to store the payload
+	@param [in] n The length of the byte array, longer frames are truncated
+
+	returns the frame snapshot
+	*/
+	frame_snapshot_t readFrameSnapshot(byte data[], uint16_t n);
+
+	/**
+	Receive power of a frame snapshot, no SPI access
+
+	@param [in] snapshot taken by readFrameSnapshot()
+
+	returns the receive power in dBm
+	*/
+	float getReceivePower(const frame_snapshot_t& snapshot);
+
+	/**
+	Receive power of a frame snapshot, no SPI access, integer math only
+
+	@param [in] snapshot taken by readFrameSnapshot()
+
+	returns the receive power in dBm, Q8.8 fixed point (divide by 256)
+	*/
+	int16_t getReceivePowerQ8(const frame_snapshot_t& snapshot);
+
+	/**
+	First path power of a frame snapshot, no SPI access
+
+	@param [in] snapshot taken by readFrameSnapshot()
+
+	returns the first path power in dBm
+	*/
+	float getFirstPathPower(const frame_snapshot_t& snapshot);
+
+	/**
+	First path power of a frame snapshot, no SPI access, integer math only
+
+	@param [in] snapshot taken by readFrameSnapshot()
+
+	returns the first path power in dBm, Q8.8 fixed point (divide by 256)
+	*/
+	int16_t getFirstPathPowerQ8(const frame_snapshot_t& snapshot);
+
+	/**
+	Receive quality of a frame snapshot, no SPI access
+
+	@param [in] snapshot taken by readFrameSnapshot()
+
+	returns the receive quality
+	*/
+	float getReceiveQuality(const frame_snapshot_t& snapshot);
+
+#if DW1000NG_RX_QUEUE
+	/**
+	Takes the oldest frame from the receive queue. The ISR fills the queue
+	with every good frame before calling the received handler.
+
+	@param [out] frame payload, kept length and snapshot of the frame
+
+	returns true if a frame was taken, false if the queue is empty
+	*/
+	boolean popFrame(rx_frame_t& frame);
+
+	/**
+	returns the number of frames waiting in the receive queue
+	*/
+	uint8_t getQueuedFrameCount();
+
+	/**
+	returns the number of frames dropped because the receive queue was full
+	*/
+	uint16_t getDroppedFrameCount();
+#endif
+
 	/**
 	Sets both tx and rx antenna delay value
 
@@ -411,10 +639,30 @@ namespace DW1000Ng {
 	@param [in] handleReceiveTimestampAvailable the target function
 	*/
 	void attachReceiveTimestampAvailableHandler(void (* handleReceiveTimestampAvailable)(void));
+
+	/**
+	Sets the function for getReceivedDataAsync() completion handling.
+	With the ESP32 DMA backend it runs in the SPI driver's interrupt: keep it
+	short, in IRAM_ATTR, and make no DW1000Ng calls or other blocking calls from it.
+
+	@param [in] handleReceivedData the target function
+	*/
+	void attachReceivedDataHandler(void (* handleReceivedData)(void));
+
+	/**
+	Sets the function for getAccumulatorDataAsync() completion handling.
+	With the ESP32 DMA backend it runs in the SPI driver's interrupt: keep it
+	short, in IRAM_ATTR, and make no DW1000Ng calls or other blocking calls from it.
+
+	@param [in] handleAccumulatorData the target function
+	*/
+	void attachAccumulatorDataHandler(void (* handleAccumulatorData)(void));
 	
 	/**
 	Handles dw1000 events triggered by interrupt
-	By default this is attached to the interrupt pin callback
+	By default this is attached to the interrupt pin callback. With the ESP32
+	DMA backend the pin only notifies a FreeRTOS task that calls this, so the
+	event handlers run in that task rather than in interrupt context.
 	*/
 	void interruptServiceRoutine();
 	
@@ -508,11 +756,32 @@ namespace DW1000Ng {
 	void startReceive(ReceiveMode mode = ReceiveMode::IMMEDIATE);
 	
 	/**
-	Sets the device in transmission mode
+	Sets the device in transmission mode. A DELAYED transmission is checked
+	right after the start and cancelled if late, see isTransmitLate()
 
 	@param [in] mode IMMEDIATE or DELAYED transmission
 	*/
 	void startTransmit(TransmitMode mode = TransmitMode::IMMEDIATE);
+
+	/**
+	Tells if the last startTransmit(TransmitMode::DELAYED) came after its DX_TIME
+	slot. The chip flags this with HPDWARN and would send one counter period
+	(17 s) later, so the transmission has been cancelled.
+
+	returns true if the last delayed transmission was late and cancelled
+	*/
+	boolean isTransmitLate();
+
+	/**
+	Gets the air time of a frame with the current configuration: preamble, SFD,
+	PHR and the payload with its Reed-Solomon parity, from the start of the
+	preamble to the last bit. Use it to size reply slots.
+
+	@param [in] frameLength payload bytes as given to setTransmitData(), the FCS is added when frame check is on
+
+	returns the frame duration in microseconds, rounded up
+	*/
+	uint32_t getFrameDuration(uint16_t frameLength);
 		
 	/**
 	Gets the temperature inside the DW1000 Device
@@ -550,8 +819,15 @@ namespace DW1000Ng {
 	void disableFrameFiltering();
 	
 	/**
-	WARNING: this just sets the relative bits inside the register.
-	You must refer to the DW1000 User manual to activate it properly.
+	Enables or disables double-buffered receive. The chip keeps receiving into
+	the second buffer while the previous frame is read out of the first one.
+	interruptServiceRoutine() hands each buffer back to the receiver after the
+	received handler returns, so the frame must be read inside the handler or
+	taken by the receive queue (DW1000NG_RX_QUEUE). An overrun (both buffers
+	full) is reported through the receive failed handler. Stops the radio;
+	call startReceive() afterwards.
+
+	@param [in] val true to enable, false to disable
 	*/
 	void setDoubleBuffering(boolean val);
 
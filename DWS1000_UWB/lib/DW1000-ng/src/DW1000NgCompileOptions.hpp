@@ -67,4 +67,124 @@
  * Some examples or debug code use this
  * Set false if you do not need it and have to save some space
  */
-#define DW1000NGCONFIGURATION_H_PRINTABLE false
\ No newline at end of file
+#define DW1000NGCONFIGURATION_H_PRINTABLE false
+/**
+ * Default chip select setup/hold times in microseconds around every SPI
+ * transaction, see SPIporting::setChipSelectTiming(). The DW1000 needs far
+ * less than the digitalWrite() calls already take, so 0 is the default;
+ * the original driver always waited 5 us before releasing CS.
+ */
+#ifndef DW1000NG_SPI_CS_SETUP_US
+#define DW1000NG_SPI_CS_SETUP_US 0
+#endif
+#ifndef DW1000NG_SPI_CS_HOLD_US
+#define DW1000NG_SPI_CS_HOLD_US 0
+#endif
+
+/**
+ * ESP32 only: SPIporting drives the bus through the ESP-IDF spi_master driver
+ * with DMA instead of SPIClass, so writeToSPIAsync()/readFromSPIAsync() are
+ * queued and return immediately. Chip select becomes a hardware signal.
+ * Elsewhere the async calls complete before returning.
+ * Pins default to VSPI as in docs/findings/ESP32_Migration_Guide.md
+ */
+#ifndef DW1000NG_ESP32_SPI_DMA
+#define DW1000NG_ESP32_SPI_DMA false
+#endif
+#ifndef DW1000NG_ESP32_SPI_HOST
+#define DW1000NG_ESP32_SPI_HOST VSPI_HOST
+#endif
+#ifndef DW1000NG_ESP32_PIN_SCK
+#define DW1000NG_ESP32_PIN_SCK 18
+#endif
+#ifndef DW1000NG_ESP32_PIN_MISO
+#define DW1000NG_ESP32_PIN_MISO 19
+#endif
+#ifndef DW1000NG_ESP32_PIN_MOSI
+#define DW1000NG_ESP32_PIN_MOSI 23
+#endif
+/**
+ * Stack (bytes) and priority of the FreeRTOS task that runs
+ * DW1000Ng::interruptServiceRoutine() for the DMA backend; the IRQ pin only
+ * notifies it. The DW1000Ng handlers run on this stack.
+ */
+#ifndef DW1000NG_ESP32_IRQ_TASK_STACK
+#define DW1000NG_ESP32_IRQ_TASK_STACK 4096
+#endif
+#ifndef DW1000NG_ESP32_IRQ_TASK_PRIORITY
+#define DW1000NG_ESP32_IRQ_TASK_PRIORITY (configMAX_PRIORITIES - 1)
+#endif
+/**
+ * Number of SPI transactions that can be queued at once by the DMA backend
+ */
+#ifndef DW1000NG_SPI_QUEUE_DEPTH
+#define DW1000NG_SPI_QUEUE_DEPTH 8
+#endif
+
+/**
+ * SPI transaction profiler in SPIporting: counts transactions, bytes and time
+ * per register and per calling DW1000Ng function, see SPIporting::dumpProfile().
+ * ram: 768 byte (registers) + 14 byte per DW1000NG_SPI_PROFILER_APIS entry
+ * Off by default; enable with -D DW1000NG_SPI_PROFILER=true in build_flags
+ */
+#ifndef DW1000NG_SPI_PROFILER
+#define DW1000NG_SPI_PROFILER false
+#endif
+
+/**
+ * Number of distinct calling functions the SPI profiler keeps apart,
+ * traffic from further ones is reported as (other)
+ */
+#ifndef DW1000NG_SPI_PROFILER_APIS
+	#if defined(__AVR__)
+		#define DW1000NG_SPI_PROFILER_APIS 16
+	#else
+		#define DW1000NG_SPI_PROFILER_APIS 40
+	#endif
+#endif
+
+/**
+ * Receive queue: the ISR copies every good frame (payload, length, timestamp
+ * and signal quality, see readFrameSnapshot()) into a ring of slots that the
+ * application drains with DW1000Ng::popFrame(). Frames that land before
+ * loop() gets to the previous one are no longer lost.
+ * ram: DW1000NG_RX_QUEUE_SLOTS * (DW1000NG_RX_QUEUE_FRAME_LEN + 26) byte
+ * Off by default; enable with -D DW1000NG_RX_QUEUE=true in build_flags
+ */
+#ifndef DW1000NG_RX_QUEUE
+#define DW1000NG_RX_QUEUE false
+#endif
+/**
+ * Number of queued frames, a power of two up to 128
+ */
+#ifndef DW1000NG_RX_QUEUE_SLOTS
+#define DW1000NG_RX_QUEUE_SLOTS 4
+#endif
+/**
+ * Payload bytes kept per queued frame, longer frames are cut
+ */
+#ifndef DW1000NG_RX_QUEUE_FRAME_LEN
+	#if defined(__AVR__)
+		#define DW1000NG_RX_QUEUE_FRAME_LEN 32
+	#else
+		#define DW1000NG_RX_QUEUE_FRAME_LEN 127
+	#endif
+#endif
+
+/**
+ * Reply delay in microseconds used by DW1000Ng::scheduleReplyAfterRx() with
+ * REPLY_DELAY_AUTO until DW1000Ng::startReplyDelayTuning() has measured one
+ */
+#ifndef DW1000NG_REPLY_DELAY_US
+#define DW1000NG_REPLY_DELAY_US 3000
+#endif
+/**
+ * Delayed replies measured by one reply delay tuning run, and the margin in
+ * microseconds added to the slowest of them
+ */
+#ifndef DW1000NG_REPLY_TUNING_SAMPLES
+#define DW1000NG_REPLY_TUNING_SAMPLES 32
+#endif
+#ifndef DW1000NG_REPLY_MARGIN_US
+#define DW1000NG_REPLY_MARGIN_US 150
+#endif
@@ -26,6 +26,7 @@
 
 #include <Arduino.h>
 #include "DW1000NgConstants.hpp"
+#include "DW1000NgCompileOptions.hpp"
 
 typedef struct device_configuration_t {
     boolean extendedFrameLength;
@@ -70,4 +71,31 @@ typedef struct sleep_configuration_t {
     boolean enableSLP;
     boolean enableWakePIN;
     boolean enableWakeSPI;
-} sleep_configuration_t;
\ No newline at end of file
+} sleep_configuration_t;
+
+/* Everything the driver knows about the last received frame, see DW1000Ng::readFrameSnapshot() */
+typedef struct frame_snapshot_t {
+    uint16_t length;               // RX_FINFO: frame length without FCS
+    uint16_t preambleAccumulation; // RX_FINFO: RXPACC
+    uint64_t timestamp;            // RX_TIME: RX_STAMP
+    uint16_t firstPathIndex;       // RX_TIME: FP_INDEX
+    uint16_t firstPathAmplitude1;  // RX_TIME: FP_AMPL1
+    uint16_t firstPathAmplitude2;  // RX_FQUAL: FP_AMPL2
+    uint16_t firstPathAmplitude3;  // RX_FQUAL: FP_AMPL3
+    uint16_t cirPower;             // RX_FQUAL: CIR_PWR
+    uint16_t noise;                // RX_FQUAL: STD_NOISE
+} frame_snapshot_t;
+
+
+/* Frame taken from the receive queue by DW1000Ng::popFrame() */
+typedef struct rx_frame_t {
+    frame_snapshot_t snapshot;     // snapshot.length is the full frame length
+    uint16_t length;               // payload bytes kept in data
+    byte data[DW1000NG_RX_QUEUE_FRAME_LEN];
+} rx_frame_t;
+
+/* Frame staged in TX_BUFFER once and patched in place, see DW1000Ng::writeTransmitTemplate() */
+typedef struct tx_template_t {
+    uint16_t bufferOffset;         // TX_BUFFER index of the first byte, TX_FCTRL: TXBOFFS
+    uint16_t length;               // frame length without FCS
+} tx_template_t;
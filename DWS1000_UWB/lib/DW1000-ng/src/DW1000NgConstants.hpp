@@ -157,29 +157,6 @@ constexpr byte SYS_PLL_CLOCK  = 0x02;
 constexpr byte TX_PLL_CLOCK = 0x20;
 constexpr byte LDE_CLOCK = 0x03;
 
-/* range bias tables - APS011*/
-
-constexpr double BIAS_TABLE[18][5] = {
-    {61, -198, -110, -275, -295},
-    {63, -187, -105, -244, -266},
-    {65, -179, -100, -210, -235},
-    {67, -163, -93, -176, -199},
-    {69, -143, -82, -138, -150},
-    {71, -127, -69, -95, -100},
-    {73, -109, -51, -51, -58},
-    {75, -84, -27, 0, 0},
-    {77, -59, 0, 42, 49},
-    {79, -31, 21, 97, 91},
-    {81, 0, 35, 158, 127},
-    {83, 36, 42, 210, 153},
-    {85, 65, 49, 254, 175},
-    {87, 84, 62, 294, 197},
-    {89, 97, 71, 321, 233},
-    {91, 106, 76, 339, 245},
-    {93, 110, 81, 356, 264},
-    {95, 112, 86, 394, 284}
-};
-
 enum class DriverAmplifierValue : byte {
     dB_18,
     dB_15,
@@ -26,7 +26,6 @@
 #include "DW1000NgRTLS.hpp"
 #include "DW1000Ng.hpp"
 #include "DW1000NgUtils.hpp"
-#include "DW1000NgTime.hpp"
 #include "DW1000NgRanging.hpp"
 
 static byte SEQ_NUMBER = 0;
@@ -73,14 +72,7 @@ namespace DW1000NgRTLS {
     }
 
     void transmitFinalMessage(byte anchor_address[], uint16_t reply_delay, uint64_t timePollSent, uint64_t timeResponseToPollReceived) {
-        /* Calculation of future time */
-        byte futureTimeBytes[LENGTH_TIMESTAMP];
-
-	    uint64_t timeFinalMessageSent = DW1000Ng::getSystemTimestamp();
-	    timeFinalMessageSent += DW1000NgTime::microsecondsToUWBTime(reply_delay);
-        DW1000NgUtils::writeValueToBytes(futureTimeBytes, timeFinalMessageSent, LENGTH_TIMESTAMP);
-        DW1000Ng::setDelayedTRX(futureTimeBytes);
-        timeFinalMessageSent += DW1000Ng::getTxAntennaDelay();
+        uint64_t timeFinalMessageSent = DW1000Ng::scheduleReplyAfterRx(timeResponseToPollReceived, reply_delay);
 
         byte finalMessage[] = {DATA, SHORT_SRC_AND_DEST, SEQ_NUMBER++, 0,0, 0,0, 0,0, RANGING_TAG_FINAL_RESPONSE_EMBEDDED, 
             0,0,0,0,0,0,0,0,0,0,0,0
@@ -346,4 +338,63 @@ namespace DW1000NgRTLS {
         return returnValue;
     }
 
+    void updateClockModel(ClockModel& model, uint64_t localTimestamp, uint64_t referenceTimestamp) {
+        if(model.synced) {
+            uint64_t localSpan = (localTimestamp - model.localSync) & TIME_MAX;
+            uint64_t referenceSpan = (referenceTimestamp - model.referenceSync) & TIME_MAX;
+            /* the spans differ by the skew only: beyond 1/8192 (122 ppm) it is no pair,
+             * below, the difference fits 27 bits and the product 57 */
+            int64_t difference = static_cast<int64_t>(referenceSpan) - static_cast<int64_t>(localSpan);
+            int64_t bound = static_cast<int64_t>(localSpan >> 13);
+            model.valid = localSpan != 0 && difference <= bound && difference >= -bound;
+            if(model.valid) {
+                int64_t skew = difference * 1000000000LL / static_cast<int64_t>(localSpan);
+                model.valid = skew <= CLOCK_MODEL_MAX_SKEW_PPB && skew >= -CLOCK_MODEL_MAX_SKEW_PPB;
+                model.skewPpb = static_cast<int32_t>(skew);
+            }
+        }
+        model.localSync = localTimestamp;
+        model.referenceSync = referenceTimestamp;
+        model.synced = true;
+    }
+
+    uint64_t toReferenceTime(const ClockModel& model, uint64_t localTimestamp) {
+        /* signed, the blink may have come in just before the beacon */
+        int64_t elapsed = static_cast<int64_t>((localTimestamp - model.localSync) & TIME_MAX);
+        if(elapsed > TIME_MAX / 2)
+            elapsed -= TIME_OVERFLOW;
+        int64_t correction = elapsed * model.skewPpb / 1000000000LL;
+        return static_cast<uint64_t>(model.referenceSync + elapsed + correction) & TIME_MAX;
+    }
+
+    uint16_t getSlotWidth(uint16_t replyLength, uint32_t replyDelayUs, uint16_t guardUs) {
+        /* the reply preamble starts before its RX timestamp, the request's
+         * before the slot start: what separates two slots is the reply air time */
+        return static_cast<uint16_t>(replyDelayUs + DW1000Ng::getFrameDuration(replyLength) + guardUs);
+    }
+
+    uint32_t getSuperframeDuration(const Superframe& superframe) {
+        return superframe.firstSlotUs + static_cast<uint32_t>(superframe.slotCount) * superframe.slotUs;
+    }
+
+    void writeSuperframe(const Superframe& superframe, byte data[]) {
+        data[0] = superframe.sequence;
+        data[1] = superframe.slotCount;
+        DW1000NgUtils::writeValueToBytes(data + 2, superframe.firstSlotUs, 2);
+        DW1000NgUtils::writeValueToBytes(data + 4, superframe.slotUs, 2);
+    }
+
+    void readSuperframe(Superframe& superframe, byte data[], uint64_t beaconTimestamp) {
+        superframe.beaconTime = beaconTimestamp;
+        superframe.sequence = data[0];
+        superframe.slotCount = data[1];
+        superframe.firstSlotUs = static_cast<uint16_t>(DW1000NgUtils::bytesAsValue(data + 2, 2));
+        superframe.slotUs = static_cast<uint16_t>(DW1000NgUtils::bytesAsValue(data + 4, 2));
+    }
+
+    uint64_t scheduleSlot(const Superframe& superframe, uint8_t slot) {
+        return DW1000Ng::scheduleReplyAfterRx(superframe.beaconTime,
+            superframe.firstSlotUs + static_cast<uint32_t>(slot) * superframe.slotUs);
+    }
+
 }
\ No newline at end of file
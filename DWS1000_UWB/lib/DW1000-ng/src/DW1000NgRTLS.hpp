@@ -94,6 +94,33 @@ typedef struct RangeAcceptResult {
     double range;
 } RangeAcceptResult;
 
+/* Linear model of the reference clock (offset and skew) seen from this one,
+   fed with sync beacons, see DW1000NgRTLS::updateClockModel() */
+typedef struct ClockModel {
+    uint64_t localSync;         // RX timestamp of the last sync beacon
+    uint64_t referenceSync;     // its TX timestamp, reference clock
+    int32_t skewPpb;            // reference rate against ours, minus 1
+    boolean synced;             // one beacon seen
+    boolean valid;              // two in a row, the skew is known
+} ClockModel;
+
+/* largest skew taken from a beacon pair, two crystals at +-20 ppm with margin */
+constexpr int32_t CLOCK_MODEL_MAX_SKEW_PPB = 100000;
+
+/* TDMA superframe: a coordinator beacon, then slotCount slots of slotUs, all
+   timed from the beacon timestamp on the clock of the node holding it, see
+   DW1000NgRTLS::scheduleSlot() */
+typedef struct Superframe {
+    uint64_t beaconTime;        // beacon TX (coordinator) or RX (node) timestamp
+    uint16_t firstSlotUs;       // beacon -> slot 0
+    uint16_t slotUs;            // slot width
+    uint8_t slotCount;
+    byte sequence;
+} Superframe;
+
+/* superframe fields of a beacon: sequence, slot count, first slot (us), slot width (us) */
+constexpr uint8_t LEN_SUPERFRAME = 6;
+
 namespace DW1000NgRTLS {
     /*** TWR functions used in ISO/IEC 24730-62:2013, refer to the standard or the decawave manual for details about TWR ***/
     byte increaseSequenceNumber();
@@ -130,4 +157,83 @@ namespace DW1000NgRTLS {
         Finalmessagedelay is the same as in function tagRangeInfrastructure
     */
     RangeInfrastructureResult tagTwrLocalize(uint16_t finalMessageDelay);
+
+    /*** TDOA ***/
+
+    /**
+    Feeds a sync beacon of the reference anchor to a clock model. Two in a row
+    give the skew; a pair implying more than CLOCK_MODEL_MAX_SKEW_PPB (lost
+    beacons across a counter period) invalidates the model until the next.
+    The propagation time from the reference is not removed: it is the same
+    for every blink, the TDOA solver knows the anchor positions.
+
+    @param [in,out] model the clock model of this anchor
+    @param [in] localTimestamp RX timestamp of the beacon
+    @param [in] referenceTimestamp TX timestamp the beacon carries
+    */
+    void updateClockModel(ClockModel& model, uint64_t localTimestamp, uint64_t referenceTimestamp);
+
+    /**
+    Converts a local timestamp (a blink RX) to the reference clock, at most a
+    half counter period (8.6 s) before or after the last beacon
+
+    @param [in] model a valid clock model
+    @param [in] localTimestamp the timestamp to convert
+
+    returns the 40 bit reference time
+    */
+    uint64_t toReferenceTime(const ClockModel& model, uint64_t localTimestamp);
+
+    /*** TDMA ***/
+
+    /**
+    Width of a slot holding one request and its reply: the reply delay, counted
+    from the request RX timestamp, plus the reply air time with the current
+    configuration and a guard for the next slot's preamble
+
+    @param [in] replyLength payload bytes of the reply
+    @param [in] replyDelayUs request RX -> reply TX of the responder
+    @param [in] guardUs margin between the reply and the next slot
+
+    returns the slot width in microseconds
+    */
+    uint16_t getSlotWidth(uint16_t replyLength, uint32_t replyDelayUs, uint16_t guardUs);
+
+    /**
+    @param [in] superframe the superframe
+
+    returns the time from its beacon to the end of the last slot in microseconds
+    */
+    uint32_t getSuperframeDuration(const Superframe& superframe);
+
+    /**
+    Writes the superframe fields of a beacon, LEN_SUPERFRAME bytes
+
+    @param [in] superframe the superframe the beacon opens
+    @param [out] data where the fields go in the beacon frame
+    */
+    void writeSuperframe(const Superframe& superframe, byte data[]);
+
+    /**
+    Takes the superframe from a received beacon. Its slots are timed from the
+    RX timestamp on this clock: over a superframe of a few milliseconds two
+    crystals 40 ppm apart drift well under a microsecond, no clock model needed.
+
+    @param [out] superframe the superframe of this node
+    @param [in] data the superframe fields of the beacon, LEN_SUPERFRAME bytes
+    @param [in] beaconTimestamp RX timestamp of the beacon
+    */
+    void readSuperframe(Superframe& superframe, byte data[], uint64_t beaconTimestamp);
+
+    /**
+    Schedules the next delayed transmission at the start of a slot. Call
+    startTransmit(TransmitMode::DELAYED) to send it and isTransmitLate() to
+    learn whether the slot was already gone.
+
+    @param [in] superframe the current superframe
+    @param [in] slot the slot, below superframe.slotCount
+
+    returns the transmit timestamp (antenna delay included)
+    */
+    uint64_t scheduleSlot(const Superframe& superframe, uint8_t slot);
 }
\ No newline at end of file
@@ -31,6 +31,87 @@
 
 namespace DW1000NgRanging {
 
+    namespace {
+        constexpr int32_t TOF_MAX = 0x7FFFFFFF;
+        constexpr uint64_t TOF_MAX_TICKS = static_cast<uint64_t>(TOF_MAX) >> TOF_FRACTIONAL_BITS;
+
+        /* range bias tables - APS011 */
+        constexpr uint8_t BIAS_ROWS = 18;
+
+        /* RX power of each row, -dBm */
+        const uint8_t _biasRxLevel[BIAS_ROWS] PROGMEM = {
+            61, 63, 65, 67, 69, 71, 73, 75, 77, 79, 81, 83, 85, 87, 89, 91, 93, 95
+        };
+
+        /* bias in mm: 16 and 64 MHz PRF on channels 1, 2, 3, 5, then on channels 4, 7 */
+        const int16_t _biasTable[4][BIAS_ROWS] PROGMEM = {
+            {-198, -187, -179, -163, -143, -127, -109, -84, -59, -31, 0, 36, 65, 84, 97, 106, 110, 112},
+            {-110, -105, -100, -93, -82, -69, -51, -27, 0, 21, 35, 42, 49, 62, 71, 76, 81, 86},
+            {-275, -244, -210, -176, -138, -95, -51, 0, 42, 97, 158, 210, 254, 294, 321, 339, 356, 394},
+            {-295, -266, -235, -199, -150, -100, -58, 0, 49, 91, 127, 153, 175, 197, 233, 245, 264, 284}
+        };
+
+        /* column of the applied configuration, see selectBiasTable(); until then
+           the first one, 16 MHz PRF on channels 1, 2, 3, 5 */
+        const int16_t *_biasColumn = _biasTable[0];
+
+        int32_t _biasLevelQ8(uint8_t row) {
+            return static_cast<int32_t>(pgm_read_byte(&_biasRxLevel[row])) << 8;
+        }
+
+        int16_t _biasAt(uint8_t row) {
+            return static_cast<int16_t>(pgm_read_word(&_biasColumn[row]));
+        }
+
+        /* ticks from one 40 bit timestamp to a later one, across the counter overflow */
+        uint64_t _elapsed(uint64_t from, uint64_t to) {
+            return (to - from) & static_cast<uint64_t>(TIME_MAX);
+        }
+    }
+
+    /* asymmetric two-way ranging, exact integer kernel */
+    int32_t computeTofAsymmetric(
+                                    uint64_t timePollSent, 
+                                    uint64_t timePollReceived, 
+                                    uint64_t timePollAckSent, 
+                                    uint64_t timePollAckReceived,
+                                    uint64_t timeRangeSent,
+                                    uint64_t timeRangeReceived
+                                )
+    {
+        uint64_t round1 = _elapsed(timePollSent, timePollAckReceived);
+        uint64_t reply1 = _elapsed(timePollReceived, timePollAckSent);
+        uint64_t round2 = _elapsed(timePollAckSent, timeRangeReceived);
+        uint64_t reply2 = _elapsed(timePollAckReceived, timeRangeSent);
+
+        /* at most 4 * 2^40, no overflow */
+        uint64_t denominator = round1 + round2 + reply1 + reply2;
+        if (denominator == 0)
+            return 0;
+
+        /* Both products can reach 2^80, but they are taken modulo 2^64.
+         * Clock offsets cancel in the difference, which is about
+         * TOF * denominator (below 2^60 up to 1 km): the wrapped
+         * difference is the exact one. */
+        uint64_t numerator = round1 * round2 - reply1 * reply2;
+        boolean negative = static_cast<int64_t>(numerator) < 0;
+        if (negative)
+            numerator = -numerator;
+
+        uint64_t ticks = numerator / denominator;
+        if (ticks > TOF_MAX_TICKS)
+            return negative ? -TOF_MAX : TOF_MAX;
+
+        /* remainder < 2^42, shifted by the fractional bits it still fits; round half away from zero */
+        uint64_t remainder = numerator - ticks * denominator;
+        uint64_t fraction = ((remainder << TOF_FRACTIONAL_BITS) + denominator / 2) / denominator;
+        uint64_t tof = (ticks << TOF_FRACTIONAL_BITS) + fraction;
+        if (tof > static_cast<uint64_t>(TOF_MAX))
+            tof = TOF_MAX;
+
+        return negative ? -static_cast<int32_t>(tof) : static_cast<int32_t>(tof);
+    }
+
     /* asymmetric two-way ranging (more computation intense, less error prone) */
     double computeRangeAsymmetric(    
                                     uint64_t timePollSent, 
@@ -41,48 +122,91 @@ namespace DW1000NgRanging {
                                     uint64_t timeRangeReceived
                                 )
     {
-        uint32_t timePollSent_32 = static_cast<uint32_t>(timePollSent);
-        uint32_t timePollReceived_32 = static_cast<uint32_t>(timePollReceived);
-        uint32_t timePollAckSent_32 = static_cast<uint32_t>(timePollAckSent);
-        uint32_t timePollAckReceived_32 = static_cast<uint32_t>(timePollAckReceived);
-        uint32_t timeRangeSent_32 = static_cast<uint32_t>(timeRangeSent);
-        uint32_t timeRangeReceived_32 = static_cast<uint32_t>(timeRangeReceived);
-        
-        double round1 = static_cast<double>(timePollAckReceived_32 - timePollSent_32);
-        double reply1 = static_cast<double>(timePollAckSent_32 - timePollReceived_32);
-        double round2 = static_cast<double>(timeRangeReceived_32 - timePollAckSent_32);
-        double reply2 = static_cast<double>(timeRangeSent_32 - timePollAckReceived_32);
-
-        int64_t tof_uwb = static_cast<int64_t>((round1 * round2 - reply1 * reply2) / (round1 + round2 + reply1 + reply2));
-        double distance = tof_uwb * DISTANCE_OF_RADIO;
-
-        return distance;
+        int32_t tof = computeTofAsymmetric(timePollSent, timePollReceived,
+                                           timePollAckSent, timePollAckReceived,
+                                           timeRangeSent, timeRangeReceived);
+        return tof * (DISTANCE_OF_RADIO / (1 << TOF_FRACTIONAL_BITS));
     }
 
-    double correctRange(double range) {
-        double result = 0;
-
-        Channel currentChannel = DW1000Ng::getChannel();
-        double rxPower = -(static_cast<double>(DW1000Ng::getReceivePower()));
-        
-        size_t index = DW1000Ng::getPulseFrequency() == PulseFrequency::FREQ_16MHZ ? 1 : 2;
-        if(currentChannel == Channel::CHANNEL_4 || currentChannel == Channel::CHANNEL_7)
-            index+=2;
-        
-        if (rxPower < BIAS_TABLE[0][0]) {
-            result = range += BIAS_TABLE[0][index]*0.001;
-        } else if (rxPower >= BIAS_TABLE[17][0]) {
-            result = range += BIAS_TABLE[17][index]*0.001;
-        } else {
-            for(auto i=0; i < 17; i++) {
-                if (rxPower >= BIAS_TABLE[i][0] && rxPower < BIAS_TABLE[i+1][0]){
-                    result = range += BIAS_TABLE[i][index]*0.001;
-                    break;
-                }
-            }
+    /* single-sided two-way ranging, reply time scaled to the initiator's clock */
+    int32_t computeTofSingleSided(
+                                    uint64_t timePollSent,
+                                    uint64_t timePollReceived,
+                                    uint64_t timeResponseSent,
+                                    uint64_t timeResponseReceived,
+                                    int32_t clockOffsetPpb
+                                )
+    {
+        uint64_t round = _elapsed(timePollSent, timeResponseReceived);
+        uint64_t reply = _elapsed(timePollReceived, timeResponseSent);
+
+        /* 2 * TOF = round - reply * (1 - offset), in 1/128 tick so that halving
+         * it leaves TOF_FRACTIONAL_BITS. reply * offset stays below 2^60 for
+         * offsets up to the 600 ppm the integrator reaches and reply times up
+         * to the counter period; 10^9 / 128 = 7812500 */
+        int64_t correction = static_cast<int64_t>(reply) * clockOffsetPpb;
+        int64_t half = correction < 0 ? -3906250 : 3906250;
+        int64_t tof = static_cast<int64_t>(round - reply) * (1 << (TOF_FRACTIONAL_BITS - 1))
+                    + (correction + half) / 7812500;
+
+        if (tof > TOF_MAX)
+            return TOF_MAX;
+        if (tof < -TOF_MAX)
+            return -TOF_MAX;
+        return static_cast<int32_t>(tof);
+    }
+
+    double computeRangeSingleSided(
+                                    uint64_t timePollSent,
+                                    uint64_t timePollReceived,
+                                    uint64_t timeResponseSent,
+                                    uint64_t timeResponseReceived,
+                                    int32_t clockOffsetPpb
+                                )
+    {
+        int32_t tof = computeTofSingleSided(timePollSent, timePollReceived,
+                                            timeResponseSent, timeResponseReceived,
+                                            clockOffsetPpb);
+        return tof * (DISTANCE_OF_RADIO / (1 << TOF_FRACTIONAL_BITS));
+    }
+
+    void selectBiasTable(Channel channel, PulseFrequency pulseFrequency) {
+        size_t column = pulseFrequency == PulseFrequency::FREQ_16MHZ ? 0 : 1;
+        if(channel == Channel::CHANNEL_4 || channel == Channel::CHANNEL_7)
+            column += 2;
+        _biasColumn = _biasTable[column];
+    }
+
+    int16_t getRangeBias(int16_t rxPowerQ8) {
+        int32_t level = -static_cast<int32_t>(rxPowerQ8);
+        if (level <= _biasLevelQ8(0))
+            return _biasAt(0);
+        if (level >= _biasLevelQ8(BIAS_ROWS - 1))
+            return _biasAt(BIAS_ROWS - 1);
+
+        /* rows low and high bracket the level */
+        uint8_t low = 0;
+        uint8_t high = BIAS_ROWS - 1;
+        while (high - low > 1) {
+            uint8_t middle = (low + high) / 2;
+            if (level >= _biasLevelQ8(middle))
+                low = middle;
+            else
+                high = middle;
         }
 
-        return result;
+        int32_t lowLevel = _biasLevelQ8(low);
+        int32_t span = _biasLevelQ8(high) - lowLevel;
+        int32_t lowBias = _biasAt(low);
+        return static_cast<int16_t>(lowBias + (_biasAt(high) - lowBias) * (level - lowLevel) / span);
+    }
+
+    double correctRange(double range, int16_t rxPowerQ8) {
+        return range + getRangeBias(rxPowerQ8) * 0.001;
+    }
+
+    double correctRange(double range) {
+        return correctRange(range, DW1000Ng::getReceivePowerQ8());
     }
 
 }
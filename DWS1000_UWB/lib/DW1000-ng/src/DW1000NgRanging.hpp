@@ -25,9 +25,40 @@
 #pragma once
 
 #include <Arduino.h>
+#include "DW1000NgConstants.hpp"
 
 namespace DW1000NgRanging {
 
+    /* fractional bits of the time of flight returned by computeTofAsymmetric() */
+    constexpr uint8_t TOF_FRACTIONAL_BITS = 8;
+
+    /**
+    Asymmetric two-way ranging time of flight, in integer arithmetic only.
+
+    Timestamps are 40 bit and may wrap between messages. Round and reply
+    times are exact 40 bit differences, the products are taken in 64 bit and
+    the division is rounded to nearest. The result is exact for ranges up to
+    a kilometre and reply times up to the 17 s counter period.
+
+    @param [in] timePollSent timestamp of poll transmission
+    @param [in] timePollReceived timestamp of poll receive
+    @param [in] timePollAckSent timestamp of response to poll transmission
+    @param [in] timePollAckReceived timestamp of response to poll receive
+    @param [in] timeRangeSent timestamp of final message transmission
+    @param [in] timeRangeReceived timestamp of final message receive
+
+    returns the time of flight in DW1000 ticks with TOF_FRACTIONAL_BITS
+    fractional bits (1/256 tick, 0.06 ps), saturated to int32_t
+    */
+    int32_t computeTofAsymmetric(
+                                        uint64_t timePollSent, 
+                                        uint64_t timePollReceived, 
+                                        uint64_t timePollAckSent, 
+                                        uint64_t timePollAckReceived,
+                                        uint64_t timeRangeSent,
+                                        uint64_t timeRangeReceived 
+                                 );
+
     /** 
     Asymmetric two-way ranging algorithm (more computation intense, less error prone) 
     
@@ -38,7 +69,7 @@ namespace DW1000NgRanging {
     @param [in] timeRangeSent timestamp of final message transmission
     @param [in] timeRangeReceived timestamp of final message receive
 
-    returns the range in meters
+    returns the range in meters, from computeTofAsymmetric()
     */
     double computeRangeAsymmetric(    
                                         uint64_t timePollSent, 
@@ -51,8 +82,85 @@ namespace DW1000NgRanging {
     //TODO Symmetric
 
     /**
-    Removes bias from the target range
-    
+    Single-sided two-way ranging time of flight, in integer arithmetic only.
+
+    Two messages instead of three: the responder's reply time, counted on its
+    own clock, is scaled to the initiator's clock with the offset the
+    initiator measured on the response (DW1000Ng::getClockOffsetPpb()).
+    What the offset misses shows up as reply time * error / 2: 1 ppb over a
+    1 ms reply is 0.5 ps, 0.15 mm. The scaling is linear, which adds
+    reply time * offset^2 / 2: half a tick at 40 ppm over 10 ms.
+
+    @param [in] timePollSent timestamp of poll transmission (initiator)
+    @param [in] timePollReceived timestamp of poll receive (responder)
+    @param [in] timeResponseSent timestamp of response transmission (responder)
+    @param [in] timeResponseReceived timestamp of response receive (initiator)
+    @param [in] clockOffsetPpb responder clock against the initiator's, positive when fast
+
+    returns the time of flight in DW1000 ticks with TOF_FRACTIONAL_BITS
+    fractional bits, saturated to int32_t
+    */
+    int32_t computeTofSingleSided(
+                                        uint64_t timePollSent,
+                                        uint64_t timePollReceived,
+                                        uint64_t timeResponseSent,
+                                        uint64_t timeResponseReceived,
+                                        int32_t clockOffsetPpb
+                                 );
+
+    /**
+    Single-sided two-way ranging with clock offset compensation
+
+    @param [in] timePollSent timestamp of poll transmission (initiator)
+    @param [in] timePollReceived timestamp of poll receive (responder)
+    @param [in] timeResponseSent timestamp of response transmission (responder)
+    @param [in] timeResponseReceived timestamp of response receive (initiator)
+    @param [in] clockOffsetPpb responder clock against the initiator's, positive when fast
+
+    returns the range in meters, from computeTofSingleSided()
+    */
+    double computeRangeSingleSided(
+                                        uint64_t timePollSent,
+                                        uint64_t timePollReceived,
+                                        uint64_t timeResponseSent,
+                                        uint64_t timeResponseReceived,
+                                        int32_t clockOffsetPpb
+                                 );
+
+    /**
+    Selects the APS011 range bias column for a configuration. Called by
+    DW1000Ng::applyConfiguration(), so the corrections below never look the
+    configuration up themselves.
+
+    @param [in] channel the configured channel
+    @param [in] pulseFrequency the configured pulse repetition frequency
+    */
+    void selectBiasTable(Channel channel, PulseFrequency pulseFrequency);
+
+    /**
+    Range bias at an RX power: binary search of the selected APS011 column,
+    linearly interpolated between rows and held at the first and last.
+
+    @param [in] rxPowerQ8 RX power in dBm, Q8.8 (see DW1000Ng::getReceivePowerQ8())
+
+    returns the bias in mm, to be added to the measured range
+    */
+    int16_t getRangeBias(int16_t rxPowerQ8);
+
+    /**
+    Removes bias from the target range, with an RX power already measured
+
+    @param [in] range the measured range in meters
+    @param [in] rxPowerQ8 RX power of the final message in dBm, Q8.8
+
+    returns the unbiased range
+    */
+    double correctRange(double range, int16_t rxPowerQ8);
+
+    /**
+    Removes bias from the target range, reading the RX power of the last
+    received frame from the chip
+
     returns the unbiased range
     */
     double correctRange(double range);
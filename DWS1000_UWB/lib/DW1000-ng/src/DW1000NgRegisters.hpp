@@ -79,6 +79,7 @@ constexpr uint16_t TRXOFF_BIT = 6;
 constexpr uint16_t WAIT4RESP_BIT = 7;
 constexpr uint16_t RXENAB_BIT = 8;
 constexpr uint16_t RXDLYS_BIT = 9;
+constexpr uint16_t HRBPT_BIT = 24;
 
 // system event status register
 constexpr uint16_t SYS_STATUS = 0x0F;
@@ -133,8 +134,10 @@ constexpr uint16_t LEN_SYS_TIME = 5;
 constexpr uint16_t RX_TIME = 0x15;
 constexpr uint16_t LEN_RX_TIME = 14;
 constexpr uint16_t RX_STAMP_SUB = 0x00;
+constexpr uint16_t FP_INDEX_SUB = 0x05;
 constexpr uint16_t FP_AMPL1_SUB = 0x07;
 constexpr uint16_t LEN_RX_STAMP = 5;
+constexpr uint16_t LEN_FP_INDEX = 2;
 constexpr uint16_t LEN_FP_AMPL1 = 2;
 
 // RX frame quality
@@ -177,6 +180,10 @@ constexpr uint16_t LEN_RX_FINFO = 4;
 constexpr uint16_t RX_BUFFER = 0x11;
 constexpr uint16_t LEN_RX_BUFFER = 1024;
 
+// accumulator (CIR) memory
+constexpr uint16_t ACC_MEM = 0x25;
+constexpr uint16_t LEN_ACC_MEM = 4064;
+
 // transmit control
 constexpr uint16_t TX_FCTRL = 0x08;
 constexpr uint16_t LEN_TX_FCTRL = 5;
@@ -332,6 +339,8 @@ constexpr uint16_t LEN_AON_CFG1 = 2;
 // PMSC
 constexpr uint16_t PMSC = 0x36;
 constexpr uint16_t PMSC_CTRL0_SUB = 0x00;
+constexpr uint16_t PMSC_CTRL0_FACE_SUB = 0x00; // FACE (bit 6) lives in the first byte
+constexpr uint16_t PMSC_CTRL0_AMCE_SUB = 0x01; // AMCE (bit 15) in the second
 constexpr uint16_t GPDCE_BIT = 18;
 constexpr uint16_t KHZCLKEN_BIT = 23;
 constexpr uint16_t PMSC_SOFTRESET_SUB = 0x03;
@@ -30,8 +30,17 @@
 #include "SPIporting.hpp"
 #include "DW1000NgConstants.hpp"
 #include "DW1000NgRegisters.hpp"
+#if DW1000NG_SPI_PROFILER && defined(DW1000NG_HOST)
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <string.h>
+	#include <errno.h>
+#endif
+#if DW1000NG_ESP32_SPI_DMA
+	#include <driver/spi_master.h>
+#endif
+
 
-    
 static SPIClass *_spi;
 
 namespace SPIporting {
@@ -51,24 +60,233 @@ namespace SPIporting {
 		const SPISettings _slowSPI = SPISettings(SPIminimumSpeed, MSBFIRST, SPI_MODE0);
 		const SPISettings* _currentSPI = &_fastSPI;
 
+		uint8_t _csSetupMicros = DW1000NG_SPI_CS_SETUP_US;
+		uint8_t _csHoldMicros = DW1000NG_SPI_CS_HOLD_US;
+
+		/* transfer(buf, n) overwrites buf with what comes back on MISO, so
+		 * payloads to write are copied through a small stack buffer */
+		constexpr uint8_t WriteChunkSize = 32;
+
 		void _openSPI(uint8_t slaveSelectPIN) {
 			_spi->beginTransaction(*_currentSPI);
 			digitalWrite(slaveSelectPIN, LOW);
+			if(_csSetupMicros != 0)
+				delayMicroseconds(_csSetupMicros);
+		}
+
+		void _holdSPI() {
+			if(_csHoldMicros != 0)
+				delayMicroseconds(_csHoldMicros);
+		}
+
+		void _writeData(const byte data[], uint16_t dataLen) {
+		#if defined(ESP32) || defined(ESP8266)
+			_spi->writeBytes(data, dataLen);
+		#else
+			byte chunk[WriteChunkSize];
+			while(dataLen > 0) {
+				uint8_t n = dataLen < WriteChunkSize ? dataLen : WriteChunkSize;
+				memcpy(chunk, data, n);
+				_spi->transfer(chunk, n);
+				data += n;
+				dataLen -= n;
+			}
+		#endif
 		}
 
     	void _closeSPI(uint8_t slaveSelectPIN) {
 			digitalWrite(slaveSelectPIN, HIGH);
 			_spi->endTransaction();
 		}
+
+#if DW1000NG_ESP32_SPI_DMA
+		/* The spi_master driver owns the bus, SPIClass is not used. The DW1000
+		 * header goes out in the address phase and the payload in a half-duplex
+		 * data phase, so the MISO-only reads run entirely on DMA. */
+		spi_device_handle_t _device = nullptr;
+		uint8_t _deviceSS = 0xff;
+		uint32_t _deviceClock = EspSPImaximumSpeed;
+		spi_transaction_ext_t _transactions[DW1000NG_SPI_QUEUE_DEPTH];
+		uint8_t _nextTransaction = 0;
+		uint8_t _inFlight = 0;
+
+		void IRAM_ATTR _onTransferDone(spi_transaction_t* transaction) {
+			void (*done)(void) = reinterpret_cast<void (*)(void)>(transaction->user);
+			if(done != nullptr)
+				(*done)();
+		}
+
+		/* Reclaims the n oldest queued transactions, waiting for them if needed */
+		void _collect(uint8_t n) {
+			spi_transaction_t* finished;
+			for(; n > 0 && _inFlight > 0; n--) {
+				spi_device_get_trans_result(_device, &finished, portMAX_DELAY);
+				_inFlight--;
+			}
+		}
+
+		uint8_t _microsToCycles(uint8_t micros) {
+			uint32_t cycles = (uint32_t)micros * (_deviceClock / 1000000);
+			return cycles > 16 ? 16 : (uint8_t)cycles; // hardware limit
+		}
+
+		void _attachDevice() {
+			if(_deviceSS == 0xff)
+				return;
+			_collect(_inFlight);
+			if(_device != nullptr)
+				spi_bus_remove_device(_device);
+			spi_device_interface_config_t config;
+			memset(&config, 0, sizeof(config));
+			config.mode = 0;
+			config.clock_speed_hz = _deviceClock;
+			config.spics_io_num = _deviceSS;
+			config.cs_ena_pretrans = _microsToCycles(_csSetupMicros);
+			config.cs_ena_posttrans = _microsToCycles(_csHoldMicros);
+			config.flags = SPI_DEVICE_HALFDUPLEX;
+			config.queue_size = DW1000NG_SPI_QUEUE_DEPTH;
+			config.post_cb = _onTransferDone;
+			spi_bus_add_device(DW1000NG_ESP32_SPI_HOST, &config, &_device);
+		}
+
+		spi_transaction_ext_t& _prepareTransaction(uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], boolean write, void (*done)(void)) {
+			if(_inFlight == DW1000NG_SPI_QUEUE_DEPTH)
+				_collect(1);
+			spi_transaction_ext_t& t = _transactions[_nextTransaction];
+			_nextTransaction = (_nextTransaction + 1) % DW1000NG_SPI_QUEUE_DEPTH;
+			memset(&t, 0, sizeof(t));
+			t.base.flags = SPI_TRANS_VARIABLE_ADDR;
+			t.address_bits = headerLen * 8;
+			for(uint8_t i = 0; i < headerLen; i++)
+				t.base.addr = (t.base.addr << 8) | header[i];
+			if(write) {
+				t.base.length = dataLen * 8;
+				t.base.tx_buffer = data;
+			} else {
+				t.base.rxlength = dataLen * 8;
+				t.base.rx_buffer = data;
+			}
+			t.base.user = reinterpret_cast<void*>(done);
+			return t;
+		}
+
+		void _queueTransfer(uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], boolean write, void (*done)(void)) {
+			spi_transaction_ext_t& t = _prepareTransaction(headerLen, header, dataLen, data, write, done);
+			spi_device_queue_trans(_device, &t.base, portMAX_DELAY);
+			_inFlight++;
+		}
+
+		void _pollTransfer(uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], boolean write) {
+			_collect(_inFlight);
+			spi_transaction_ext_t& t = _prepareTransaction(headerLen, header, dataLen, data, write, nullptr);
+			spi_device_polling_transmit(_device, &t.base);
+		}
+#endif
+
+#if DW1000NG_SPI_PROFILER
+		struct RegisterProfile {
+			uint16_t reads;
+			uint16_t writes;
+			uint32_t bytes;
+			uint32_t micros;
+		};
+
+		struct ApiProfile {
+			const char* name; // PROGMEM, nullptr for the (other) slot
+			uint16_t calls;
+			uint16_t transactions;
+			uint32_t bytes;
+			uint32_t micros;
+		};
+
+		constexpr uint8_t OtherApi = DW1000NG_SPI_PROFILER_APIS;
+		constexpr uint8_t HistogramWidth = 20;
+
+		RegisterProfile _registerProfile[0x40];
+		ApiProfile _apiProfile[DW1000NG_SPI_PROFILER_APIS + 1];
+		volatile uint8_t _currentApi = OtherApi;
+
+		/* Called before _closeSPI: the bus is still held, so SPI.usingInterrupt()
+		 * keeps the DW1000 ISR from updating the same counters meanwhile. */
+		void _profileTransaction(byte header0, uint16_t bytes, uint32_t startedAt) {
+			uint32_t elapsed = micros() - startedAt;
+			RegisterProfile& reg = _registerProfile[header0 & 0x3F];
+			if(header0 & 0x80)
+				reg.writes++;
+			else
+				reg.reads++;
+			reg.bytes += bytes;
+			reg.micros += elapsed;
+			ApiProfile& api = _apiProfile[_currentApi];
+			api.transactions++;
+			api.bytes += bytes;
+			api.micros += elapsed;
+		}
+
+	#if defined(DW1000NG_HOST)
+		FILE* _dumpFile;
+
+		void _emit(const char* text) { fputs(text, _dumpFile); }
+		void _emitFlash(const char* text) { fputs(text, _dumpFile); }
+		void _endLine() { fputc('\n', _dumpFile); }
+	#else
+		void _emit(const char* text) { Serial.print(text); }
+		void _emitFlash(const char* text) { Serial.print(reinterpret_cast<const __FlashStringHelper*>(text)); }
+		void _endLine() { Serial.println(); }
+	#endif
+
+		uint8_t _share(uint32_t part, uint32_t total) {
+			return total == 0 ? 0 : (uint8_t)((uint64_t)part * 100 / total);
+		}
+
+		void _emitCounters(char* buf, size_t len, uint32_t bytes, uint32_t elapsed, uint32_t total) {
+			uint8_t share = _share(elapsed, total);
+			snprintf_P(buf, len, PSTR(" %9lu %9lu %3u%% "), (unsigned long)bytes, (unsigned long)elapsed, share);
+			_emit(buf);
+			uint8_t i = 0;
+			for(; i < share * HistogramWidth / 100; i++)
+				buf[i] = '#';
+			buf[i] = '\0';
+			_emit(buf);
+			_endLine();
+		}
+#endif
 	}
 
 	void SPIinit(SPIClass &spi) {
 		_spi = &spi;
-		_spi->begin();
+		#if DW1000NG_ESP32_SPI_DMA
+			spi_bus_config_t bus;
+			memset(&bus, 0, sizeof(bus));
+			bus.mosi_io_num = DW1000NG_ESP32_PIN_MOSI;
+			bus.miso_io_num = DW1000NG_ESP32_PIN_MISO;
+			bus.sclk_io_num = DW1000NG_ESP32_PIN_SCK;
+			bus.quadwp_io_num = -1;
+			bus.quadhd_io_num = -1;
+			bus.max_transfer_sz = LEN_RX_BUFFER + 8;
+			spi_bus_initialize(DW1000NG_ESP32_SPI_HOST, &bus, SPI_DMA_CH_AUTO);
+		#else
+			_spi->begin();
+		#endif
+		#if DW1000NG_SPI_PROFILER && defined(DW1000NG_HOST)
+			static boolean dumpAtExit = false;
+			if(!dumpAtExit) {
+				atexit(dumpProfile);
+				dumpAtExit = true;
+			}
+		#endif
 	}
 
 	void SPIend() {
-		_spi->end();
+		#if DW1000NG_ESP32_SPI_DMA
+			_collect(_inFlight);
+			if(_device != nullptr)
+				spi_bus_remove_device(_device);
+			_device = nullptr;
+			spi_bus_free(DW1000NG_ESP32_SPI_HOST);
+		#else
+			_spi->end();
+		#endif
 	}
 
 	void SPIselect(uint8_t slaveSelectPIN, uint8_t irq) {
@@ -76,40 +294,220 @@ namespace SPIporting {
 			if(irq != 0xff)
 				_spi->usingInterrupt(digitalPinToInterrupt(irq));
 		#endif
-		pinMode(slaveSelectPIN, OUTPUT);
-		digitalWrite(slaveSelectPIN, HIGH);
+		#if DW1000NG_ESP32_SPI_DMA
+			_deviceSS = slaveSelectPIN;
+			_attachDevice();
+		#else
+			pinMode(slaveSelectPIN, OUTPUT);
+			digitalWrite(slaveSelectPIN, HIGH);
+		#endif
 	}
 
+#if DW1000NG_ESP32_SPI_DMA
 	void writeToSPI(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[]) {
+		#if DW1000NG_SPI_PROFILER
+			uint32_t startedAt = micros();
+		#endif
+		_pollTransfer(headerLen, header, dataLen, data, true);
+		#if DW1000NG_SPI_PROFILER
+			_profileTransaction(header[0], headerLen + dataLen, startedAt);
+		#endif
+	}
+
+    void readFromSPI(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[]){
+		#if DW1000NG_SPI_PROFILER
+			uint32_t startedAt = micros();
+		#endif
+		_pollTransfer(headerLen, header, dataLen, data, false);
+		#if DW1000NG_SPI_PROFILER
+			_profileTransaction(header[0], headerLen + dataLen, startedAt);
+		#endif
+	}
+
+	void writeToSPIAsync(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], void (*done)(void)) {
+		#if DW1000NG_SPI_PROFILER
+			uint32_t startedAt = micros();
+		#endif
+		_queueTransfer(headerLen, header, dataLen, data, true, done);
+		#if DW1000NG_SPI_PROFILER
+			_profileTransaction(header[0], headerLen + dataLen, startedAt);
+		#endif
+	}
+
+	void readFromSPIAsync(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], void (*done)(void)) {
+		#if DW1000NG_SPI_PROFILER
+			uint32_t startedAt = micros();
+		#endif
+		_queueTransfer(headerLen, header, dataLen, data, false, done);
+		#if DW1000NG_SPI_PROFILER
+			_profileTransaction(header[0], headerLen + dataLen, startedAt);
+		#endif
+	}
+
+	void flushSPI() {
+		_collect(_inFlight);
+	}
+#else
+	void writeToSPI(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[]) {
+		#if DW1000NG_SPI_PROFILER
+			uint32_t startedAt = micros();
+		#endif
 		_openSPI(slaveSelectPIN);
 		for(auto i = 0; i < headerLen; i++) {
 			_spi->transfer(header[i]); // send header
 		}
-		for(auto i = 0; i < dataLen; i++) {
-			_spi->transfer(data[i]); // write values
-		}
-		delayMicroseconds(5);
+		_writeData(data, dataLen); // write values
+		_holdSPI();
+		#if DW1000NG_SPI_PROFILER
+			_profileTransaction(header[0], headerLen + dataLen, startedAt);
+		#endif
 		_closeSPI(slaveSelectPIN);
 	}
 
     void readFromSPI(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[]){
+		#if DW1000NG_SPI_PROFILER
+			uint32_t startedAt = micros();
+		#endif
 		_openSPI(slaveSelectPIN);
 		for(auto i = 0; i < headerLen; i++) {
 			_spi->transfer(header[i]); // send header
 		}
-		for(auto i = 0; i < dataLen; i++) {
-			data[i] = _spi->transfer(0x00); // read values
-		}
-		delayMicroseconds(5);
+		memset(data, 0x00, dataLen);
+		_spi->transfer(data, dataLen); // read values
+		_holdSPI();
+		#if DW1000NG_SPI_PROFILER
+			_profileTransaction(header[0], headerLen + dataLen, startedAt);
+		#endif
 		_closeSPI(slaveSelectPIN);
 	}
 
+	void writeToSPIAsync(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], void (*done)(void)) {
+		writeToSPI(slaveSelectPIN, headerLen, header, dataLen, data);
+		if(done != nullptr)
+			(*done)();
+	}
+
+	void readFromSPIAsync(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], void (*done)(void)) {
+		readFromSPI(slaveSelectPIN, headerLen, header, dataLen, data);
+		if(done != nullptr)
+			(*done)();
+	}
+
+	void flushSPI() {
+	}
+#endif
+
 	void setSPIspeed(SPIClock speed) {
 		if(speed == SPIClock::FAST) {
 			_currentSPI = &_fastSPI;
 		 } else if(speed == SPIClock::SLOW) {
 			_currentSPI = &_slowSPI;
 		 }
+		#if DW1000NG_ESP32_SPI_DMA
+			_deviceClock = speed == SPIClock::FAST ? EspSPImaximumSpeed : SPIminimumSpeed;
+			_attachDevice();
+		#endif
+	}
+
+	void setChipSelectTiming(uint8_t setupMicroseconds, uint8_t holdMicroseconds) {
+		_csSetupMicros = setupMicroseconds;
+		_csHoldMicros = holdMicroseconds;
+		#if DW1000NG_ESP32_SPI_DMA
+			_attachDevice();
+		#endif
+	}
+
+#if DW1000NG_SPI_PROFILER
+	ApiScope::ApiScope(const char* name) : _previous(_currentApi) {
+		/* The first call of a function claims a free slot. An ISR doing the same
+		 * in between can end up sharing it; later calls are exact. */
+		uint8_t i = 0;
+		while(i < OtherApi && _apiProfile[i].name != nullptr && _apiProfile[i].name != name)
+			i++;
+		if(i < OtherApi)
+			_apiProfile[i].name = name;
+		_apiProfile[i].calls++;
+		_currentApi = i;
+	}
+
+	ApiScope::~ApiScope() {
+		_currentApi = _previous;
+	}
+
+	void resetProfile() {
+		memset(_registerProfile, 0, sizeof(_registerProfile));
+		memset(_apiProfile, 0, sizeof(_apiProfile));
+	}
+
+	void dumpProfile() {
+		#if defined(DW1000NG_HOST)
+			const char* path = getenv("DW1000NG_SPI_PROFILE");
+			if(path == nullptr)
+				path = "spi_profile.txt";
+			_dumpFile = fopen(path, "w");
+			if(_dumpFile == nullptr) {
+				/* once: the dump at exit would repeat it */
+				static bool reported = false;
+				if(!reported)
+					fprintf(stderr, "SPI profile: cannot write %s: %s\n", path, strerror(errno));
+				reported = true;
+				return;
+			}
+		#endif
+		char buf[HistogramWidth + 28];
+
+		uint32_t total = 0;
+		uint32_t transactions = 0;
+		uint32_t bytes = 0;
+		for(uint8_t reg = 0; reg < 0x40; reg++) {
+			total += _registerProfile[reg].micros;
+			transactions += _registerProfile[reg].reads + _registerProfile[reg].writes;
+			bytes += _registerProfile[reg].bytes;
+		}
+		snprintf_P(buf, sizeof(buf), PSTR("%lu transactions, "), (unsigned long)transactions);
+		_emitFlash(PSTR("SPI profile: "));
+		_emit(buf);
+		snprintf_P(buf, sizeof(buf), PSTR("%lu bytes, %lu us"), (unsigned long)bytes, (unsigned long)total);
+		_emit(buf);
+		_endLine();
+
+		_emitFlash(PSTR("reg      reads  writes     bytes        us share"));
+		_endLine();
+		for(uint8_t reg = 0; reg < 0x40; reg++) {
+			const RegisterProfile& p = _registerProfile[reg];
+			if(p.reads == 0 && p.writes == 0)
+				continue;
+			snprintf_P(buf, sizeof(buf), PSTR("0x%02X  %7u %7u"), reg, p.reads, p.writes);
+			_emit(buf);
+			_emitCounters(buf, sizeof(buf), p.bytes, p.micros, total);
+		}
+
+		_emitFlash(PSTR("api                               calls   trans     bytes        us share"));
+		_endLine();
+		for(uint8_t i = 0; i <= OtherApi; i++) {
+			const ApiProfile& p = _apiProfile[i];
+			if(p.transactions == 0)
+				continue;
+			uint8_t width = 0;
+			if(p.name != nullptr) {
+				_emitFlash(p.name);
+				while(pgm_read_byte(p.name + width) != '\0')
+					width++;
+			} else {
+				_emitFlash(PSTR("(other)"));
+				width = 7;
+			}
+			for(; width < 32; width++)
+				_emit(" ");
+			snprintf_P(buf, sizeof(buf), PSTR(" %6u  %6u"), p.calls, p.transactions);
+			_emit(buf);
+			_emitCounters(buf, sizeof(buf), p.bytes, p.micros, total);
+		}
+
+		#if defined(DW1000NG_HOST)
+			fclose(_dumpFile);
+		#endif
 	}
+#endif
 
-}
\ No newline at end of file
+}
@@ -29,8 +29,21 @@
 
 #include <Arduino.h>
 #include "DW1000NgConstants.hpp"
+#include "DW1000NgCompileOptions.hpp"
 #include <SPI.h>
 
+#if DW1000NG_SPI_PROFILER
+	/**
+	Attributes the SPI traffic of the enclosing function to it in the profiler.
+	The name lives in flash; nested calls are charged to the innermost function.
+	*/
+	#define DW1000NG_PROFILE_API(name) \
+		static const char _profiledApiName[] PROGMEM = name; \
+		SPIporting::ApiScope _profiledApiScope(_profiledApiName)
+#else
+	#define DW1000NG_PROFILE_API(name)
+#endif
+
 namespace SPIporting{
 
     /** 
@@ -71,6 +84,37 @@ namespace SPIporting{
     */
     void readFromSPI(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[]);
 
+    /**
+    Queues a write and returns without waiting for it when the ESP32 DMA
+    backend is enabled (DW1000NG_ESP32_SPI_DMA), otherwise writes immediately.
+    The header is copied, data[] must stay valid until done runs.
+    Queued transactions complete in order, blocking calls wait for them first.
+
+    @param [in] Header lenght
+    @param [in] Header array built before 
+    @param [in] Data lenght
+    @param [in] Data array 
+    @param [in] done called on completion (interrupt context with the DMA backend), may be nullptr
+    */
+    void writeToSPIAsync(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], void (*done)(void));
+
+    /**
+    Queues a read, see writeToSPIAsync(). RX buffer and accumulator reads are
+    the ones worth queueing: the CPU keeps going while DMA fills data[].
+
+    @param [in] Header lenght
+    @param [in] Header array built before 
+    @param [in] Data lenght
+    @param [out] Data array, valid once done has run
+    @param [in] done called on completion (interrupt context with the DMA backend), may be nullptr
+    */
+    void readFromSPIAsync(uint8_t slaveSelectPIN, uint8_t headerLen, byte header[], uint16_t dataLen, byte data[], void (*done)(void));
+
+    /**
+    Waits until every queued transaction has completed.
+    */
+    void flushSPI();
+
     /**
     Sets speed of SPI clock, fast or slow(20MHz or 2MHz)
 
@@ -78,4 +122,44 @@ namespace SPIporting{
     */
     void setSPIspeed(SPIClock speed);
 
+    /**
+    Sets the chip select timing of every transaction. 0 skips the wait
+    entirely; defaults come from DW1000NG_SPI_CS_SETUP_US/DW1000NG_SPI_CS_HOLD_US.
+
+    @param [in] setupMicroseconds wait between CS low and the first byte
+    @param [in] holdMicroseconds wait between the last byte and CS high
+    */
+    void setChipSelectTiming(uint8_t setupMicroseconds, uint8_t holdMicroseconds);
+
+#if DW1000NG_SPI_PROFILER
+    /**
+    Marks the SPI transactions issued during its lifetime as belonging to one
+    API function. Use through DW1000NG_PROFILE_API().
+
+    @param [in] name PROGMEM string with the function name
+    */
+    class ApiScope {
+    public:
+        explicit ApiScope(const char* name);
+        ~ApiScope();
+    private:
+        uint8_t _previous;
+    };
+
+    /**
+    Clears every profiler counter.
+    */
+    void resetProfile();
+
+    /**
+    Dumps the profile: for each register and each calling function the number
+    of transactions, bytes moved, time spent with the bus held (micros()) and a
+    histogram bar of its share of the total time.
+    Prints to Serial; the host build writes it to the file named by the
+    DW1000NG_SPI_PROFILE environment variable (default spi_profile.txt),
+    and does so automatically at exit.
+    */
+    void dumpProfile();
+#endif
+
 }
\ No newline at end of file
@@ -77,14 +77,19 @@ public:
 	boolean isAddressEqual(DW1000Device* device);
 	boolean isShortAddressEqual(DW1000Device* device);
 	
-	//functions which contains the date: (easier to put as public)
-	// timestamps to remember
-	DW1000Time timePollSent;
-	DW1000Time timePollReceived;
-	DW1000Time timePollAckSent;
-	DW1000Time timePollAckReceived;
-	DW1000Time timeRangeSent;
-	DW1000Time timeRangeReceived;
+	// timestamps of the exchange in flight, 40 bit packed in 5 bytes (use
+	// DW1000Time(bytes) to compute with them). Which ones a device holds
+	// depends on our role; the rest of an exchange only lives in its frame,
+	// our own POLL and RANGE TX times in DW1000RangingClass (one per round).
+	union {
+		struct { // we are the anchor, the device is a tag
+			byte timePollReceived[DW1000Time::LENGTH_TIMESTAMP];
+			byte timePollAckSent[DW1000Time::LENGTH_TIMESTAMP];
+		} asAnchor;
+		struct { // we are the tag, the device is an anchor
+			byte timePollAckReceived[DW1000Time::LENGTH_TIMESTAMP];
+		} asTag;
+	};
 	
 	void    noteActivity();
 	boolean isInactive();
@@ -96,7 +101,7 @@ private:
 	byte         _shortAddress[2];
 	int32_t      _activity;
 	uint16_t     _replyDelayTimeUS;
-	int8_t       _index; // not used
+	int8_t       _index; // position in the network devices table
 	
 	int16_t _range;
 	int16_t _RXPower;
@@ -39,6 +39,11 @@ byte         DW1000RangingClass::_currentAddress[8];
 byte         DW1000RangingClass::_currentShortAddress[2];
 byte         DW1000RangingClass::_lastSentToShortAddress[2];
 volatile uint8_t DW1000RangingClass::_networkDevicesNumber = 0; // TODO short, 8bit?
+uint8_t      DW1000RangingClass::_deviceIndex[DEVICE_INDEX_SIZE];
+uint8_t      DW1000RangingClass::_rangingFirst = 0;
+uint8_t      DW1000RangingClass::_rangingCount = 0;
+byte         DW1000RangingClass::_timePollSent[DW1000Time::LENGTH_TIMESTAMP];
+byte         DW1000RangingClass::_timeRangeSent[DW1000Time::LENGTH_TIMESTAMP];
 int16_t      DW1000RangingClass::_lastDistantDevice    = 0; // TODO short, 8bit?
 DW1000Mac    DW1000RangingClass::_globalMac;
 
@@ -223,78 +228,106 @@ void DW1000RangingClass::startAsTag(char address[], const byte mode[], const boo
 }
 
 boolean DW1000RangingClass::addNetworkDevices(DW1000Device* device, boolean shortAddress) {
-	boolean   addDevice = true;
 	//we test our network devices array to check
 	//we don't already have it
-	for(uint8_t i = 0; i < _networkDevicesNumber; i++) {
-		if(_networkDevices[i].isAddressEqual(device) && !shortAddress) {
+	if(shortAddress) {
+		if(findNetworkDevice(device->getByteShortAddress()) >= 0) {
 			//the device already exists
-			addDevice = false;
 			return false;
 		}
-		else if(_networkDevices[i].isShortAddressEqual(device) && shortAddress) {
-			//the device already exists
-			addDevice = false;
-			return false;
+	}
+	else {
+		for(uint8_t i = 0; i < _networkDevicesNumber; i++) {
+			if(_networkDevices[i].isAddressEqual(device)) {
+				//the device already exists
+				return false;
+			}
 		}
-		
 	}
-	
-	if(addDevice) {
-		device->setRange(0);
-		memcpy(&_networkDevices[_networkDevicesNumber], device, sizeof(DW1000Device));
-		_networkDevices[_networkDevicesNumber].setIndex(_networkDevicesNumber);
-		_networkDevicesNumber++;
-		return true;
+
+	if(_networkDevicesNumber >= MAX_DEVICES) {
+		//no room left
+		return false;
 	}
-	
-	return false;
+	device->setRange(0);
+	memcpy(&_networkDevices[_networkDevicesNumber], device, sizeof(DW1000Device));
+	_networkDevices[_networkDevicesNumber].setIndex(_networkDevicesNumber);
+	indexNetworkDevice(_networkDevicesNumber);
+	_networkDevicesNumber++;
+	return true;
 }
 
 boolean DW1000RangingClass::addNetworkDevices(DW1000Device* device) {
-	boolean addDevice = true;
 	//we test our network devices array to check
 	//we don't already have it
-	for(uint8_t i = 0; i < _networkDevicesNumber; i++) {
-		if(_networkDevices[i].isAddressEqual(device) && _networkDevices[i].isShortAddressEqual(device)) {
-			//the device already exists
-			addDevice = false;
-			return false;
-		}
-		
+	int8_t index = findNetworkDevice(device->getByteShortAddress());
+	if(index >= 0 && _networkDevices[index].isAddressEqual(device)) {
+		//the device already exists
+		return false;
 	}
-	
-	if(addDevice) {
-		if(_type == ANCHOR) //for now let's start with 1 TAG
-		{
-			_networkDevicesNumber = 0;
-		}
-		memcpy(&_networkDevices[_networkDevicesNumber], device, sizeof(DW1000Device));
-		_networkDevices[_networkDevicesNumber].setIndex(_networkDevicesNumber);
-		_networkDevicesNumber++;
-		return true;
+
+	if(_type == ANCHOR) //for now let's start with 1 TAG
+	{
+		clearNetworkDevices();
 	}
-	
-	return false;
+	if(_networkDevicesNumber >= MAX_DEVICES) {
+		//no room left
+		return false;
+	}
+	memcpy(&_networkDevices[_networkDevicesNumber], device, sizeof(DW1000Device));
+	_networkDevices[_networkDevicesNumber].setIndex(_networkDevicesNumber);
+	indexNetworkDevice(_networkDevicesNumber);
+	_networkDevicesNumber++;
+	return true;
 }
 
 void DW1000RangingClass::removeNetworkDevices(int16_t index) {
-	//if we have just 1 element
-	if(_networkDevicesNumber == 1) {
-		_networkDevicesNumber = 0;
+	//the last element takes the place of the one we delete
+	_networkDevicesNumber--;
+	if(index != _networkDevicesNumber) {
+		memcpy(&_networkDevices[index], &_networkDevices[_networkDevicesNumber], sizeof(DW1000Device));
+		_networkDevices[index].setIndex(index);
 	}
-	else if(index == _networkDevicesNumber-1) //if we delete the last element
-	{
-		_networkDevicesNumber--;
+	//positions changed: rebuild the index, removal only happens on inactivity
+	memset(_deviceIndex, 0, sizeof(_deviceIndex));
+	for(uint8_t i = 0; i < _networkDevicesNumber; i++) {
+		indexNetworkDevice(i);
 	}
-	else {
-		//we translate all the element wich are after the one we want to delete.
-		for(int16_t i = index; i < _networkDevicesNumber-1; i++) { // TODO 8bit?
-			memcpy(&_networkDevices[i], &_networkDevices[i+1], sizeof(DW1000Device));
-			_networkDevices[i].setIndex(i);
+}
+
+uint8_t DW1000RangingClass::hashShortAddress(const byte shortAddress[]) {
+	return (shortAddress[0]+31*shortAddress[1]) & (DEVICE_INDEX_SIZE-1);
+}
+
+int8_t DW1000RangingClass::findNetworkDevice(const byte shortAddress[]) {
+	//linear probing, the index is never more than half full
+	uint8_t slot = hashShortAddress(shortAddress);
+	while(_deviceIndex[slot] != 0) {
+		int8_t index = _deviceIndex[slot]-1;
+		if(memcmp(shortAddress, _networkDevices[index].getByteShortAddress(), 2) == 0) {
+			return index;
 		}
-		_networkDevicesNumber--;
+		slot = (slot+1) & (DEVICE_INDEX_SIZE-1);
+	}
+	return -1;
+}
+
+void DW1000RangingClass::indexNetworkDevice(uint8_t index) {
+	uint8_t slot = hashShortAddress(_networkDevices[index].getByteShortAddress());
+	while(_deviceIndex[slot] != 0) {
+		slot = (slot+1) & (DEVICE_INDEX_SIZE-1);
 	}
+	_deviceIndex[slot] = index+1;
+}
+
+void DW1000RangingClass::clearNetworkDevices() {
+	_networkDevicesNumber = 0;
+	memset(_deviceIndex, 0, sizeof(_deviceIndex));
+}
+
+DW1000Device* DW1000RangingClass::rangingDevice(uint8_t i) {
+	//the i-th device of the broadcast round in flight
+	return &_networkDevices[(_rangingFirst+i) % _networkDevicesNumber];
 }
 
 /* ###########################################################################
@@ -308,15 +341,12 @@ void DW1000RangingClass::setResetPeriod(uint32_t resetPeriod) { _resetPeriod = r
 
 
 DW1000Device* DW1000RangingClass::searchDistantDevice(byte shortAddress[]) {
-	//we compare the 2 bytes address with the others
-	for(uint16_t i = 0; i < _networkDevicesNumber; i++) { // TODO 8bit?
-		if(memcmp(shortAddress, _networkDevices[i].getByteShortAddress(), 2) == 0) {
-			//we have found our device !
-			return &_networkDevices[i];
-		}
+	//we look the 2 bytes address up in the index
+	int8_t index = findNetworkDevice(shortAddress);
+	if(index < 0) {
+		return nullptr;
 	}
-	
-	return nullptr;
+	return &_networkDevices[index];
 }
 
 DW1000Device* DW1000RangingClass::getDistantDevice() {
@@ -343,14 +373,17 @@ void DW1000RangingClass::checkForReset() {
 }
 
 void DW1000RangingClass::checkForInactiveDevices() {
-	for(uint8_t i = 0; i < _networkDevicesNumber; i++) {
+	for(uint8_t i = 0; i < _networkDevicesNumber;) {
 		if(_networkDevices[i].isInactive()) {
 			if(_handleInactiveDevice != 0) {
 				(*_handleInactiveDevice)(&_networkDevices[i]);
 			}
 			//we need to delete the device from the array:
+			//the last one moves to i, check it next
 			removeNetworkDevices(i);
-			
+		}
+		else {
+			i++;
 		}
 	}
 }
@@ -394,49 +427,17 @@ void DW1000RangingClass::loop() {
 				DW1000Device* myDistantDevice = searchDistantDevice(_lastSentToShortAddress);
 				
 				if (myDistantDevice) {
-					DW1000.getTransmitTimestamp(myDistantDevice->timePollAckSent);
+					DW1000.getTransmitTimestamp(myDistantDevice->asAnchor.timePollAckSent);
 				}
 			}
 		}
 		else if(_type == TAG) {
+			//one POLL or RANGE at a time, broadcast or not: saved once for all the devices
 			if(messageType == POLL) {
-				DW1000Time timePollSent;
-				DW1000.getTransmitTimestamp(timePollSent);
-				//if the last device we send the POLL is broadcast:
-				if(_lastSentToShortAddress[0] == 0xFF && _lastSentToShortAddress[1] == 0xFF) {
-					//we save the value for all the devices !
-					for(uint16_t i = 0; i < _networkDevicesNumber; i++) {
-						_networkDevices[i].timePollSent = timePollSent;
-					}
-				}
-				else {
-					//we search the device associated with the last send address
-					DW1000Device* myDistantDevice = searchDistantDevice(_lastSentToShortAddress);
-					//we save the value just for one device
-					if (myDistantDevice) {
-						myDistantDevice->timePollSent = timePollSent;
-					}
-				}
+				DW1000.getTransmitTimestamp(_timePollSent);
 			}
 			else if(messageType == RANGE) {
-				DW1000Time timeRangeSent;
-				DW1000.getTransmitTimestamp(timeRangeSent);
-				//if the last device we send the POLL is broadcast:
-				if(_lastSentToShortAddress[0] == 0xFF && _lastSentToShortAddress[1] == 0xFF) {
-					//we save the value for all the devices !
-					for(uint16_t i = 0; i < _networkDevicesNumber; i++) {
-						_networkDevices[i].timeRangeSent = timeRangeSent;
-					}
-				}
-				else {
-					//we search the device associated with the last send address
-					DW1000Device* myDistantDevice = searchDistantDevice(_lastSentToShortAddress);
-					//we save the value just for one device
-					if (myDistantDevice) {
-						myDistantDevice->timeRangeSent = timeRangeSent;
-					}
-				}
-				
+				DW1000.getTransmitTimestamp(_timeRangeSent);
 			}
 		}
 		
@@ -540,7 +541,7 @@ void DW1000RangingClass::loop() {
 							// on POLL we (re-)start, so no protocol failure
 							_protocolFailed = false;
 							
-							DW1000.getReceiveTimestamp(myDistantDevice->timePollReceived);
+							DW1000.getReceiveTimestamp(myDistantDevice->asAnchor.timePollReceived);
 							//we note activity for our device:
 							myDistantDevice->noteActivity();
 							//we indicate our next receive message for our ranging protocole
@@ -571,19 +572,17 @@ void DW1000RangingClass::loop() {
 						//we test if the short address is our address
 						if(shortAddress[0] == _currentShortAddress[0] && shortAddress[1] == _currentShortAddress[1]) {
 							//we grab the replytime wich is for us
-							DW1000.getReceiveTimestamp(myDistantDevice->timeRangeReceived);
+							DW1000Time timeRangeReceived;
+							DW1000.getReceiveTimestamp(timeRangeReceived);
 							noteActivity();
 							_expectedMsgId = POLL;
-							
+
 							if(!_protocolFailed) {
-								
-								myDistantDevice->timePollSent.setTimestamp(data+SHORT_MAC_LEN+4+17*i);
-								myDistantDevice->timePollAckReceived.setTimestamp(data+SHORT_MAC_LEN+9+17*i);
-								myDistantDevice->timeRangeSent.setTimestamp(data+SHORT_MAC_LEN+14+17*i);
-								
-								// (re-)compute range as two-way ranging is done
+
+								// (re-)compute range as two-way ranging is done, the tag's
+								// POLL sent, POLL_ACK received and RANGE sent follow the address
 								DW1000Time myTOF;
-								computeRangeAsymmetric(myDistantDevice, &myTOF); // CHOSEN RANGING ALGORITHM
+								computeRangeAsymmetric(myDistantDevice, data+SHORT_MAC_LEN+4+17*i, timeRangeReceived, &myTOF); // CHOSEN RANGING ALGORITHM
 								
 								float distance = myTOF.getAsMeters();
 								
@@ -633,12 +632,12 @@ void DW1000RangingClass::loop() {
 					return;
 				}
 				if(messageType == POLL_ACK) {
-					DW1000.getReceiveTimestamp(myDistantDevice->timePollAckReceived);
+					DW1000.getReceiveTimestamp(myDistantDevice->asTag.timePollAckReceived);
 					//we note activity for our device:
 					myDistantDevice->noteActivity();
-					
-					//in the case the message come from our last device:
-					if(myDistantDevice->getIndex() == _networkDevicesNumber-1) {
+
+					//in the case the message come from the last device of the round:
+					if(_rangingCount > 0 && myDistantDevice == rangingDevice(_rangingCount-1)) {
 						_expectedMsgId = RANGE_REPORT;
 						//and transmit the next message (range) of the ranging protocole (in broadcast)
 						transmitRange(nullptr);
@@ -796,23 +795,30 @@ void DW1000RangingClass::transmitPoll(DW1000Device* myDistantDevice) {
 	transmitInit();
 	
 	if(myDistantDevice == nullptr) {
+		//the round takes as many devices as a RANGE can carry, the next
+		//round goes on where this one stops
+		if(_rangingFirst >= _networkDevicesNumber) {
+			_rangingFirst = 0;
+		}
+		_rangingCount = _networkDevicesNumber < MAX_RANGING_DEVICES ? _networkDevicesNumber : MAX_RANGING_DEVICES;
 		//we need to set our timerDelay:
-		_timerDelay = DEFAULT_TIMER_DELAY+(uint16_t)(_networkDevicesNumber*3*DEFAULT_REPLY_DELAY_TIME/1000);
-		
+		_timerDelay = DEFAULT_TIMER_DELAY+(uint16_t)(_rangingCount*3*DEFAULT_REPLY_DELAY_TIME/1000);
+
 		byte shortBroadcast[2] = {0xFF, 0xFF};
 		_globalMac.generateShortMACFrame(data, _currentShortAddress, shortBroadcast);
 		data[SHORT_MAC_LEN]   = POLL;
 		//we enter the number of devices
-		data[SHORT_MAC_LEN+1] = _networkDevicesNumber;
-		
-		for(uint8_t i = 0; i < _networkDevicesNumber; i++) {
+		data[SHORT_MAC_LEN+1] = _rangingCount;
+
+		for(uint8_t i = 0; i < _rangingCount; i++) {
+			DW1000Device* device = rangingDevice(i);
 			//each devices have a different reply delay time.
-			_networkDevices[i].setReplyTime((2*i+1)*DEFAULT_REPLY_DELAY_TIME);
+			device->setReplyTime((2*i+1)*DEFAULT_REPLY_DELAY_TIME);
 			//we write the short address of our device:
-			memcpy(data+SHORT_MAC_LEN+2+4*i, _networkDevices[i].getByteShortAddress(), 2);
-			
+			memcpy(data+SHORT_MAC_LEN+2+4*i, device->getByteShortAddress(), 2);
+
 			//we add the replyTime
-			uint16_t replyTime = _networkDevices[i].getReplyTime();
+			uint16_t replyTime = device->getReplyTime();
 			memcpy(data+SHORT_MAC_LEN+2+2+4*i, &replyTime, 2);
 			
 		}
@@ -854,30 +860,37 @@ void DW1000RangingClass::transmitRange(DW1000Device* myDistantDevice) {
 	
 	
 	if(myDistantDevice == nullptr) {
+		//the devices of the POLL round (fewer if some went inactive since)
+		if(_rangingCount > _networkDevicesNumber) {
+			_rangingCount = _networkDevicesNumber;
+		}
 		//we need to set our timerDelay:
-		_timerDelay = DEFAULT_TIMER_DELAY+(uint16_t)(_networkDevicesNumber*3*DEFAULT_REPLY_DELAY_TIME/1000);
-		
+		_timerDelay = DEFAULT_TIMER_DELAY+(uint16_t)(_rangingCount*3*DEFAULT_REPLY_DELAY_TIME/1000);
+
 		byte shortBroadcast[2] = {0xFF, 0xFF};
 		_globalMac.generateShortMACFrame(data, _currentShortAddress, shortBroadcast);
 		data[SHORT_MAC_LEN]   = RANGE;
 		//we enter the number of devices
-		data[SHORT_MAC_LEN+1] = _networkDevicesNumber;
-		
+		data[SHORT_MAC_LEN+1] = _rangingCount;
+
 		// delay sending the message and remember expected future sent timestamp
 		DW1000Time deltaTime     = DW1000Time(DEFAULT_REPLY_DELAY_TIME, DW1000Time::MICROSECONDS);
-		DW1000Time timeRangeSent = DW1000.setDelay(deltaTime);
-		
-		for(uint8_t i = 0; i < _networkDevicesNumber; i++) {
+		DW1000.setDelay(deltaTime).getTimestamp(_timeRangeSent);
+
+		for(uint8_t i = 0; i < _rangingCount; i++) {
+			DW1000Device* device = rangingDevice(i);
 			//we write the short address of our device:
-			memcpy(data+SHORT_MAC_LEN+2+17*i, _networkDevices[i].getByteShortAddress(), 2);
-			
-			
+			memcpy(data+SHORT_MAC_LEN+2+17*i, device->getByteShortAddress(), 2);
+
+
 			//we get the device which correspond to the message which was sent (need to be filtered by MAC address)
-			_networkDevices[i].timeRangeSent = timeRangeSent;
-			_networkDevices[i].timePollSent.getTimestamp(data+SHORT_MAC_LEN+4+17*i);
-			_networkDevices[i].timePollAckReceived.getTimestamp(data+SHORT_MAC_LEN+9+17*i);
-			_networkDevices[i].timeRangeSent.getTimestamp(data+SHORT_MAC_LEN+14+17*i);
-			
+			memcpy(data+SHORT_MAC_LEN+4+17*i, _timePollSent, DW1000Time::LENGTH_TIMESTAMP);
+			memcpy(data+SHORT_MAC_LEN+9+17*i, device->asTag.timePollAckReceived, DW1000Time::LENGTH_TIMESTAMP);
+			memcpy(data+SHORT_MAC_LEN+14+17*i, _timeRangeSent, DW1000Time::LENGTH_TIMESTAMP);
+
+		}
+		if(_networkDevicesNumber > 0) {
+			_rangingFirst = (_rangingFirst+_rangingCount) % _networkDevicesNumber;
 		}
 		
 		copyShortAddress(_lastSentToShortAddress, shortBroadcast);
@@ -889,10 +902,10 @@ void DW1000RangingClass::transmitRange(DW1000Device* myDistantDevice) {
 		// delay sending the message and remember expected future sent timestamp
 		DW1000Time deltaTime = DW1000Time(_replyDelayTimeUS, DW1000Time::MICROSECONDS);
 		//we get the device which correspond to the message which was sent (need to be filtered by MAC address)
-		myDistantDevice->timeRangeSent = DW1000.setDelay(deltaTime);
-		myDistantDevice->timePollSent.getTimestamp(data+1+SHORT_MAC_LEN);
-		myDistantDevice->timePollAckReceived.getTimestamp(data+6+SHORT_MAC_LEN);
-		myDistantDevice->timeRangeSent.getTimestamp(data+11+SHORT_MAC_LEN);
+		DW1000.setDelay(deltaTime).getTimestamp(_timeRangeSent);
+		memcpy(data+1+SHORT_MAC_LEN, _timePollSent, DW1000Time::LENGTH_TIMESTAMP);
+		memcpy(data+6+SHORT_MAC_LEN, myDistantDevice->asTag.timePollAckReceived, DW1000Time::LENGTH_TIMESTAMP);
+		memcpy(data+11+SHORT_MAC_LEN, _timeRangeSent, DW1000Time::LENGTH_TIMESTAMP);
 		copyShortAddress(_lastSentToShortAddress, myDistantDevice->getByteShortAddress());
 	}
 	
@@ -938,29 +951,36 @@ void DW1000RangingClass::receiver() {
  * ######################################################################### */
 
 
-void DW1000RangingClass::computeRangeAsymmetric(DW1000Device* myDistantDevice, DW1000Time* myTOF) {
+void DW1000RangingClass::computeRangeAsymmetric(DW1000Device* myDistantDevice, byte rangeTimes[], DW1000Time& timeRangeReceived, DW1000Time* myTOF) {
+	// the tag's side of the exchange as it came in the RANGE, ours from the device
+	DW1000Time timePollSent(rangeTimes);
+	DW1000Time timePollAckReceived(rangeTimes+DW1000Time::LENGTH_TIMESTAMP);
+	DW1000Time timeRangeSent(rangeTimes+2*DW1000Time::LENGTH_TIMESTAMP);
+	DW1000Time timePollReceived(myDistantDevice->asAnchor.timePollReceived);
+	DW1000Time timePollAckSent(myDistantDevice->asAnchor.timePollAckSent);
+
 	// asymmetric two-way ranging (more computation intense, less error prone)
-	DW1000Time round1 = (myDistantDevice->timePollAckReceived-myDistantDevice->timePollSent).wrap();
-	DW1000Time reply1 = (myDistantDevice->timePollAckSent-myDistantDevice->timePollReceived).wrap();
-	DW1000Time round2 = (myDistantDevice->timeRangeReceived-myDistantDevice->timePollAckSent).wrap();
-	DW1000Time reply2 = (myDistantDevice->timeRangeSent-myDistantDevice->timePollAckReceived).wrap();
+	DW1000Time round1 = (timePollAckReceived-timePollSent).wrap();
+	DW1000Time reply1 = (timePollAckSent-timePollReceived).wrap();
+	DW1000Time round2 = (timeRangeReceived-timePollAckSent).wrap();
+	DW1000Time reply2 = (timeRangeSent-timePollAckReceived).wrap();
 	
 	myTOF->setTimestamp((round1*round2-reply1*reply2)/(round1+round2+reply1+reply2));
 	/*
-	Serial.print("timePollAckReceived ");myDistantDevice->timePollAckReceived.print();
-	Serial.print("timePollSent ");myDistantDevice->timePollSent.print();
+	Serial.print("timePollAckReceived ");timePollAckReceived.print();
+	Serial.print("timePollSent ");timePollSent.print();
 	Serial.print("round1 "); Serial.println((long)round1.getTimestamp());
 	
-	Serial.print("timePollAckSent ");myDistantDevice->timePollAckSent.print();
-	Serial.print("timePollReceived ");myDistantDevice->timePollReceived.print();
+	Serial.print("timePollAckSent ");timePollAckSent.print();
+	Serial.print("timePollReceived ");timePollReceived.print();
 	Serial.print("reply1 "); Serial.println((long)reply1.getTimestamp());
 	
-	Serial.print("timeRangeReceived ");myDistantDevice->timeRangeReceived.print();
-	Serial.print("timePollAckSent ");myDistantDevice->timePollAckSent.print();
+	Serial.print("timeRangeReceived ");timeRangeReceived.print();
+	Serial.print("timePollAckSent ");timePollAckSent.print();
 	Serial.print("round2 "); Serial.println((long)round2.getTimestamp());
 	
-	Serial.print("timeRangeSent ");myDistantDevice->timeRangeSent.print();
-	Serial.print("timePollAckReceived ");myDistantDevice->timePollAckReceived.print();
+	Serial.print("timeRangeSent ");timeRangeSent.print();
+	Serial.print("timePollAckReceived ");timePollAckReceived.print();
 	Serial.print("reply2 "); Serial.println((long)reply2.getTimestamp());
 	 */
 }
@@ -45,8 +45,13 @@
 
 #define LEN_DATA 90
 
-//Max devices we put in the networkDevices array ! Each DW1000Device is 74 Bytes in SRAM memory for now.
-#define MAX_DEVICES 4
+//Max devices we put in the networkDevices array ! Each DW1000Device is 35 Bytes in SRAM memory.
+#define MAX_DEVICES 12
+//Short address -> table position hash, a power of two of at least 2*MAX_DEVICES (1 Byte per slot).
+#define DEVICE_INDEX_SIZE 32
+//Devices a broadcast POLL/RANGE round can carry: the RANGE takes 17 Bytes per device.
+//With more devices the tag polls them in turns.
+#define MAX_RANGING_DEVICES ((LEN_DATA-SHORT_MAC_LEN-2)/17)
 
 //Default Pin for module:
 #define DEFAULT_RST_PIN 9
@@ -127,6 +132,13 @@ private:
 	//other devices in the network
 	static DW1000Device _networkDevices[MAX_DEVICES];
 	static volatile uint8_t _networkDevicesNumber;
+	static uint8_t      _deviceIndex[DEVICE_INDEX_SIZE]; // table position + 1, 0: free
+	// devices of the broadcast round in flight: _rangingCount from _rangingFirst on
+	static uint8_t      _rangingFirst;
+	static uint8_t      _rangingCount;
+	// our POLL and RANGE TX times, shared by every device of the round
+	static byte         _timePollSent[DW1000Time::LENGTH_TIMESTAMP];
+	static byte         _timeRangeSent[DW1000Time::LENGTH_TIMESTAMP];
 	static int16_t      _lastDistantDevice;
 	static byte         _currentAddress[8];
 	static byte         _currentShortAddress[2];
@@ -186,6 +198,13 @@ private:
 	static void checkForInactiveDevices();
 	static void copyShortAddress(byte address1[], byte address2[]);
 	
+	//short address index of the network devices
+	static uint8_t hashShortAddress(const byte shortAddress[]);
+	static int8_t  findNetworkDevice(const byte shortAddress[]);
+	static void    indexNetworkDevice(uint8_t index);
+	static void    clearNetworkDevices();
+	static DW1000Device* rangingDevice(uint8_t i);
+	
 	//for ranging protocole (ANCHOR)
 	static void transmitInit();
 	static void transmit(byte datas[]);
@@ -202,7 +221,7 @@ private:
 	static void transmitRange(DW1000Device* myDistantDevice);
 	
 	//methods for range computation
-	static void computeRangeAsymmetric(DW1000Device* myDistantDevice, DW1000Time* myTOF);
+	static void computeRangeAsymmetric(DW1000Device* myDistantDevice, byte rangeTimes[], DW1000Time& timeRangeReceived, DW1000Time* myTOF);
 	
 	static void timerTick();
 	
@@ -0,0 +1,246 @@
+/*
+ * Weighted least-squares multilateration
+ *
+ * Everything is solved relative to the most trusted anchor, so the squared
+ * terms of the linear step stay small enough for a float wherever the
+ * anchors are.
+ */
+
+#include "Multilateration.hpp"
+
+namespace Multilateration {
+
+    namespace {
+        /* pivots below this fraction of the largest diagonal term are taken as 0 */
+        constexpr float SINGULAR_RATIO = 1e-5f;
+
+        /* Solves the dims x dims system in the augmented matrix m by Gaussian
+           elimination with partial pivoting. m is destroyed. */
+        boolean _solveNormal(float m[3][4], uint8_t dims, float x[3]) {
+            float scale = 0;
+            for (uint8_t i = 0; i < dims; i++) {
+                if (m[i][i] > scale) scale = m[i][i];
+            }
+            if (scale <= 0) return false;
+
+            for (uint8_t col = 0; col < dims; col++) {
+                uint8_t pivot = col;
+                for (uint8_t row = col + 1; row < dims; row++) {
+                    if (fabs(m[row][col]) > fabs(m[pivot][col])) pivot = row;
+                }
+                if (fabs(m[pivot][col]) < scale * SINGULAR_RATIO) return false;
+                if (pivot != col) {
+                    for (uint8_t k = col; k <= dims; k++) {
+                        float t = m[col][k];
+                        m[col][k] = m[pivot][k];
+                        m[pivot][k] = t;
+                    }
+                }
+                for (uint8_t row = col + 1; row < dims; row++) {
+                    float f = m[row][col] / m[col][col];
+                    for (uint8_t k = col; k <= dims; k++) {
+                        m[row][k] -= f * m[col][k];
+                    }
+                }
+            }
+            for (int8_t row = dims - 1; row >= 0; row--) {
+                float sum = m[row][dims];
+                for (uint8_t k = row + 1; k < dims; k++) {
+                    sum -= m[row][k] * x[k];
+                }
+                x[row] = sum / m[row][row];
+            }
+            return true;
+        }
+
+        /* Adds the row a[] with right-hand side b and weight w to the normal equations */
+        void _accumulate(float m[3][4], uint8_t dims, const float a[3], float b, float w) {
+            for (uint8_t i = 0; i < dims; i++) {
+                for (uint8_t k = 0; k < dims; k++) {
+                    m[i][k] += w * a[i] * a[k];
+                }
+                m[i][dims] += w * a[i] * b;
+            }
+        }
+
+        /* Index of the range with the smallest variance, the first one on ties */
+        uint8_t _reference(const float variance[], uint8_t n) {
+            uint8_t best = 0;
+            for (uint8_t i = 1; i < n; i++) {
+                if (variance[i] < variance[best]) best = i;
+            }
+            return best;
+        }
+
+        /* Linear step in the frame of ranges[ref]; dims 2 solves x, y on the plane z = zHint */
+        boolean _linear(const AnchorRange ranges[], const float variance[], uint8_t n, uint8_t ref,
+                        uint8_t dims, float zHint, float p[3]) {
+            const AnchorRange& r = ranges[ref];
+            float dzRef = zHint - r.z;
+            float rangeRef2 = r.range * r.range;
+            if (dims == 2) {
+                rangeRef2 -= dzRef * dzRef;
+                if (rangeRef2 < 0) rangeRef2 = 0;
+            }
+
+            float m[3][4] = {{0}};
+            for (uint8_t i = 0; i < n; i++) {
+                if (i == ref) continue;
+                float a[3] = {ranges[i].x - r.x, ranges[i].y - r.y, ranges[i].z - r.z};
+                float range2 = ranges[i].range * ranges[i].range;
+                float b;
+                if (dims == 2) {
+                    float dz = zHint - ranges[i].z;
+                    range2 -= dz * dz;
+                    if (range2 < 0) range2 = 0;
+                    b = a[0] * a[0] + a[1] * a[1] + rangeRef2 - range2;
+                } else {
+                    b = a[0] * a[0] + a[1] * a[1] + a[2] * a[2] + rangeRef2 - range2;
+                }
+                // 2 a.p = b; the error of b is 2 r dr from each of the two ranges
+                a[0] *= 2;
+                a[1] *= 2;
+                a[2] *= 2;
+                float w = 1.0f / (range2 * variance[i] + rangeRef2 * variance[ref] + 1e-6f);
+                _accumulate(m, dims, a, b, w);
+            }
+            if (!_solveNormal(m, dims, p)) return false;
+            if (dims == 2) p[2] = dzRef;
+            return true;
+        }
+
+        /* Range residual of ranges[i] at p; a[] gets the unit vector from the
+           anchor to p, 0 on top of the anchor where there is no direction */
+        float _residual(const AnchorRange ranges[], uint8_t i, uint8_t ref, const float p[3], float a[3]) {
+            const AnchorRange& r = ranges[ref];
+            a[0] = p[0] - (ranges[i].x - r.x);
+            a[1] = p[1] - (ranges[i].y - r.y);
+            a[2] = p[2] - (ranges[i].z - r.z);
+            float d = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+            float scale = d < STEP_DONE_M ? 0 : 1.0f / d;
+            a[0] *= scale;
+            a[1] *= scale;
+            a[2] *= scale;
+            return ranges[i].range - d;
+        }
+
+        /* Huber cost at p: squared residuals in sigmas up to OUTLIER_SIGMAS,
+           linear beyond, so one NLOS range cannot outweigh the rest */
+        float _cost(const AnchorRange ranges[], const float variance[], uint8_t n, uint8_t ref, const float p[3]) {
+            float sum = 0;
+            float a[3];
+            for (uint8_t i = 0; i < n; i++) {
+                float u = fabs(_residual(ranges, i, ref, p, a)) / sqrt(variance[i]);
+                sum += u <= OUTLIER_SIGMAS ? u * u : OUTLIER_SIGMAS * (2 * u - OUTLIER_SIGMAS);
+            }
+            return sum;
+        }
+
+        /* Shared by solveLinear() and solve(): variances, reference and linear step */
+        boolean _start(const AnchorRange ranges[], uint8_t& n, uint8_t dims, float zHint,
+                       float variance[], uint8_t& ref, float p[3]) {
+            if (dims != 2 && dims != 3) return false;
+            if (n > MAX_ANCHORS) n = MAX_ANCHORS;
+            if (n < dims + 1) return false;
+
+            for (uint8_t i = 0; i < n; i++) {
+                variance[i] = getRangeVariance(ranges[i].rxPower);
+            }
+            ref = _reference(variance, n);
+
+            if (_linear(ranges, variance, n, ref, dims, zHint, p)) return true;
+            // 3D with the anchors on one plane: x, y from the plane at zHint
+            return dims == 3 && _linear(ranges, variance, n, ref, 2, zHint, p);
+        }
+
+        /* Gauss-Newton from p with Huber weights (IRLS). A step that does not
+           lower the cost is halved, so p never fits worse than it came in.
+           Returns the steps taken. */
+        uint8_t _refine(const AnchorRange ranges[], const float variance[], uint8_t n, uint8_t dims,
+                        uint8_t ref, float p[3]) {
+            float cost = _cost(ranges, variance, n, ref, p);
+            uint8_t iterations = 0;
+            while (iterations < MAX_ITERATIONS) {
+                float m[3][4] = {{0}};
+                for (uint8_t i = 0; i < n; i++) {
+                    float a[3];
+                    float e = _residual(ranges, i, ref, p, a);
+                    float u = fabs(e) / sqrt(variance[i]);
+                    float w = u <= OUTLIER_SIGMAS ? 1.0f : OUTLIER_SIGMAS / u;
+                    _accumulate(m, dims, a, e, w / variance[i]);
+                }
+                float step[3] = {0, 0, 0};
+                if (!_solveNormal(m, dims, step)) break;
+
+                float next[3];
+                float nextCost = cost;
+                for (uint8_t halvings = 0; halvings < MAX_HALVINGS && !(nextCost < cost); halvings++) {
+                    next[0] = p[0] + step[0];
+                    next[1] = p[1] + step[1];
+                    next[2] = p[2] + step[2];
+                    nextCost = _cost(ranges, variance, n, ref, next);
+                    step[0] /= 2;
+                    step[1] /= 2;
+                    step[2] /= 2;
+                }
+                if (!(nextCost < cost)) break;  // at the minimum, to float precision
+                iterations++;
+                float moved = sqrt((next[0] - p[0]) * (next[0] - p[0]) + (next[1] - p[1]) * (next[1] - p[1]) +
+                                   (next[2] - p[2]) * (next[2] - p[2]));
+                p[0] = next[0];
+                p[1] = next[1];
+                p[2] = next[2];
+                cost = nextCost;
+                if (moved < STEP_DONE_M) break;
+            }
+            return iterations;
+        }
+
+        void _store(const AnchorRange& origin, const float p[3], uint8_t n, Solution& solution) {
+            solution.x = p[0] + origin.x;
+            solution.y = p[1] + origin.y;
+            solution.z = p[2] + origin.z;
+            solution.rms = 0;
+            solution.anchors = n;
+            solution.iterations = 0;
+        }
+    }
+
+    float getRangeVariance(float rxPower) {
+        float variance = RANGE_SIGMA_M * RANGE_SIGMA_M;
+        if (rxPower == 0 || rxPower >= RANGE_SIGMA_POWER_DBM) {
+            return variance;
+        }
+        return variance * pow(10.0f, (RANGE_SIGMA_POWER_DBM - rxPower) / 10.0f);
+    }
+
+    boolean solveLinear(const AnchorRange ranges[], uint8_t n, uint8_t dims, float zHint, Solution& solution) {
+        float variance[MAX_ANCHORS];
+        float p[3];
+        uint8_t ref;
+        if (!_start(ranges, n, dims, zHint, variance, ref, p)) return false;
+        _store(ranges[ref], p, n, solution);
+        return true;
+    }
+
+    boolean solve(const AnchorRange ranges[], uint8_t n, uint8_t dims, float zHint, Solution& solution) {
+        float variance[MAX_ANCHORS];
+        float p[3];
+        uint8_t ref;
+        if (!_start(ranges, n, dims, zHint, variance, ref, p)) return false;
+        uint8_t iterations = _refine(ranges, variance, n, dims, ref, p);
+
+        float sum = 0, weights = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            float a[3];
+            float e = _residual(ranges, i, ref, p, a);
+            sum += e * e / variance[i];
+            weights += 1.0f / variance[i];
+        }
+        if (isnan(sum) || isinf(sum)) return false;
+        _store(ranges[ref], p, n, solution);
+        solution.rms = sqrt(sum / weights);
+        solution.iterations = iterations;
+        return true;
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Weighted least-squares multilateration
+ *
+ * Position of a tag from its ranges to any number of anchors at known
+ * positions. Float arithmetic and no allocation, so the same code runs on the
+ * Uno and on the host (see src/multilateration_benchmark_main.cpp).
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+namespace Multilateration {
+
+    /* ranges a solve takes at most, the rest are left out */
+    constexpr uint8_t MAX_ANCHORS = 16;
+
+    /* Gauss-Newton stops after this many steps or one shorter than STEP_DONE_M;
+       a step that fits worse is halved up to MAX_HALVINGS times */
+    constexpr uint8_t MAX_ITERATIONS = 10;
+    constexpr uint8_t MAX_HALVINGS = 4;
+    constexpr float STEP_DONE_M = 0.001f;
+
+    /* Residuals beyond this many sigmas weigh in linearly, not squared
+       (Huber): a long NLOS range pulls the position less */
+    constexpr float OUTLIER_SIGMAS = 1.5f;
+
+    /* Range noise model: the standard deviation at or above the reference
+       power, then its variance grows as the power drops (1 / SNR) */
+    constexpr float RANGE_SIGMA_M = 0.05f;
+    constexpr float RANGE_SIGMA_POWER_DBM = -80.0f;
+
+    /* one range to an anchor */
+    typedef struct AnchorRange {
+        float x, y, z;          // anchor position (m)
+        float range;            // measured range (m)
+        float rxPower;          // RX power of the ranging frame (dBm), 0 if unknown
+    } AnchorRange;
+
+    typedef struct Solution {
+        float x, y, z;          // position (m); z is the hint in 2D
+        float rms;              // weighted RMS of the range residuals (m)
+        uint8_t anchors;        // ranges used
+        uint8_t iterations;     // Gauss-Newton steps taken
+    } Solution;
+
+    /**
+    Variance of a range measured at an RX power, for the weights of solve()
+
+    @param [in] rxPower RX power in dBm, 0 (or anything at or above RANGE_SIGMA_POWER_DBM) for the floor
+
+    returns the variance in m^2
+    */
+    float getRangeVariance(float rxPower);
+
+    /**
+    Closed-form first guess: the range equations minus the one of the most
+    trusted anchor are linear in the position, solved by weighted least
+    squares. Each difference is weighted by the variance it inherits from
+    its two ranges.
+
+    In 2D the ranges are first projected onto the plane z = zHint. In 3D,
+    anchors all at about the same height leave z undetermined; the guess is
+    then the 2D one at zHint, on the side of the anchor plane the hint is on.
+
+    @param [in] ranges the ranges, at least dims + 1
+    @param [in] n number of ranges
+    @param [in] dims 2 (x, y at z = zHint) or 3 (x, y, z)
+    @param [in] zHint tag height in 2D, starting height in 3D (m)
+    @param [out] solution the position; rms and iterations are left 0
+
+    returns false if there are too few ranges or the anchors are collinear
+    */
+    boolean solveLinear(const AnchorRange ranges[], uint8_t n, uint8_t dims, float zHint, Solution& solution);
+
+    /**
+    Weighted least-squares position: solveLinear(), then Gauss-Newton on the
+    true range equations, each weighted by 1 / getRangeVariance(). Residuals
+    beyond OUTLIER_SIGMAS count linearly (Huber), and a step that fits worse
+    is halved, so the result never fits worse than the linear guess. Uses
+    every range given, up to MAX_ANCHORS.
+
+    @param [in] ranges the ranges, at least dims + 1
+    @param [in] n number of ranges
+    @param [in] dims 2 (x, y at z = zHint) or 3 (x, y, z)
+    @param [in] zHint tag height in 2D, starting height in 3D (m)
+    @param [out] solution the position and its fit
+
+    returns false if no position could be solved
+    */
+    boolean solve(const AnchorRange ranges[], uint8_t n, uint8_t dims, float zHint, Solution& solution);
+}
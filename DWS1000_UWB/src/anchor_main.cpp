@@ -4,6 +4,16 @@
  * Asymmetric Two-Way Ranging: receives POLL, sends POLL_ACK, receives RANGE,
  * computes distance, sends RANGE_REPORT.
  *
+ * Every TX arms the receiver in hardware (WAIT4RESP), so the anchor is
+ * listening again right after each reply without the loop stepping in.
+ *
+ * A tag that sets REPORT_IN_POLL_ACK in its POLL runs 3-message DS-TWR: no
+ * RANGE_REPORT, the range is staged in POLL_ACK and reaches the tag with the
+ * reply to its next POLL. Other tags get the 4-message exchange.
+ *
+ * A tag that sets SINGLE_SIDED runs 2-message SS-TWR: POLL_ACK goes out at a
+ * scheduled time and carries the reply time, the tag computes the range.
+ *
  * Uses config.h for antenna delay and pin assignments.
  * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
  */
@@ -14,6 +24,7 @@
 #include <DW1000NgUtils.hpp>
 #include <DW1000NgRanging.hpp>
 #include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
 #include "config.h"
 #include "display.h"
 
@@ -25,7 +36,6 @@
 #define RANGE_FAILED 255
 
 volatile byte expectedMsgId = POLL;
-volatile boolean sentAck = false;
 volatile boolean receivedAck = false;
 boolean protocolFailed = false;
 
@@ -41,14 +51,40 @@ uint64_t timeRangeReceived;
 #define LEN_DATA 16
 byte data[LEN_DATA];
 
+// Replies staged in TX_BUFFER once, RANGE_REPORT gets its range patched in
+const tx_template_t POLL_ACK_FRAME = {0, LEN_DATA};
+const tx_template_t RANGE_REPORT_FRAME = {LEN_DATA, LEN_DATA};
+const tx_template_t RANGE_FAILED_FRAME = {2 * LEN_DATA, LEN_DATA};
+#define RANGE_REPORT_OFFSET 1
+
+// 3-message mode: the POLL flags ask for it, POLL_ACK carries the previous
+// range followed by bytes 12-13 of its RANGE frame, so the tag can match them
+#define POLL_FLAGS_OFFSET 1
+#define REPORT_IN_POLL_ACK 0x01
+#define POLL_ACK_REPORT_OFFSET 1
+#define RANGE_STAMP_OFFSET 12
+#define LEN_RANGE_STAMP 2
+boolean reportInPollAck = false;
+
+// Single-sided mode: POLL_ACK carries the reply time (POLL RX to POLL_ACK TX
+// on this clock) and the anchor's address, the tag corrects for clock offset
+#define SINGLE_SIDED 0x02
+#define POLL_ACK_REPLY_OFFSET 7
+#define LEN_REPLY_TIME 4
+#define POLL_ACK_ADDRESS_OFFSET 11
+#define ANCHOR_ADDRESS 1
+
 // Timing
 uint32_t lastActivity;
 uint32_t resetPeriod = 500;
+uint16_t replyDelayTimeUS = 3000;  // until the reply delay tuning is done
 
 // Stats
 uint32_t rangeCount = 0;
 uint32_t failCount = 0;
 uint32_t resetCount = 0;
+uint32_t singleSidedCount = 0;
+uint32_t lateCount = 0;
 
 device_configuration_t DEFAULT_CONFIG = {
     false,                       // extendedFrameLength
@@ -65,14 +101,13 @@ device_configuration_t DEFAULT_CONFIG = {
 };
 
 interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
-    true,   // interruptOnSent
+    false,  // interruptOnSent
     true,   // interruptOnReceived
     true,   // interruptOnReceiveFailed
     false,  // interruptOnReceiveTimeout
     true    // interruptOnReceiveTimestampAvailable
 };
 
-void handleSent() { sentAck = true; }
 void handleReceived() { receivedAck = true; }
 void noteActivity() { lastActivity = millis(); }
 
@@ -81,22 +116,58 @@ void receiver() {
     DW1000Ng::startReceive();
 }
 
-void transmitPollAck() {
+void stageFrames() {
+    memset(data, 0, LEN_DATA);
     data[0] = POLL_ACK;
-    DW1000Ng::setTransmitData(data, LEN_DATA);
+    DW1000NgUtils::writeValueToBytes(data + POLL_ACK_ADDRESS_OFFSET, ANCHOR_ADDRESS, 2);
+    DW1000Ng::writeTransmitTemplate(POLL_ACK_FRAME, data);
+    data[POLL_ACK_ADDRESS_OFFSET] = 0;
+    data[0] = RANGE_REPORT;
+    DW1000Ng::writeTransmitTemplate(RANGE_REPORT_FRAME, data);
+    data[0] = RANGE_FAILED;
+    DW1000Ng::writeTransmitTemplate(RANGE_FAILED_FRAME, data);
+}
+
+void transmitPollAck() {
+    DW1000Ng::selectTransmitTemplate(POLL_ACK_FRAME);
     DW1000Ng::startTransmit();
 }
 
+// Single-sided: the reply time is known before sending, so it rides in the POLL_ACK
+void transmitTimedPollAck(uint64_t pollReceived) {
+    uint64_t pollAckSent = DW1000Ng::scheduleReplyAfterRx(pollReceived, DW1000Ng::REPLY_DELAY_AUTO);
+    byte reply[LEN_REPLY_TIME];
+    DW1000NgUtils::writeValueToBytes(reply, (pollAckSent - pollReceived) & TIME_MAX, LEN_REPLY_TIME);
+    DW1000Ng::patchTransmitTemplate(POLL_ACK_FRAME, POLL_ACK_REPLY_OFFSET, reply, LEN_REPLY_TIME);
+    DW1000Ng::selectTransmitTemplate(POLL_ACK_FRAME);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    if (DW1000Ng::isTransmitLate()) {
+        // missed the reply slot, the tag times out and polls again
+        lateCount++;
+        DW1000Ng::startReceive();
+        return;
+    }
+    singleSidedCount++;
+}
+
 void transmitRangeReport(float curRange) {
-    data[0] = RANGE_REPORT;
-    memcpy(data + 1, &curRange, 4);
-    DW1000Ng::setTransmitData(data, LEN_DATA);
+    byte range[sizeof(curRange)];
+    memcpy(range, &curRange, sizeof(curRange));
+    DW1000Ng::patchTransmitTemplate(RANGE_REPORT_FRAME, RANGE_REPORT_OFFSET, range, sizeof(range));
+    DW1000Ng::selectTransmitTemplate(RANGE_REPORT_FRAME);
     DW1000Ng::startTransmit();
 }
 
+// The range goes out with the next POLL_ACK, written while the radio only listens
+void stageRangeInPollAck(float curRange) {
+    byte report[sizeof(curRange) + LEN_RANGE_STAMP];
+    memcpy(report, &curRange, sizeof(curRange));
+    memcpy(report + sizeof(curRange), data + RANGE_STAMP_OFFSET, LEN_RANGE_STAMP);
+    DW1000Ng::patchTransmitTemplate(POLL_ACK_FRAME, POLL_ACK_REPORT_OFFSET, report, sizeof(report));
+}
+
 void transmitRangeFailed() {
-    data[0] = RANGE_FAILED;
-    DW1000Ng::setTransmitData(data, LEN_DATA);
+    DW1000Ng::selectTransmitTemplate(RANGE_FAILED_FRAME);
     DW1000Ng::startTransmit();
 }
 
@@ -118,10 +189,19 @@ void setup() {
     DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
     DW1000Ng::applyConfiguration(DEFAULT_CONFIG);
     DW1000Ng::applyInterruptConfiguration(DEFAULT_INTERRUPT_CONFIG);
+#if DW1000NG_RX_QUEUE
+    // the ISR queues each frame, so the chip can fill the other buffer meanwhile
+    DW1000Ng::setDoubleBuffering(true);
+#endif
 
-    DW1000Ng::setDeviceAddress(1);
+    DW1000Ng::setDeviceAddress(ANCHOR_ADDRESS);
     DW1000Ng::setNetworkId(10);
     DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+    // reply time of single-sided exchanges
+    DW1000Ng::setReplyDelay(replyDelayTimeUS);
+    DW1000Ng::startReplyDelayTuning();
+    stageFrames();
 
     char msg[128];
     DW1000Ng::getPrintableDeviceIdentifier(msg);
@@ -130,7 +210,6 @@ void setup() {
     Serial.print(F("Mode: ")); Serial.println(msg);
     Serial.print(F("Antenna delay: ")); Serial.println(ANTENNA_DELAY);
 
-    DW1000Ng::attachSentHandler(handleSent);
     DW1000Ng::attachReceivedHandler(handleReceived);
 
     Serial.println(F("Listening for POLL...\n"));
@@ -140,76 +219,114 @@ void setup() {
     noteActivity();
 }
 
-void loop() {
-    static uint32_t lastReport = 0;
+// Runs the TWR state machine on a received frame, payload already in data
+void handleFrame(const frame_snapshot_t& frame) {
+    byte msgId = data[0];
 
-    if (!sentAck && !receivedAck) {
-        if (millis() - lastActivity > resetPeriod) {
-            resetInactive();
-        }
-        return;
+    if (msgId != expectedMsgId) {
+        protocolFailed = true;
     }
 
-    if (sentAck) {
-        sentAck = false;
-        byte msgId = data[0];
-        if (msgId == POLL_ACK) {
-            timePollAckSent = DW1000Ng::getTransmitTimestamp();
+    if (msgId == POLL) {
+        protocolFailed = false;
+        timePollReceived = frame.timestamp;
+        if (data[POLL_FLAGS_OFFSET] & SINGLE_SIDED) {
+            // the exchange ends with the POLL_ACK
+            expectedMsgId = POLL;
+            transmitTimedPollAck(timePollReceived);
             noteActivity();
+            return;
         }
-        DW1000Ng::startReceive();
-    }
+        reportInPollAck = data[POLL_FLAGS_OFFSET] & REPORT_IN_POLL_ACK;
+        expectedMsgId = RANGE;
+        transmitPollAck();
+        noteActivity();
+
+    } else if (msgId == RANGE) {
+        timeRangeReceived = frame.timestamp;
+        expectedMsgId = POLL;
+        // 3-message mode sends nothing back: listen for the next POLL right away
+        // (with the receive queue, double buffered reception never stopped)
+#if !DW1000NG_RX_QUEUE
+        if (reportInPollAck) {
+            DW1000Ng::startReceive();
+        }
+#endif
 
-    if (receivedAck) {
-        receivedAck = false;
-        DW1000Ng::getReceivedData(data, LEN_DATA);
-        byte msgId = data[0];
+        if (!protocolFailed) {
+            // nothing has been sent since the POLL_ACK
+            timePollAckSent = DW1000Ng::getTransmitTimestamp();
+            timePollSent = DW1000NgUtils::bytesAsValue(data + 1, LENGTH_TIMESTAMP);
+            timePollAckReceived = DW1000NgUtils::bytesAsValue(data + 6, LENGTH_TIMESTAMP);
+            timeRangeSent = DW1000NgUtils::bytesAsValue(data + 11, LENGTH_TIMESTAMP);
+
+            double distance = DW1000NgRanging::computeRangeAsymmetric(
+                timePollSent, timePollReceived,
+                timePollAckSent, timePollAckReceived,
+                timeRangeSent, timeRangeReceived
+            );
+            int16_t rxPower = DW1000Ng::getReceivePowerQ8(frame);
+            distance = DW1000NgRanging::correctRange(distance, rxPower);
+            if (reportInPollAck) {
+                stageRangeInPollAck(distance * DISTANCE_OF_RADIO_INV);
+            } else {
+                // report first, the tag is waiting with a timeout
+                transmitRangeReport(distance * DISTANCE_OF_RADIO_INV);
+            }
 
-        if (msgId != expectedMsgId) {
-            protocolFailed = true;
+            rangeCount++;
+            Serial.print(F("R#"));
+            Serial.print(rangeCount);
+            Serial.print(F(" dist="));
+            Serial.print(distance, 2);
+            Serial.print(F(" m  pwr="));
+            Serial.print(rxPower / 256.0f, 1);
+            Serial.print(F(" dBm  fp="));
+            Serial.print(DW1000Ng::getFirstPathPower(frame), 1);
+            Serial.println(F(" dBm"));
+
+            displayDistance(distance, rangeCount);
+        } else {
+            failCount++;
+            if (!reportInPollAck) {
+                transmitRangeFailed();
+            }
         }
+        noteActivity();
+    }
+}
 
-        if (msgId == POLL) {
-            protocolFailed = false;
-            timePollReceived = DW1000Ng::getReceiveTimestamp();
-            expectedMsgId = RANGE;
-            transmitPollAck();
-            noteActivity();
+void loop() {
+    static uint32_t lastReport = 0;
 
-        } else if (msgId == RANGE) {
-            timeRangeReceived = DW1000Ng::getReceiveTimestamp();
-            expectedMsgId = POLL;
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
 
-            if (!protocolFailed) {
-                timePollSent = DW1000NgUtils::bytesAsValue(data + 1, LENGTH_TIMESTAMP);
-                timePollAckReceived = DW1000NgUtils::bytesAsValue(data + 6, LENGTH_TIMESTAMP);
-                timeRangeSent = DW1000NgUtils::bytesAsValue(data + 11, LENGTH_TIMESTAMP);
-
-                double distance = DW1000NgRanging::computeRangeAsymmetric(
-                    timePollSent, timePollReceived,
-                    timePollAckSent, timePollAckReceived,
-                    timeRangeSent, timeRangeReceived
-                );
-                distance = DW1000NgRanging::correctRange(distance);
-
-                rangeCount++;
-                Serial.print(F("R#"));
-                Serial.print(rangeCount);
-                Serial.print(F(" dist="));
-                Serial.print(distance, 2);
-                Serial.print(F(" m  pwr="));
-                Serial.print(DW1000Ng::getReceivePower(), 1);
-                Serial.println(F(" dBm"));
-
-                displayDistance(distance, rangeCount);
+    if (!receivedAck) {
+        if (millis() - lastActivity > resetPeriod) {
+            resetInactive();
+        }
+        return;
+    }
 
-                transmitRangeReport(distance * DISTANCE_OF_RADIO_INV);
-            } else {
-                failCount++;
-                transmitRangeFailed();
-            }
-            noteActivity();
+    if (receivedAck) {
+        receivedAck = false;
+#if DW1000NG_RX_QUEUE
+        // every frame the ISR queued since the last pass, oldest first
+        rx_frame_t queued;
+        while (DW1000Ng::popFrame(queued)) {
+            memcpy(data, queued.data, min(queued.length, (uint16_t)LEN_DATA));
+            handleFrame(queued.snapshot);
         }
+#else
+        // payload, timestamp and signal quality in one go
+        frame_snapshot_t frame = DW1000Ng::readFrameSnapshot(data, LEN_DATA);
+        handleFrame(frame);
+#endif
     }
 
     if (millis() - lastReport >= 10000) {
@@ -221,6 +338,15 @@ void loop() {
         Serial.print(F(" fail:"));
         Serial.print(failCount);
         Serial.print(F(" reset:"));
-        Serial.println(resetCount);
+        Serial.print(resetCount);
+        Serial.print(F(" ss:"));
+        Serial.print(singleSidedCount);
+        Serial.print(F(" late:"));
+        Serial.print(lateCount);
+#if DW1000NG_RX_QUEUE
+        Serial.print(F(" dropped:"));
+        Serial.print(DW1000Ng::getDroppedFrameCount());
+#endif
+        Serial.println();
     }
 }
@@ -44,8 +44,8 @@ const uint16_t NUM_SAMPLES = 200;
 #define RANGE_FAILED 255
 
 volatile byte expectedMsgId = POLL_ACK;
-volatile boolean sentAck = false;
 volatile boolean receivedAck = false;
+volatile boolean receiveTimedOut = false;
 
 // Timestamps
 uint64_t timePollSent;
@@ -82,21 +82,21 @@ device_configuration_t DEFAULT_CONFIG = {
 };
 
 interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
-    true,   // interruptOnSent
+    false,  // interruptOnSent
     true,   // interruptOnReceived
     true,   // interruptOnReceiveFailed
-    false,  // interruptOnReceiveTimeout
+    true,   // interruptOnReceiveTimeout
     true    // interruptOnReceiveTimestampAvailable
 };
 
-void handleSent() {
-    sentAck = true;
-}
-
 void handleReceived() {
     receivedAck = true;
 }
 
+void handleReceiveTimeout() {
+    receiveTimedOut = true;
+}
+
 void noteActivity() {
     lastActivity = millis();
 }
@@ -254,9 +254,12 @@ void setup() {
     DW1000Ng::setDeviceAddress(2);
     DW1000Ng::setNetworkId(10);
     DW1000Ng::setAntennaDelay(antennaDelay);
+    // receiver armed by the chip after every TX, see config.h
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+    DW1000Ng::setReceiveFrameWaitTimeoutPeriod(RESPONSE_TIMEOUT_US);
 
-    DW1000Ng::attachSentHandler(handleSent);
     DW1000Ng::attachReceivedHandler(handleReceived);
+    DW1000Ng::attachReceiveTimeoutHandler(handleReceiveTimeout);
 
     Serial.println(F("Collecting measurements...\n"));
 
@@ -265,16 +268,19 @@ void setup() {
 }
 
 void loop() {
-    if (!sentAck && !receivedAck) {
+    if (!receivedAck && !receiveTimedOut) {
         if (millis() - lastActivity > resetPeriod) {
             resetInactive();
         }
         return;
     }
 
-    if (sentAck) {
-        sentAck = false;
-        DW1000Ng::startReceive();
+    if (receiveTimedOut) {
+        receiveTimedOut = false;
+        timeoutCount++;
+        expectedMsgId = POLL_ACK;
+        transmitPoll();
+        noteActivity();
     }
 
     if (receivedAck) {
@@ -0,0 +1,184 @@
+/**
+ * ISR Benchmark — DW1000-ng (host only)
+ *
+ * Times DW1000Ng::interruptServiceRoutine() against the emulated DW1000 and
+ * counts the SPI transactions and bytes it issues for the three events a TWR
+ * node handles: RX done (with LDE done), TX done and RX timeout. A forked
+ * child process is the remote transmitter for the RX case.
+ *
+ * The host has no SPI bus, so the microseconds are CPU time only; the
+ * transaction and byte counts are what the ISR costs on the real bus.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgConstants.hpp>
+#include <DW1000Emulator.hpp>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "config.h"
+
+#define BENCH_EVENTS 200
+#define LEN_PAYLOAD 16
+#define EVENT_WAIT_MS 50
+#define PEER_FRAME_INTERVAL_MS 2
+#define RX_TIMEOUT_US 300
+
+device_configuration_t BENCH_CONFIG = {
+    false,                       // extendedFrameLength
+    false,                       // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+interrupt_configuration_t BENCH_INTERRUPT_CONFIG = {
+    true,   // interruptOnSent
+    true,   // interruptOnReceived
+    true,   // interruptOnReceiveFailed
+    true,   // interruptOnReceiveTimeout
+    true,   // interruptOnReceiveTimestampAvailable
+    false   // interruptOnAutomaticAcknowledgeTrigger
+};
+
+byte payload[LEN_PAYLOAD];
+pid_t peer = -1;
+
+struct IsrStats {
+    uint32_t calls;
+    uint32_t micros;
+    uint32_t maxMicros;
+    uint32_t transactions;
+    uint32_t bytes;
+};
+
+IsrStats stats;
+volatile boolean eventSeen = false;
+
+void handleEvent() { eventSeen = true; }
+
+// Wraps the driver ISR on the emulated IRQ line
+void timedIsr() {
+    uint32_t transactions = DW1000Emulator::transactionCount();
+    uint32_t bytes = DW1000Emulator::byteCount();
+    uint32_t start = micros();
+    DW1000Ng::interruptServiceRoutine();
+    uint32_t elapsed = micros() - start;
+    stats.calls++;
+    stats.micros += elapsed;
+    if (elapsed > stats.maxMicros) stats.maxMicros = elapsed;
+    stats.transactions += DW1000Emulator::transactionCount() - transactions;
+    stats.bytes += DW1000Emulator::byteCount() - bytes;
+}
+
+boolean waitForEvent() {
+    uint32_t start = millis();
+    while (!eventSeen && millis() - start < EVENT_WAIT_MS) {
+        yield();
+    }
+    boolean seen = eventSeen;
+    eventSeen = false;
+    return seen;
+}
+
+void printStats(const __FlashStringHelper *name, uint16_t events) {
+    Serial.print(name);
+    Serial.print(F("  events ")); Serial.print(events);
+    Serial.print(F("  isr ")); Serial.print(stats.calls);
+    if (stats.calls > 0) {
+        Serial.print(F("  us/isr ")); Serial.print((float)stats.micros / stats.calls, 1);
+        Serial.print(F("  max ")); Serial.print(stats.maxMicros);
+        Serial.print(F("  spi/isr ")); Serial.print((float)stats.transactions / stats.calls, 2);
+        Serial.print(F("  bytes/isr ")); Serial.print((float)stats.bytes / stats.calls, 1);
+    }
+    Serial.println();
+    memset(&stats, 0, sizeof(stats));
+}
+
+void setupRadio() {
+    DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
+    DW1000Ng::applyConfiguration(BENCH_CONFIG);
+    DW1000Ng::applyInterruptConfiguration(BENCH_INTERRUPT_CONFIG);
+    DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+}
+
+// Child process: a second emulated node sending a frame every few ms
+void runPeer() {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    setupRadio();
+    for (;;) {
+        DW1000Ng::setTransmitData(payload, LEN_PAYLOAD);
+        DW1000Ng::startTransmit();
+        delay(PEER_FRAME_INTERVAL_MS);
+    }
+}
+
+void stopPeer() {
+    if (peer > 0) {
+        kill(peer, SIGKILL);
+        waitpid(peer, nullptr, 0);
+        peer = -1;
+    }
+}
+
+void setup() {
+    Serial.begin(115200);
+    for (uint8_t i = 0; i < LEN_PAYLOAD; i++) {
+        payload[i] = i;
+    }
+
+    // fork before the first SPI access so each process gets its own emulated chip
+    peer = fork();
+    if (peer == 0) {
+        runPeer();
+    }
+
+    Serial.println(F("\n=== ISR Benchmark (DW1000-ng, host) ==="));
+    setupRadio();
+    attachInterrupt(digitalPinToInterrupt(PIN_IRQ), timedIsr, RISING);
+    DW1000Ng::attachSentHandler(handleEvent);
+    DW1000Ng::attachReceivedHandler(handleEvent);
+    DW1000Ng::attachReceiveFailedHandler(handleEvent);
+    DW1000Ng::attachReceiveTimeoutHandler(handleEvent);
+    delay(50);
+    memset(&stats, 0, sizeof(stats));
+
+    uint16_t events = 0;
+    for (uint16_t i = 0; i < BENCH_EVENTS; i++) {
+        DW1000Ng::startReceive();
+        if (waitForEvent()) events++;
+    }
+    printStats(F("rx done    "), events);
+    stopPeer();
+
+    DW1000Ng::forceTRxOff();
+    events = 0;
+    for (uint16_t i = 0; i < BENCH_EVENTS; i++) {
+        DW1000Ng::setTransmitData(payload, LEN_PAYLOAD);
+        DW1000Ng::startTransmit();
+        if (waitForEvent()) events++;
+    }
+    printStats(F("tx done    "), events);
+
+    DW1000Ng::setReceiveFrameWaitTimeoutPeriod(RX_TIMEOUT_US);
+    events = 0;
+    for (uint16_t i = 0; i < BENCH_EVENTS; i++) {
+        DW1000Ng::startReceive();
+        if (waitForEvent()) events++;
+    }
+    printStats(F("rx timeout "), events);
+
+    exit(0);
+}
+
+void loop() {
+}
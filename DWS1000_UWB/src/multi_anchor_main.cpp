@@ -0,0 +1,275 @@
+/**
+ * One-to-Many DS-TWR Anchor (Responder) — DW1000-ng
+ *
+ * Answers the broadcast POLL of multi_tag_main.cpp in its own response slot:
+ *   tag     POLL (broadcast: sequence, anchor count, first slot, slot width)
+ *   anchor  RESPONSE at POLL RX + first slot + ANCHOR_INDEX * slot width
+ *   tag     FINAL (broadcast: POLL TX, FINAL TX, RX time of every RESPONSE)
+ * The range computed from the FINAL goes back to the tag in the RESPONSE of
+ * the next exchange.
+ *
+ * ANCHOR_INDEX (0-15) is the slot, build each anchor with its own:
+ *   PLATFORMIO_BUILD_FLAGS="-D ANCHOR_INDEX=3" pio run -e uno_multi_anchor
+ *
+ * Uses config.h for antenna delay and pin assignments.
+ * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgUtils.hpp>
+#include <DW1000NgRanging.hpp>
+#include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
+#include "config.h"
+#include "display.h"
+
+#ifndef ANCHOR_INDEX
+#define ANCHOR_INDEX 0
+#endif
+
+// One-to-many message types
+#define MULTI_POLL 0x10
+#define MULTI_RESPONSE 0x11
+#define MULTI_FINAL 0x12
+#define MAX_ANCHORS 16
+
+// MULTI_POLL: type, sequence, anchor count, first slot (us), slot width (us)
+#define POLL_SEQUENCE_OFFSET 1
+#define POLL_COUNT_OFFSET 2
+#define POLL_FIRST_SLOT_OFFSET 3
+#define POLL_SLOT_OFFSET 5
+#define LEN_POLL 7
+// MULTI_RESPONSE: type, sequence, anchor index, previous range, its sequence
+#define RESPONSE_SEQUENCE_OFFSET 1
+#define RESPONSE_RANGE_OFFSET 3
+#define LEN_RESPONSE 8
+// MULTI_FINAL: type, sequence, anchor count, POLL TX, FINAL TX, then the
+// RESPONSE RX time of every slot (0: not heard)
+#define FINAL_POLL_SENT_OFFSET 3
+#define FINAL_FINAL_SENT_OFFSET 8
+#define FINAL_HEADER 13
+#define LEN_FINAL (FINAL_HEADER + MAX_ANCHORS * LENGTH_TIMESTAMP)
+
+volatile boolean receivedAck = false;
+
+// Exchange in progress
+boolean responded = false;
+byte sequence;
+uint64_t timePollReceived;
+uint64_t timeResponseSent;
+
+// Data buffer
+byte data[LEN_FINAL];
+
+// Staged once, sequence and range patched in
+const tx_template_t RESPONSE_FRAME = {0, LEN_RESPONSE};
+
+// Timing
+uint32_t lastActivity;
+uint32_t resetPeriod = 500;
+
+// Stats
+uint32_t rangeCount = 0;
+uint32_t missedCount = 0;
+uint32_t lateCount = 0;
+uint32_t resetCount = 0;
+
+device_configuration_t DEFAULT_CONFIG = {
+    false,                       // extendedFrameLength
+    true,                        // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
+    false,  // interruptOnSent
+    true,   // interruptOnReceived
+    true,   // interruptOnReceiveFailed
+    false,  // interruptOnReceiveTimeout
+    true    // interruptOnReceiveTimestampAvailable
+};
+
+void handleReceived() { receivedAck = true; }
+void noteActivity() { lastActivity = millis(); }
+
+void receiver() {
+    DW1000Ng::forceTRxOff();
+    DW1000Ng::startReceive();
+}
+
+void stageFrames() {
+    memset(data, 0, LEN_RESPONSE);
+    data[0] = MULTI_RESPONSE;
+    data[2] = ANCHOR_INDEX;
+    DW1000Ng::writeTransmitTemplate(RESPONSE_FRAME, data);
+}
+
+void resetInactive() {
+    resetCount++;
+    responded = false;
+    receiver();
+    noteActivity();
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    displayInit();
+
+    Serial.println(F("\n=== One-to-Many TWR Anchor (Responder) ==="));
+
+    DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
+    DW1000Ng::applyConfiguration(DEFAULT_CONFIG);
+    DW1000Ng::applyInterruptConfiguration(DEFAULT_INTERRUPT_CONFIG);
+
+    DW1000Ng::setDeviceAddress(1 + ANCHOR_INDEX);
+    DW1000Ng::setNetworkId(10);
+    DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+    // listening again right after the RESPONSE, for the FINAL
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+    stageFrames();
+
+    char msg[128];
+    DW1000Ng::getPrintableDeviceIdentifier(msg);
+    Serial.print(F("Device: ")); Serial.println(msg);
+    DW1000Ng::getPrintableDeviceMode(msg);
+    Serial.print(F("Mode: ")); Serial.println(msg);
+    Serial.print(F("Antenna delay: ")); Serial.println(ANTENNA_DELAY);
+    Serial.print(F("Slot: ")); Serial.println(ANCHOR_INDEX);
+
+    DW1000Ng::attachReceivedHandler(handleReceived);
+
+    Serial.println(F("Listening for POLL...\n"));
+    displayStatus("MULTI ANCHOR", "Listening...");
+
+    receiver();
+    noteActivity();
+}
+
+void transmitResponse(const frame_snapshot_t& frame) {
+    uint8_t anchorCount = data[POLL_COUNT_OFFSET];
+    if (ANCHOR_INDEX >= anchorCount) {
+        DW1000Ng::startReceive();
+        return;
+    }
+    uint32_t firstSlotUs = DW1000NgUtils::bytesAsValue(data + POLL_FIRST_SLOT_OFFSET, 2);
+    uint32_t slotUs = DW1000NgUtils::bytesAsValue(data + POLL_SLOT_OFFSET, 2);
+
+    sequence = data[POLL_SEQUENCE_OFFSET];
+    timePollReceived = frame.timestamp;
+    timeResponseSent = DW1000Ng::scheduleReplyAfterRx(timePollReceived, firstSlotUs + ANCHOR_INDEX * slotUs);
+    DW1000Ng::patchTransmitTemplate(RESPONSE_FRAME, RESPONSE_SEQUENCE_OFFSET, &sequence, 1);
+    DW1000Ng::selectTransmitTemplate(RESPONSE_FRAME);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    responded = !DW1000Ng::isTransmitLate();
+    if (!responded) {
+        // missed the slot, sit this exchange out
+        lateCount++;
+        DW1000Ng::startReceive();
+    }
+}
+
+void computeRange(const frame_snapshot_t& frame) {
+    uint8_t anchorCount = data[POLL_COUNT_OFFSET];
+    uint16_t responseOffset = FINAL_HEADER + ANCHOR_INDEX * LENGTH_TIMESTAMP;
+    uint64_t timeResponseReceived = 0;
+    if (ANCHOR_INDEX < anchorCount && frame.length >= responseOffset + LENGTH_TIMESTAMP) {
+        timeResponseReceived = DW1000NgUtils::bytesAsValue(data + responseOffset, LENGTH_TIMESTAMP);
+    }
+    if (timeResponseReceived == 0) {
+        // the tag did not hear our RESPONSE
+        missedCount++;
+        return;
+    }
+
+    double distance = DW1000NgRanging::computeRangeAsymmetric(
+        DW1000NgUtils::bytesAsValue(data + FINAL_POLL_SENT_OFFSET, LENGTH_TIMESTAMP),
+        timePollReceived,
+        timeResponseSent,
+        timeResponseReceived,
+        DW1000NgUtils::bytesAsValue(data + FINAL_FINAL_SENT_OFFSET, LENGTH_TIMESTAMP),
+        frame.timestamp
+    );
+    int16_t rxPower = DW1000Ng::getReceivePowerQ8(frame);
+    distance = DW1000NgRanging::correctRange(distance, rxPower);
+
+    // handed to the tag with the next RESPONSE
+    byte report[sizeof(float) + 1];
+    float curRange = distance * DISTANCE_OF_RADIO_INV;
+    memcpy(report, &curRange, sizeof(curRange));
+    report[sizeof(curRange)] = sequence;
+    DW1000Ng::patchTransmitTemplate(RESPONSE_FRAME, RESPONSE_RANGE_OFFSET, report, sizeof(report));
+
+    rangeCount++;
+    Serial.print(F("R#"));
+    Serial.print(rangeCount);
+    Serial.print(F(" dist="));
+    Serial.print(distance, 2);
+    Serial.print(F(" m  pwr="));
+    Serial.print(rxPower / 256.0f, 1);
+    Serial.println(F(" dBm"));
+
+    displayDistance(distance, rangeCount);
+}
+
+void loop() {
+    static uint32_t lastReport = 0;
+
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
+
+    if (!receivedAck) {
+        if (millis() - lastActivity > resetPeriod) {
+            resetInactive();
+        }
+        return;
+    }
+
+    receivedAck = false;
+    frame_snapshot_t frame = DW1000Ng::readFrameSnapshot(data, LEN_FINAL);
+    byte msgId = data[0];
+
+    if (msgId == MULTI_POLL && frame.length >= LEN_POLL) {
+        transmitResponse(frame);
+        noteActivity();
+    } else if (msgId == MULTI_FINAL && frame.length >= FINAL_HEADER) {
+        // back to listening first, the next POLL follows shortly
+        DW1000Ng::startReceive();
+        if (responded && data[POLL_SEQUENCE_OFFSET] == sequence) {
+            computeRange(frame);
+        }
+        responded = false;
+        noteActivity();
+    } else {
+        // RESPONSE of another anchor
+        DW1000Ng::startReceive();
+    }
+
+    if (millis() - lastReport >= 10000) {
+        lastReport = millis();
+        Serial.print(F("["));
+        Serial.print(millis() / 1000);
+        Serial.print(F("s] ranges:"));
+        Serial.print(rangeCount);
+        Serial.print(F(" missed:"));
+        Serial.print(missedCount);
+        Serial.print(F(" late:"));
+        Serial.print(lateCount);
+        Serial.print(F(" reset:"));
+        Serial.println(resetCount);
+    }
+}
@@ -0,0 +1,353 @@
+/**
+ * One-to-Many DS-TWR Tag (Initiator) — DW1000-ng
+ *
+ * Ranges against up to 16 anchors (multi_anchor_main.cpp) with 2 + N frames:
+ *   tag     POLL (broadcast: sequence, anchor count, first slot, slot width)
+ *   anchor  RESPONSE in slot ANCHOR_INDEX, timed from its POLL RX timestamp
+ *   tag     FINAL (broadcast: POLL TX, FINAL TX, RX time of every RESPONSE)
+ * Each anchor computes its range from the FINAL and returns it in its
+ * RESPONSE of the next exchange.
+ *
+ * The slot width is the RESPONSE air time from DW1000Ng::getFrameDuration()
+ * plus MULTI_SLOT_GUARD_US (config.h), so it follows the radio configuration.
+ * The receiver stays on through all slots (double buffering) and the ISR
+ * queues every RESPONSE (DW1000NG_RX_QUEUE).
+ *
+ * Uses config.h for antenna delay and pin assignments.
+ * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgUtils.hpp>
+#include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
+#include "config.h"
+#include "display.h"
+
+#if !DW1000NG_RX_QUEUE
+#error "multi_tag_main.cpp needs DW1000NG_RX_QUEUE, one RESPONSE per slot arrives back to back"
+#endif
+
+// One-to-many message types, see multi_anchor_main.cpp for the layouts
+#define MULTI_POLL 0x10
+#define MULTI_RESPONSE 0x11
+#define MULTI_FINAL 0x12
+#define MAX_ANCHORS 16
+
+#define POLL_SEQUENCE_OFFSET 1
+#define LEN_POLL 7
+#define RESPONSE_SEQUENCE_OFFSET 1
+#define RESPONSE_INDEX_OFFSET 2
+#define RESPONSE_RANGE_OFFSET 3
+#define RESPONSE_RANGE_SEQUENCE_OFFSET 7
+#define LEN_RESPONSE 8
+#define FINAL_HEADER 13
+#define LEN_FINAL (FINAL_HEADER + MAX_ANCHORS * LENGTH_TIMESTAMP)
+
+#if MULTI_ANCHOR_COUNT > MAX_ANCHORS
+#error "MULTI_ANCHOR_COUNT is at most 16"
+#endif
+
+volatile boolean sentAck = false;
+
+// Exchange in progress
+byte sequence = 0;
+boolean collecting = false;         // POLL out, RESPONSE slots running
+boolean finalInFlight = false;      // the next POLL waits for it to be sent
+uint32_t pollStartedAt;
+uint64_t timeResponseReceived[MAX_ANCHORS];  // 0: not heard
+uint8_t responseCount;
+
+// Ranges of the previous exchange, carried by this exchange's RESPONSEs
+byte finalSequence;
+boolean finalDue = false;           // its ranges are still to come
+float ranges[MAX_ANCHORS];
+boolean rangeValid[MAX_ANCHORS];
+
+// Slots, from the radio configuration
+const uint8_t anchorCount = MULTI_ANCHOR_COUNT;
+uint16_t slotUs;
+uint32_t windowUs;                  // POLL start -> end of the last slot
+uint32_t pollWindowUs;              // pollStartedAt -> end of the last slot
+uint32_t nextPollDelayUs;           // FINAL TX timestamp -> next POLL TX timestamp
+uint64_t timeFinalSent;
+
+// Data buffer
+byte data[LEN_FINAL];
+
+// Frames staged in TX_BUFFER once, FINAL is sent with its length per exchange
+const tx_template_t POLL_FRAME = {0, LEN_POLL};
+const tx_template_t FINAL_FRAME = {LEN_POLL, LEN_FINAL};
+
+// Timing
+uint32_t lastActivity;
+uint32_t resetPeriod = 500;
+
+// Stats
+uint32_t pollCount = 0;
+uint32_t exchangeCount = 0;
+uint32_t responseTotal = 0;
+uint32_t rangeCount = 0;
+uint32_t lateCount = 0;
+
+device_configuration_t DEFAULT_CONFIG = {
+    false,                       // extendedFrameLength
+    true,                        // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
+    true,   // interruptOnSent, the next POLL follows the FINAL
+    true,   // interruptOnReceived
+    true,   // interruptOnReceiveFailed
+    false,  // interruptOnReceiveTimeout
+    true    // interruptOnReceiveTimestampAvailable
+};
+
+void handleSent() { sentAck = true; }
+void noteActivity() { lastActivity = millis(); }
+
+void stageFrames() {
+    memset(data, 0, LEN_FINAL);
+    data[0] = MULTI_POLL;
+    data[2] = anchorCount;
+    DW1000NgUtils::writeValueToBytes(data + 3, MULTI_FIRST_SLOT_US, 2);
+    DW1000NgUtils::writeValueToBytes(data + 5, slotUs, 2);
+    DW1000Ng::writeTransmitTemplate(POLL_FRAME, data);
+    memset(data, 0, LEN_POLL);
+    data[0] = MULTI_FINAL;
+    data[2] = anchorCount;
+    DW1000Ng::writeTransmitTemplate(FINAL_FRAME, data);
+}
+
+// DELAYED: at the time scheduled with DW1000Ng::scheduleReplyAfterRx(), or at
+// once if that has passed
+void transmitPoll(TransmitMode mode = TransmitMode::IMMEDIATE) {
+    pollCount++;
+    sequence++;
+    finalInFlight = false;
+    responseCount = 0;
+    memset(timeResponseReceived, 0, sizeof(timeResponseReceived));
+    memset(rangeValid, 0, sizeof(rangeValid));
+    // leftovers of the last exchange belong to no one now
+    rx_frame_t stale;
+    while (DW1000Ng::popFrame(stale)) {}
+
+    DW1000Ng::patchTransmitTemplate(POLL_FRAME, POLL_SEQUENCE_OFFSET, &sequence, 1);
+    DW1000Ng::selectTransmitTemplate(POLL_FRAME);
+    DW1000Ng::startTransmit(mode);
+    pollStartedAt = micros();
+    pollWindowUs = windowUs;
+    if (mode == TransmitMode::DELAYED) {
+        if (DW1000Ng::isTransmitLate()) {
+            DW1000Ng::startTransmit();
+        } else {
+            // the FINAL just ended, the POLL starts once the guard is over
+            pollWindowUs += NEXT_POLL_GUARD_US;
+        }
+    }
+    collecting = true;
+}
+
+void handleResponse(const rx_frame_t& frame) {
+    if (frame.length < LEN_RESPONSE || frame.data[0] != MULTI_RESPONSE ||
+        frame.data[RESPONSE_SEQUENCE_OFFSET] != sequence) {
+        return;
+    }
+    uint8_t index = frame.data[RESPONSE_INDEX_OFFSET];
+    if (index >= anchorCount || timeResponseReceived[index] != 0) {
+        return;
+    }
+    timeResponseReceived[index] = frame.snapshot.timestamp;
+    responseCount++;
+    // the range of the previous exchange, if this anchor got its FINAL
+    if (finalDue && frame.data[RESPONSE_RANGE_SEQUENCE_OFFSET] == finalSequence) {
+        memcpy(&ranges[index], frame.data + RESPONSE_RANGE_OFFSET, sizeof(float));
+        rangeValid[index] = true;
+    }
+}
+
+void transmitFinal() {
+    // done listening, the slots are over
+    DW1000Ng::forceTRxOff();
+    responseTotal += responseCount;
+    if (responseCount == 0) {
+        finalDue = false;
+        transmitPoll();
+        return;
+    }
+
+    // one reply to every RESPONSE, timed from the POLL TX timestamp
+    uint64_t timePollSent = DW1000Ng::getTransmitTimestamp();
+    timeFinalSent = DW1000Ng::scheduleReplyAfterRx(timePollSent,
+        MULTI_FIRST_SLOT_US + (uint32_t)anchorCount * slotUs + MULTI_FINAL_GAP_US);
+
+    byte* timestamps = data + 3;
+    DW1000NgUtils::writeValueToBytes(timestamps, timePollSent, LENGTH_TIMESTAMP);
+    DW1000NgUtils::writeValueToBytes(timestamps + LENGTH_TIMESTAMP, timeFinalSent, LENGTH_TIMESTAMP);
+    for (uint8_t i = 0; i < anchorCount; i++) {
+        DW1000NgUtils::writeValueToBytes(data + FINAL_HEADER + i * LENGTH_TIMESTAMP,
+            timeResponseReceived[i], LENGTH_TIMESTAMP);
+    }
+    data[1] = sequence;
+    tx_template_t finalFrame = {FINAL_FRAME.bufferOffset, (uint16_t)(FINAL_HEADER + anchorCount * LENGTH_TIMESTAMP)};
+    DW1000Ng::patchTransmitTemplate(finalFrame, 1, data + 1, finalFrame.length - 1);
+    DW1000Ng::selectTransmitTemplate(finalFrame);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    if (DW1000Ng::isTransmitLate()) {
+        // missed the FINAL slot, start over
+        lateCount++;
+        finalDue = false;
+        transmitPoll();
+        return;
+    }
+    exchangeCount++;
+    finalInFlight = true;
+}
+
+// One line per exchange: the ranges its RESPONSEs brought back, '-' if none
+void reportRanges() {
+    Serial.print(F("X#"));
+    Serial.print(exchangeCount);
+    Serial.print(F(" "));
+    Serial.print(responseCount);
+    Serial.print(F("/"));
+    Serial.print(anchorCount);
+    for (uint8_t i = 0; i < anchorCount; i++) {
+        Serial.print(F(" "));
+        if (rangeValid[i]) {
+            rangeCount++;
+            Serial.print(ranges[i] * DISTANCE_OF_RADIO, 2);
+        } else {
+            Serial.print(F("-"));
+        }
+    }
+    Serial.println(F(" m"));
+}
+
+void resetInactive() {
+    finalDue = false;
+    DW1000Ng::forceTRxOff();
+    transmitPoll();
+    noteActivity();
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    displayInit();
+
+    Serial.println(F("\n=== One-to-Many TWR Tag (Initiator) ==="));
+
+    DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
+    DW1000Ng::applyConfiguration(DEFAULT_CONFIG);
+    DW1000Ng::applyInterruptConfiguration(DEFAULT_INTERRUPT_CONFIG);
+    // the ISR queues each RESPONSE while the chip fills the other buffer
+    DW1000Ng::setDoubleBuffering(true);
+
+    DW1000Ng::setDeviceAddress(100);
+    DW1000Ng::setNetworkId(10);
+    DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+    // the receiver comes on by itself after the POLL
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+
+    slotUs = DW1000Ng::getFrameDuration(LEN_RESPONSE) + MULTI_SLOT_GUARD_US;
+    windowUs = DW1000Ng::getFrameDuration(LEN_POLL) + MULTI_FIRST_SLOT_US +
+        (uint32_t)anchorCount * slotUs + MULTI_SLOT_GUARD_US;
+    // the POLL preamble starts the guard after the last FINAL bit
+    nextPollDelayUs = DW1000Ng::getFrameDuration(FINAL_HEADER + anchorCount * LENGTH_TIMESTAMP) +
+        NEXT_POLL_GUARD_US;
+    stageFrames();
+
+    char msg[128];
+    DW1000Ng::getPrintableDeviceIdentifier(msg);
+    Serial.print(F("Device: ")); Serial.println(msg);
+    DW1000Ng::getPrintableDeviceMode(msg);
+    Serial.print(F("Mode: ")); Serial.println(msg);
+    Serial.print(F("Antenna delay: ")); Serial.println(ANTENNA_DELAY);
+    Serial.print(F("Anchors: ")); Serial.print(anchorCount);
+    Serial.print(F("  slot: ")); Serial.print(slotUs);
+    Serial.print(F(" us  window: ")); Serial.print(windowUs);
+    Serial.println(F(" us"));
+
+    DW1000Ng::attachSentHandler(handleSent);
+
+    Serial.println(F("Starting one-to-many TWR...\n"));
+    displayStatus("MULTI TAG", "Ranging...");
+
+    transmitPoll();
+    noteActivity();
+}
+
+void loop() {
+    static uint32_t lastReport = 0;
+
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
+
+    if (collecting) {
+        rx_frame_t frame;
+        while (DW1000Ng::popFrame(frame)) {
+            handleResponse(frame);
+        }
+        // the FINAL slot is fixed, stop listening once everyone answered
+        if (responseCount == anchorCount || micros() - pollStartedAt > pollWindowUs) {
+            collecting = false;
+            transmitFinal();
+            noteActivity();
+        }
+    }
+
+    if (sentAck) {
+        sentAck = false;
+        if (finalInFlight) {
+            // the FINAL is out: report, then let the chip poll again once the
+            // anchors listen
+            finalInFlight = false;
+            finalSequence = sequence;
+            finalDue = true;
+            reportRanges();
+            DW1000Ng::forceTRxOff();
+            DW1000Ng::scheduleReplyAfterRx(timeFinalSent, nextPollDelayUs);
+            transmitPoll(TransmitMode::DELAYED);
+            noteActivity();
+        }
+    }
+
+    if (millis() - lastActivity > resetPeriod) {
+        resetInactive();
+    }
+
+    if (millis() - lastReport >= 10000) {
+        lastReport = millis();
+        Serial.print(F("["));
+        Serial.print(millis() / 1000);
+        Serial.print(F("s] polls:"));
+        Serial.print(pollCount);
+        Serial.print(F(" exchanges:"));
+        Serial.print(exchangeCount);
+        Serial.print(F(" responses:"));
+        Serial.print(responseTotal);
+        Serial.print(F(" ranges:"));
+        Serial.print(rangeCount);
+        Serial.print(F(" late:"));
+        Serial.print(lateCount);
+        Serial.print(F(" dropped:"));
+        Serial.println(DW1000Ng::getDroppedFrameCount());
+    }
+}
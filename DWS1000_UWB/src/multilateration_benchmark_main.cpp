@@ -0,0 +1,265 @@
+/**
+ * Multilateration Benchmark
+ *
+ * Compares the position solvers of lib/Multilateration with the closed-form
+ * 2D trilateration of tests/test_08_multi_node_swarm (first three anchors,
+ * z pinned), reproduced here as the reference:
+ *   - accuracy: mean, RMS and largest position error over random tag
+ *     positions in each anchor geometry, with failed solves counted apart,
+ *     and how often the weighted Gauss-Newton refinement lands closer than
+ *     the linear guess it starts from, or clearly further
+ *   - speed: microseconds per solve and solves per second
+ *
+ * Ranges follow a simple indoor model: RX power falls 20 dB per decade from
+ * -62 dBm at 1 m, the range noise has the variance the library assumes for
+ * that power, and 1 in 10 ranges is non line-of-sight, 0.3 to 1 m long and
+ * 10 dB weaker. 2D errors are horizontal, 3D errors are full.
+ *
+ * Results repeat every 10 s on the board; the native build prints them once
+ * and exits.
+ */
+
+#include <Arduino.h>
+#include <Multilateration.hpp>
+
+using Multilateration::AnchorRange;
+using Multilateration::Solution;
+
+#if defined(DW1000NG_HOST)
+#define BENCH_TRIALS     2000
+#define BENCH_ITERATIONS 10000
+#else
+#define BENCH_TRIALS     100
+#define BENCH_ITERATIONS 50
+#endif
+
+#define ANCHOR_HEIGHT   2.5f    // ceiling anchors of the 2D geometries
+#define TAG_HEIGHT      1.0f    // tag height the 2D solvers are given
+#define NLOS_PERCENT    10
+#define WORSE_BY_M      0.25f   // refinement counted as clearly worse than the guess
+
+const AnchorRange SQUARE_4[] = {
+    {0, 0, ANCHOR_HEIGHT, 0, 0}, {10, 0, ANCHOR_HEIGHT, 0, 0},
+    {10, 8, ANCHOR_HEIGHT, 0, 0}, {0, 8, ANCHOR_HEIGHT, 0, 0}
+};
+
+const AnchorRange SQUARE_8[] = {
+    {0, 0, ANCHOR_HEIGHT, 0, 0}, {10, 0, ANCHOR_HEIGHT, 0, 0},
+    {10, 8, ANCHOR_HEIGHT, 0, 0}, {0, 8, ANCHOR_HEIGHT, 0, 0},
+    {5, 0, ANCHOR_HEIGHT, 0, 0}, {10, 4, ANCHOR_HEIGHT, 0, 0},
+    {5, 8, ANCHOR_HEIGHT, 0, 0}, {0, 4, ANCHOR_HEIGHT, 0, 0}
+};
+
+const AnchorRange CORRIDOR_6[] = {
+    {0, 0, ANCHOR_HEIGHT, 0, 0}, {0, 3, ANCHOR_HEIGHT, 0, 0},
+    {15, 0, ANCHOR_HEIGHT, 0, 0}, {15, 3, ANCHOR_HEIGHT, 0, 0},
+    {30, 0, ANCHOR_HEIGHT, 0, 0}, {30, 3, ANCHOR_HEIGHT, 0, 0}
+};
+
+// Low and high anchors, so z is observable
+const AnchorRange ROOM_8[] = {
+    {0, 0, 0.3f, 0, 0}, {10, 0, 0.3f, 0, 0}, {10, 8, 0.3f, 0, 0}, {0, 8, 0.3f, 0, 0},
+    {5, 0, 2.7f, 0, 0}, {10, 4, 2.7f, 0, 0}, {5, 8, 2.7f, 0, 0}, {0, 4, 2.7f, 0, 0}
+};
+
+// Pre-change solver of node_firmware.ino::updatePosition(), kept here as the reference
+boolean legacySolve(const AnchorRange ranges[], Solution& solution) {
+    float x1 = ranges[0].x, y1 = ranges[0].y, r1 = ranges[0].range;
+    float x2 = ranges[1].x, y2 = ranges[1].y, r2 = ranges[1].range;
+    float x3 = ranges[2].x, y3 = ranges[2].y, r3 = ranges[2].range;
+
+    float A = 2 * (x2 - x1);
+    float B = 2 * (y2 - y1);
+    float C = r1*r1 - r2*r2 - x1*x1 + x2*x2 - y1*y1 + y2*y2;
+
+    float D = 2 * (x3 - x2);
+    float E = 2 * (y3 - y2);
+    float F = r2*r2 - r3*r3 - x2*x2 + x3*x3 - y2*y2 + y3*y3;
+
+    float denom = (E*A - B*D);
+    if (fabs(denom) <= 0.001) {
+        return false;
+    }
+    solution.x = (C*E - F*B) / denom;
+    solution.y = (C*D - A*F) / (B*D - A*E);
+    solution.z = TAG_HEIGHT;
+    return true;
+}
+
+enum Method { LEGACY, LINEAR, UNWEIGHTED, WEIGHTED, N_METHODS };
+
+boolean runMethod(uint8_t method, AnchorRange ranges[], uint8_t n, uint8_t dims, Solution& solution) {
+    switch (method) {
+    case LEGACY:
+        return legacySolve(ranges, solution);
+    case LINEAR:
+        return Multilateration::solveLinear(ranges, n, dims, TAG_HEIGHT, solution);
+    case UNWEIGHTED: {
+        AnchorRange flat[Multilateration::MAX_ANCHORS];
+        for (uint8_t i = 0; i < n; i++) {
+            flat[i] = ranges[i];
+            flat[i].rxPower = 0;
+        }
+        return Multilateration::solve(flat, n, dims, TAG_HEIGHT, solution);
+    }
+    default:
+        return Multilateration::solve(ranges, n, dims, TAG_HEIGHT, solution);
+    }
+}
+
+void printMethod(uint8_t method) {
+    switch (method) {
+    case LEGACY:     Serial.print(F("  3-anchor closed form   ")); break;
+    case LINEAR:     Serial.print(F("  linear LS              ")); break;
+    case UNWEIGHTED: Serial.print(F("  unweighted Gauss-Newton")); break;
+    default:         Serial.print(F("  weighted Gauss-Newton  ")); break;
+    }
+}
+
+float randomUniform(float low, float high) {
+    return low + (high - low) * random(0, 10001) / 10000.0f;
+}
+
+// Box-Muller, unit variance
+float randomGaussian() {
+    float u1 = random(1, 10001) / 10000.0f;
+    float u2 = random(0, 10000) / 10000.0f;
+    return sqrt(-2.0f * log(u1)) * cos(6.2831853f * u2);
+}
+
+// Fills the ranges of the anchors to a tag at (x, y, z) with the model above
+void measure(const AnchorRange anchors[], AnchorRange ranges[], uint8_t n, float x, float y, float z) {
+    for (uint8_t i = 0; i < n; i++) {
+        ranges[i] = anchors[i];
+        float dx = x - anchors[i].x, dy = y - anchors[i].y, dz = z - anchors[i].z;
+        float d = sqrt(dx * dx + dy * dy + dz * dz);
+        float power = -62.0f - 20.0f * log10(d < 0.5f ? 0.5f : d);
+        float bias = 0;
+        if (random(100) < NLOS_PERCENT) {
+            bias = randomUniform(0.3f, 1.0f);
+            power -= 10.0f;
+        }
+        ranges[i].rxPower = power;
+        ranges[i].range = d + bias + sqrt(Multilateration::getRangeVariance(power)) * randomGaussian();
+    }
+}
+
+struct ErrorStats {
+    float maxError;
+    float sumError;
+    float sumSquared;
+    uint16_t samples;
+    uint16_t failed;
+};
+
+float addSample(ErrorStats &e, const Solution& s, uint8_t dims, float x, float y, float z) {
+    float dx = s.x - x, dy = s.y - y, dz = dims == 3 ? s.z - z : 0;
+    float error = sqrt(dx * dx + dy * dy + dz * dz);
+    if (error > e.maxError) e.maxError = error;
+    e.sumError += error;
+    e.sumSquared += error * error;
+    e.samples++;
+    return error;
+}
+
+volatile float sinkFloat;
+
+void runGeometry(const __FlashStringHelper *name, const AnchorRange anchors[], uint8_t n, uint8_t dims,
+                 float width, float depth, float zLow, float zHigh) {
+    Serial.print(name);
+    Serial.print(F(", "));
+    Serial.print(n);
+    Serial.print(F(" anchors, "));
+    Serial.print(dims);
+    Serial.println(F("D"));
+
+    ErrorStats stats[N_METHODS];
+    memset(stats, 0, sizeof(stats));
+    AnchorRange ranges[Multilateration::MAX_ANCHORS];
+    Solution solution;
+    uint16_t compared = 0, closer = 0, worse = 0;
+    for (uint16_t t = 0; t < BENCH_TRIALS; t++) {
+        float x = randomUniform(0, width);
+        float y = randomUniform(0, depth);
+        float z = dims == 3 ? randomUniform(zLow, zHigh) : TAG_HEIGHT;
+        measure(anchors, ranges, n, x, y, z);
+        float error[N_METHODS];
+        for (uint8_t m = (dims == 3 ? LINEAR : LEGACY); m < N_METHODS; m++) {
+            error[m] = -1;
+            if (runMethod(m, ranges, n, dims, solution)) {
+                error[m] = addSample(stats[m], solution, dims, x, y, z);
+            } else {
+                stats[m].failed++;
+            }
+        }
+        if (error[LINEAR] >= 0 && error[WEIGHTED] >= 0) {
+            compared++;
+            if (error[WEIGHTED] < error[LINEAR]) closer++;
+            if (error[WEIGHTED] > error[LINEAR] + WORSE_BY_M) worse++;
+        }
+    }
+
+    // speed on one sample from the middle of the area
+    measure(anchors, ranges, n, width / 2, depth / 3, (zLow + zHigh) / 2);
+    for (uint8_t m = (dims == 3 ? LINEAR : LEGACY); m < N_METHODS; m++) {
+        uint32_t start = micros();
+        for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+            runMethod(m, ranges, n, dims, solution);
+            sinkFloat = solution.x;
+        }
+        float us = (float)(micros() - start) / BENCH_ITERATIONS;
+
+        const ErrorStats &e = stats[m];
+        printMethod(m);
+        Serial.print(F("  mean "));
+        Serial.print(e.samples ? e.sumError / e.samples : 0, 3);
+        Serial.print(F(" m  rms "));
+        Serial.print(e.samples ? sqrt(e.sumSquared / e.samples) : 0, 3);
+        Serial.print(F(" m  max "));
+        Serial.print(e.maxError, 3);
+        Serial.print(F(" m  failed "));
+        Serial.print(e.failed);
+        Serial.print(F("  "));
+        Serial.print(us, 2);
+        Serial.print(F(" us  "));
+        Serial.print(us > 0 ? 1000000.0f / us : 0, 0);
+        Serial.println(F(" solves/s"));
+    }
+    Serial.print(F("  weighted Gauss-Newton vs linear LS: closer in "));
+    Serial.print(closer);
+    Serial.print(F(" of "));
+    Serial.print(compared);
+    Serial.print(F(" positions, more than "));
+    Serial.print(WORSE_BY_M, 2);
+    Serial.print(F(" m further in "));
+    Serial.println(worse);
+}
+
+void runBenchmark() {
+    randomSeed(1);
+    runGeometry(F("square 10 x 8 m"), SQUARE_4, 4, 2, 10, 8, 0, 0);
+    runGeometry(F("square 10 x 8 m"), SQUARE_8, 8, 2, 10, 8, 0, 0);
+    runGeometry(F("corridor 30 x 3 m"), CORRIDOR_6, 6, 2, 30, 3, 0, 0);
+    runGeometry(F("room 10 x 8 x 3 m"), ROOM_8, 8, 3, 10, 8, 0.5f, 2.0f);
+    Serial.println();
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    Serial.println(F("\n=== Multilateration Benchmark ==="));
+    Serial.print(BENCH_TRIALS);
+    Serial.print(F(" tag positions per geometry, "));
+    Serial.print(NLOS_PERCENT);
+    Serial.println(F(" % NLOS ranges"));
+
+    runBenchmark();
+#if defined(DW1000NG_HOST)
+    exit(0);
+#endif
+}
+
+void loop() {
+    delay(10000);
+    runBenchmark();
+}
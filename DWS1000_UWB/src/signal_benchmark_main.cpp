@@ -0,0 +1,181 @@
+/**
+ * Signal Power Benchmark — DW1000-ng
+ *
+ * Compares the integer Q8.8 receive / first path power of the driver
+ * (getReceivePowerQ8(), getFirstPathPowerQ8()) with the original float
+ * 10*log10 implementation, reproduced here as the reference:
+ *   - accuracy: largest and mean difference in dB over a sweep of CIR_PWR,
+ *     first path amplitudes and RXPACC, for both pulse repetition frequencies
+ *   - speed: microseconds per call of each, on snapshots (no SPI traffic)
+ *
+ * Q8.8 bottoms out at -128 dBm. Sweep points whose reference is below that
+ * are counted as "below range" and left out of the error figures.
+ *
+ * Results repeat every 10 s on the board; the native build prints them once
+ * and exits.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgConstants.hpp>
+#include "config.h"
+
+#define BENCH_ITERATIONS 200
+
+device_configuration_t BENCH_CONFIG = {
+    false,                       // extendedFrameLength
+    true,                        // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+const uint16_t RXPACC[] = {50, 110, 230, 460, 900, 1800};
+const uint8_t N_RXPACC = sizeof(RXPACC) / sizeof(RXPACC[0]);
+
+// Pre-change float implementation, kept here as the reference
+float legacyCorrectedPower(float estPwr, boolean prf16) {
+    float A = prf16 ? 113.77 : 121.74;
+    float corrFac = prf16 ? 2.3334 : 1.1667;
+    estPwr -= A;
+    if (estPwr <= -88) {
+        return estPwr;
+    }
+    estPwr += (estPwr + 88) * corrFac;
+    return estPwr;
+}
+
+float legacyReceivePower(const frame_snapshot_t &s, boolean prf16) {
+    float C = s.cirPower;
+    float N = s.preambleAccumulation;
+    return legacyCorrectedPower(10.0 * log10((C * 131072.0f) / (N * N)), prf16);
+}
+
+float legacyFirstPathPower(const frame_snapshot_t &s, boolean prf16) {
+    float f1 = s.firstPathAmplitude1, f2 = s.firstPathAmplitude2, f3 = s.firstPathAmplitude3;
+    float N = s.preambleAccumulation;
+    return legacyCorrectedPower(10.0 * log10((f1 * f1 + f2 * f2 + f3 * f3) / (N * N)), prf16);
+}
+
+struct ErrorStats {
+    float maxError;
+    float sumError;
+    uint16_t samples;
+    uint16_t belowRange;
+};
+
+void addSample(ErrorStats &e, float fixed, float reference) {
+    if (reference < -128.0f) {
+        e.belowRange++;
+        return;
+    }
+    float error = fabs(fixed - reference);
+    if (error > e.maxError) e.maxError = error;
+    e.sumError += error;
+    e.samples++;
+}
+
+void printErrors(const __FlashStringHelper *name, const ErrorStats &e) {
+    Serial.print(name);
+    Serial.print(F("  samples "));
+    Serial.print(e.samples);
+    Serial.print(F("  max |err| "));
+    Serial.print(e.maxError, 4);
+    Serial.print(F(" dB  mean "));
+    Serial.print(e.sumError / e.samples, 4);
+    Serial.print(F(" dB  below range "));
+    Serial.println(e.belowRange);
+}
+
+void runAccuracy(boolean prf16) {
+    ErrorStats rx = {0, 0, 0, 0};
+    ErrorStats fp = {0, 0, 0, 0};
+    frame_snapshot_t s;
+    memset(&s, 0, sizeof(s));
+    for (uint8_t n = 0; n < N_RXPACC; n++) {
+        s.preambleAccumulation = RXPACC[n];
+        // CIR_PWR and amplitudes from 1 to 65535, about 7 % apart
+        for (uint32_t v = 1; v <= 65535; v += v / 16 + 1) {
+            s.cirPower = v;
+            addSample(rx, DW1000Ng::getReceivePowerQ8(s) / 256.0f, legacyReceivePower(s, prf16));
+            s.firstPathAmplitude1 = v;
+            s.firstPathAmplitude2 = v - v / 4;
+            s.firstPathAmplitude3 = v / 2;
+            addSample(fp, DW1000Ng::getFirstPathPowerQ8(s) / 256.0f, legacyFirstPathPower(s, prf16));
+        }
+    }
+    printErrors(prf16 ? F("rx power, 16 MHz PRF") : F("rx power, 64 MHz PRF"), rx);
+    printErrors(prf16 ? F("fp power, 16 MHz PRF") : F("fp power, 64 MHz PRF"), fp);
+}
+
+volatile float sinkFloat;
+volatile int16_t sinkFixed;
+
+void runSpeed() {
+    frame_snapshot_t s;
+    memset(&s, 0, sizeof(s));
+    s.cirPower = 5000;
+    s.firstPathAmplitude1 = 4000;
+    s.firstPathAmplitude2 = 3500;
+    s.firstPathAmplitude3 = 3000;
+    s.preambleAccumulation = 230;
+
+    uint32_t start = micros();
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        s.cirPower++;
+        sinkFloat = legacyReceivePower(s, true);
+        sinkFloat = legacyFirstPathPower(s, true);
+    }
+    uint32_t legacy = micros() - start;
+
+    start = micros();
+    for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+        s.cirPower++;
+        sinkFixed = DW1000Ng::getReceivePowerQ8(s);
+        sinkFixed = DW1000Ng::getFirstPathPowerQ8(s);
+    }
+    uint32_t fixed = micros() - start;
+
+    Serial.print(F("rx + fp power, float log10: "));
+    Serial.print((float)legacy / BENCH_ITERATIONS, 2);
+    Serial.print(F(" us  Q8.8: "));
+    Serial.print((float)fixed / BENCH_ITERATIONS, 2);
+    Serial.println(F(" us"));
+}
+
+void runBenchmark() {
+    BENCH_CONFIG.pulseFreq = PulseFrequency::FREQ_16MHZ;
+    BENCH_CONFIG.preaCode = PreambleCode::CODE_3;
+    DW1000Ng::applyConfiguration(BENCH_CONFIG);
+    runAccuracy(true);
+    runSpeed();
+    BENCH_CONFIG.pulseFreq = PulseFrequency::FREQ_64MHZ;
+    BENCH_CONFIG.preaCode = PreambleCode::CODE_9;
+    DW1000Ng::applyConfiguration(BENCH_CONFIG);
+    runAccuracy(false);
+    Serial.println();
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    Serial.println(F("\n=== Signal Power Benchmark (DW1000-ng) ==="));
+
+    DW1000Ng::initializeNoInterrupt(SS, PIN_RST);
+    runBenchmark();
+#if defined(DW1000NG_HOST)
+    exit(0);
+#endif
+}
+
+void loop() {
+    delay(10000);
+    runBenchmark();
+}
@@ -0,0 +1,117 @@
+/**
+ * SPI Benchmark — DW1000-ng
+ *
+ * Measures SPI transactions per second against the DW1000 for:
+ *   - the legacy transfer path (byte-by-byte transfer(), 5 us before CS
+ *     release), reproduced here on top of SPI.h
+ *   - SPIporting with buffer transfers and a few CS hold/setup timings
+ *
+ * Each case runs BENCH_ITERATIONS of three typical TWR transactions:
+ * a 4-byte SYS_STATUS read, a 16-byte RX_BUFFER read and a 16-byte
+ * TX_BUFFER write. Results repeat every 10 s on the board; the native
+ * build prints them once and exits.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgConstants.hpp>
+#include <DW1000NgRegisters.hpp>
+#include <SPIporting.hpp>
+#include "config.h"
+
+#define BENCH_ITERATIONS 1000
+#define LEN_PAYLOAD 16
+
+const uint8_t PIN_SS = SS;
+
+byte payload[LEN_PAYLOAD];
+
+enum BenchOp { OP_STATUS, OP_RX_READ, OP_TX_WRITE, OP_COUNT };
+
+// Pre-change writeToSPI/readFromSPI, kept here as the baseline
+void legacyTransaction(byte reg, byte buf[], uint16_t n, boolean write) {
+    SPI.beginTransaction(SPISettings(16000000L, MSBFIRST, SPI_MODE0));
+    digitalWrite(PIN_SS, LOW);
+    SPI.transfer(write ? (byte)(WRITE | reg) : reg);
+    for (uint16_t i = 0; i < n; i++) {
+        if (write) {
+            SPI.transfer(buf[i]);
+        } else {
+            buf[i] = SPI.transfer(0x00);
+        }
+    }
+    delayMicroseconds(5);
+    digitalWrite(PIN_SS, HIGH);
+    SPI.endTransaction();
+}
+
+void runOp(BenchOp op, boolean legacy) {
+    switch (op) {
+    case OP_STATUS:
+        if (legacy) legacyTransaction(SYS_STATUS, payload, LEN_SYS_STATUS, false);
+        else DW1000Ng::readBytes(SYS_STATUS, NO_SUB, payload, LEN_SYS_STATUS);
+        break;
+    case OP_RX_READ:
+        if (legacy) legacyTransaction(RX_BUFFER, payload, LEN_PAYLOAD, false);
+        else DW1000Ng::readBytes(RX_BUFFER, NO_SUB, payload, LEN_PAYLOAD);
+        break;
+    case OP_TX_WRITE:
+        if (legacy) legacyTransaction(TX_BUFFER, payload, LEN_PAYLOAD, true);
+        else DW1000Ng::writeBytes(TX_BUFFER, NO_SUB, payload, LEN_PAYLOAD);
+        break;
+    default:
+        break;
+    }
+}
+
+void runCase(const __FlashStringHelper *name, boolean legacy) {
+    Serial.print(name);
+    for (uint8_t op = 0; op < OP_COUNT; op++) {
+        uint32_t start = micros();
+        for (uint16_t i = 0; i < BENCH_ITERATIONS; i++) {
+            runOp((BenchOp)op, legacy);
+        }
+        uint32_t elapsed = micros() - start;
+        Serial.print(F("  "));
+        Serial.print((float)BENCH_ITERATIONS * 1000000.0f / elapsed, 0);
+        Serial.print(F("/s "));
+        Serial.print((float)elapsed / BENCH_ITERATIONS, 1);
+        Serial.print(F("us"));
+    }
+    Serial.println();
+}
+
+void runBenchmark() {
+    Serial.println(F("case                      status (4B)         rx (16B)            tx (16B)"));
+    runCase(F("legacy byte loop, hold 5"), true);
+    SPIporting::setChipSelectTiming(0, 5);
+    runCase(F("buffered, hold 5        "), false);
+    SPIporting::setChipSelectTiming(1, 1);
+    runCase(F("buffered, setup/hold 1  "), false);
+    SPIporting::setChipSelectTiming(0, 0);
+    runCase(F("buffered, no CS waits   "), false);
+    SPIporting::setChipSelectTiming(DW1000NG_SPI_CS_SETUP_US, DW1000NG_SPI_CS_HOLD_US);
+    Serial.println();
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+    Serial.println(F("\n=== SPI Benchmark (DW1000-ng) ==="));
+
+    DW1000Ng::initializeNoInterrupt(PIN_SS, PIN_RST);
+    for (uint8_t i = 0; i < LEN_PAYLOAD; i++) {
+        payload[i] = i;
+    }
+
+    runBenchmark();
+#if defined(DW1000NG_HOST)
+    exit(0);
+#endif
+}
+
+void loop() {
+    delay(10000);
+    runBenchmark();
+}
@@ -4,6 +4,18 @@
  * Asymmetric Two-Way Ranging: sends POLL, receives POLL_ACK, sends RANGE.
  * Anchor computes distance and sends RANGE_REPORT back.
  *
+ * Every TX arms the receiver in hardware (WAIT4RESP), so the loop only sees
+ * the outcome of each step: the reply, or an RX timeout.
+ *
+ * With TWR_REPORT_IN_POLL_ACK (config.h) the tag asks for 3-message DS-TWR:
+ * no RANGE_REPORT, the anchor returns the range in the next POLL_ACK and the
+ * next POLL is a delayed TX NEXT_POLL_GUARD_US after the end of the RANGE.
+ *
+ * With TWR_SINGLE_SIDED (config.h) it runs 2-message SS-TWR: the POLL_ACK
+ * carries the anchor's reply time, and the tag scales it to its own clock
+ * with the anchor's clock offset from the carrier integrator, smoothed per
+ * anchor. Half the frames of DS-TWR and no RANGE_REPORT.
+ *
  * Uses config.h for antenna delay and pin assignments.
  * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
  */
@@ -12,8 +24,9 @@
 #include <SPI.h>
 #include <DW1000Ng.hpp>
 #include <DW1000NgUtils.hpp>
-#include <DW1000NgTime.hpp>
+#include <DW1000NgRanging.hpp>
 #include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
 #include "config.h"
 #include "display.h"
 
@@ -27,6 +40,7 @@
 volatile byte expectedMsgId = POLL_ACK;
 volatile boolean sentAck = false;
 volatile boolean receivedAck = false;
+volatile boolean receiveTimedOut = false;
 
 // Timestamps
 uint64_t timePollSent;
@@ -37,10 +51,44 @@ uint64_t timeRangeSent;
 #define LEN_DATA 16
 byte data[LEN_DATA];
 
+// Frames staged in TX_BUFFER once, RANGE gets its timestamps patched in
+const tx_template_t POLL_FRAME = {0, LEN_DATA};
+const tx_template_t RANGE_FRAME = {LEN_DATA, LEN_DATA};
+#define RANGE_TIMESTAMPS_OFFSET 1
+#define LEN_RANGE_TIMESTAMPS (3 * LENGTH_TIMESTAMP)
+
+// 3-message mode, see anchor_main.cpp: POLL_ACK carries the previous range
+// followed by bytes 12-13 of its RANGE frame
+#define POLL_FLAGS_OFFSET 1
+#define REPORT_IN_POLL_ACK 0x01
+#define POLL_ACK_REPORT_OFFSET 1
+#define RANGE_STAMP_OFFSET 12
+#define LEN_RANGE_STAMP 2
+byte rangeStamp[LEN_RANGE_STAMP];  // of the last RANGE sent
+boolean rangeDue = false;          // its result is still to come
+boolean rangeInFlight = false;     // the next POLL waits for it to be sent
+uint32_t nextPollDelayUs;          // RANGE TX timestamp -> next POLL TX timestamp
+
+// Single-sided mode, see anchor_main.cpp: POLL_ACK carries the reply time and
+// the anchor's address
+#define SINGLE_SIDED 0x02
+#define POLL_ACK_REPLY_OFFSET 7
+#define LEN_REPLY_TIME 4
+#define POLL_ACK_ADDRESS_OFFSET 11
+#define MAX_NEIGHBORS 4
+#define CLOCK_OFFSET_SMOOTHING 3   // each POLL_ACK moves the estimate by 1/8
+uint16_t neighborAddress[MAX_NEIGHBORS];  // most recently heard first
+int32_t neighborOffsetPpb[MAX_NEIGHBORS];
+uint8_t neighborCount = 0;
+
+#if defined(TWR_SINGLE_SIDED) && defined(TWR_REPORT_IN_POLL_ACK)
+#error "TWR_SINGLE_SIDED and TWR_REPORT_IN_POLL_ACK are alternatives"
+#endif
+
 // Timing
 uint32_t lastActivity;
 uint32_t resetPeriod = 500;
-uint16_t replyDelayTimeUS = 3000;
+uint16_t replyDelayTimeUS = 3000;  // until the reply delay tuning is done
 
 // Stats
 uint32_t pollCount = 0;
@@ -62,39 +110,124 @@ device_configuration_t DEFAULT_CONFIG = {
 };
 
 interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
-    true,   // interruptOnSent
+#ifdef TWR_REPORT_IN_POLL_ACK
+    true,   // interruptOnSent, the next POLL follows the RANGE
+#else
+    false,  // interruptOnSent
+#endif
     true,   // interruptOnReceived
     true,   // interruptOnReceiveFailed
-    false,  // interruptOnReceiveTimeout
+    true,   // interruptOnReceiveTimeout
     true    // interruptOnReceiveTimestampAvailable
 };
 
 void handleSent() { sentAck = true; }
 void handleReceived() { receivedAck = true; }
+void handleReceiveTimeout() { receiveTimedOut = true; }
 void noteActivity() { lastActivity = millis(); }
 
-void transmitPoll() {
+// DELAYED: at the time scheduled with DW1000Ng::scheduleReplyAfterRx(), or at
+// once if that has passed
+void transmitPoll(TransmitMode mode = TransmitMode::IMMEDIATE) {
     pollCount++;
+    rangeInFlight = false;
+    DW1000Ng::selectTransmitTemplate(POLL_FRAME);
+    DW1000Ng::startTransmit(mode);
+    if (mode == TransmitMode::DELAYED && DW1000Ng::isTransmitLate()) {
+        DW1000Ng::startTransmit();
+    }
+}
+
+void stageFrames() {
+    memset(data, 0, LEN_DATA);
     data[0] = POLL;
-    DW1000Ng::setTransmitData(data, LEN_DATA);
-    DW1000Ng::startTransmit();
+#ifdef TWR_REPORT_IN_POLL_ACK
+    data[POLL_FLAGS_OFFSET] = REPORT_IN_POLL_ACK;
+#endif
+#ifdef TWR_SINGLE_SIDED
+    data[POLL_FLAGS_OFFSET] = SINGLE_SIDED;
+#endif
+    DW1000Ng::writeTransmitTemplate(POLL_FRAME, data);
+    data[0] = RANGE;
+    DW1000Ng::writeTransmitTemplate(RANGE_FRAME, data);
 }
 
 void transmitRange() {
-    data[0] = RANGE;
+    byte timestamps[LEN_RANGE_TIMESTAMPS];
+
+    // timed from the POLL_ACK RX timestamp, with the self-tuned delay
+    timeRangeSent = DW1000Ng::scheduleReplyAfterRx(timePollAckReceived, DW1000Ng::REPLY_DELAY_AUTO);
 
-    byte futureTimeBytes[LENGTH_TIMESTAMP];
-    timeRangeSent = DW1000Ng::getSystemTimestamp();
-    timeRangeSent += DW1000NgTime::microsecondsToUWBTime(replyDelayTimeUS);
-    DW1000NgUtils::writeValueToBytes(futureTimeBytes, timeRangeSent, LENGTH_TIMESTAMP);
-    DW1000Ng::setDelayedTRX(futureTimeBytes);
-    timeRangeSent += DW1000Ng::getTxAntennaDelay();
-
-    DW1000NgUtils::writeValueToBytes(data + 1, timePollSent, LENGTH_TIMESTAMP);
-    DW1000NgUtils::writeValueToBytes(data + 6, timePollAckReceived, LENGTH_TIMESTAMP);
-    DW1000NgUtils::writeValueToBytes(data + 11, timeRangeSent, LENGTH_TIMESTAMP);
-    DW1000Ng::setTransmitData(data, LEN_DATA);
+    DW1000NgUtils::writeValueToBytes(timestamps, timePollSent, LENGTH_TIMESTAMP);
+    DW1000NgUtils::writeValueToBytes(timestamps + 5, timePollAckReceived, LENGTH_TIMESTAMP);
+    DW1000NgUtils::writeValueToBytes(timestamps + 10, timeRangeSent, LENGTH_TIMESTAMP);
+    DW1000Ng::patchTransmitTemplate(RANGE_FRAME, RANGE_TIMESTAMPS_OFFSET, timestamps, LEN_RANGE_TIMESTAMPS);
+    DW1000Ng::selectTransmitTemplate(RANGE_FRAME);
     DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    if (DW1000Ng::isTransmitLate()) {
+        // missed the reply slot, start over
+        rangeDue = false;
+        expectedMsgId = POLL_ACK;
+        transmitPoll();
+        return;
+    }
+#ifdef TWR_REPORT_IN_POLL_ACK
+    // answered by the POLL_ACK of the exchange that follows once this is out
+    memcpy(rangeStamp, timestamps + RANGE_STAMP_OFFSET - RANGE_TIMESTAMPS_OFFSET, LEN_RANGE_STAMP);
+    rangeDue = true;
+    rangeInFlight = true;
+#endif
+}
+
+void reportRange(float curRange) {
+    rangeCount++;
+    float distM = curRange * DISTANCE_OF_RADIO;
+
+    Serial.print(F("R#"));
+    Serial.print(rangeCount);
+    Serial.print(F(" "));
+    Serial.print(distM, 2);
+    Serial.println(F(" m"));
+
+    displayDistance(distM, rangeCount);
+}
+
+// Clock offset of an anchor, smoothed: the carrier integrator of one frame is
+// noisy, the crystals drift slowly. A new anchor takes the place of the least
+// recently heard one; with more than MAX_NEIGHBORS anchors heard in turn, each
+// starts over from its raw offset every time.
+int32_t trackClockOffset(uint16_t address, int32_t offsetPpb) {
+    uint8_t i = 0;
+    while (i < neighborCount && neighborAddress[i] != address) {
+        i++;
+    }
+    if (i == neighborCount) {
+        if (neighborCount < MAX_NEIGHBORS) {
+            neighborCount++;
+        }
+        i = neighborCount - 1;
+    } else {
+        offsetPpb = neighborOffsetPpb[i] + (offsetPpb - neighborOffsetPpb[i]) / (1 << CLOCK_OFFSET_SMOOTHING);
+    }
+    for (; i > 0; i--) {
+        neighborAddress[i] = neighborAddress[i - 1];
+        neighborOffsetPpb[i] = neighborOffsetPpb[i - 1];
+    }
+    neighborAddress[0] = address;
+    neighborOffsetPpb[0] = offsetPpb;
+    return offsetPpb;
+}
+
+// Single-sided: range from the POLL_ACK alone, the last received frame
+float computeSingleSidedRange(const frame_snapshot_t& frame) {
+    uint16_t address = DW1000NgUtils::bytesAsValue(data + POLL_ACK_ADDRESS_OFFSET, 2);
+    int32_t offsetPpb = trackClockOffset(address, DW1000Ng::getClockOffsetPpb());
+    uint64_t replyTime = DW1000NgUtils::bytesAsValue(data + POLL_ACK_REPLY_OFFSET, LEN_REPLY_TIME);
+    // only the reply time counts, so POLL RX is 0 and POLL_ACK TX is the reply time
+    double distance = DW1000NgRanging::computeRangeSingleSided(
+        timePollSent, 0, replyTime, timePollAckReceived, offsetPpb);
+    distance = DW1000NgRanging::correctRange(distance, DW1000Ng::getReceivePowerQ8(frame));
+    return distance * DISTANCE_OF_RADIO_INV;
 }
 
 void resetInactive() {
@@ -120,6 +253,13 @@ void setup() {
     DW1000Ng::setDeviceAddress(2);
     DW1000Ng::setNetworkId(10);
     DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+    DW1000Ng::setReceiveFrameWaitTimeoutPeriod(RESPONSE_TIMEOUT_US);
+    DW1000Ng::setReplyDelay(replyDelayTimeUS);
+    DW1000Ng::startReplyDelayTuning();
+    // the POLL preamble starts the guard after the last RANGE bit
+    nextPollDelayUs = DW1000Ng::getFrameDuration(LEN_DATA) + NEXT_POLL_GUARD_US;
+    stageFrames();
 
     char msg[128];
     DW1000Ng::getPrintableDeviceIdentifier(msg);
@@ -130,6 +270,7 @@ void setup() {
 
     DW1000Ng::attachSentHandler(handleSent);
     DW1000Ng::attachReceivedHandler(handleReceived);
+    DW1000Ng::attachReceiveTimeoutHandler(handleReceiveTimeout);
 
     Serial.println(F("Starting TWR...\n"));
     displayStatus("TAG", "Ranging...");
@@ -141,7 +282,14 @@ void setup() {
 void loop() {
     static uint32_t lastReport = 0;
 
-    if (!sentAck && !receivedAck) {
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
+
+    if (!sentAck && !receivedAck && !receiveTimedOut) {
         if (millis() - lastActivity > resetPeriod) {
             resetInactive();
         }
@@ -150,12 +298,29 @@ void loop() {
 
     if (sentAck) {
         sentAck = false;
-        DW1000Ng::startReceive();
+        if (rangeInFlight) {
+            // 3-message mode: nothing answers the RANGE, drop the receiver
+            // WAIT4RESP armed and let the chip poll again once the anchor listens
+            DW1000Ng::forceTRxOff();
+            DW1000Ng::scheduleReplyAfterRx(timeRangeSent, nextPollDelayUs);
+            expectedMsgId = POLL_ACK;
+            transmitPoll(TransmitMode::DELAYED);
+            noteActivity();
+        }
+    }
+
+    if (receiveTimedOut) {
+        // no reply within RESPONSE_TIMEOUT_US, the receiver is already off
+        receiveTimedOut = false;
+        timeoutCount++;
+        expectedMsgId = POLL_ACK;
+        transmitPoll();
+        noteActivity();
     }
 
     if (receivedAck) {
         receivedAck = false;
-        DW1000Ng::getReceivedData(data, LEN_DATA);
+        frame_snapshot_t frame = DW1000Ng::readFrameSnapshot(data, LEN_DATA);
         byte msgId = data[0];
 
         if (msgId != expectedMsgId) {
@@ -166,24 +331,35 @@ void loop() {
 
         if (msgId == POLL_ACK) {
             timePollSent = DW1000Ng::getTransmitTimestamp();
-            timePollAckReceived = DW1000Ng::getReceiveTimestamp();
+            timePollAckReceived = frame.timestamp;
+#if defined(TWR_SINGLE_SIDED)
+            // nothing more to send: range, poll again, print while the POLL is out
+            float curRange = computeSingleSidedRange(frame);
+            expectedMsgId = POLL_ACK;
+            transmitPoll();
+            reportRange(curRange);
+#elif defined(TWR_REPORT_IN_POLL_ACK)
+            // the range of the previous exchange, if this POLL_ACK is its answer
+            float previousRange;
+            memcpy(&previousRange, data + POLL_ACK_REPORT_OFFSET, sizeof(previousRange));
+            boolean previousReported = rangeDue &&
+                memcmp(data + POLL_ACK_REPORT_OFFSET + sizeof(previousRange), rangeStamp, LEN_RANGE_STAMP) == 0;
+            expectedMsgId = POLL_ACK;
+            transmitRange();
+            // printed while the RANGE waits for its slot
+            if (previousReported) {
+                reportRange(previousRange);
+            }
+#else
             expectedMsgId = RANGE_REPORT;
             transmitRange();
+#endif
             noteActivity();
 
         } else if (msgId == RANGE_REPORT) {
-            rangeCount++;
             float curRange;
             memcpy(&curRange, data + 1, 4);
-            float distM = curRange * DISTANCE_OF_RADIO;
-
-            Serial.print(F("R#"));
-            Serial.print(rangeCount);
-            Serial.print(F(" "));
-            Serial.print(distM, 2);
-            Serial.println(F(" m"));
-
-            displayDistance(distM, rangeCount);
+            reportRange(curRange);
 
             expectedMsgId = POLL_ACK;
             transmitPoll();
@@ -205,6 +381,19 @@ void loop() {
         Serial.print(F(" ranges:"));
         Serial.print(rangeCount);
         Serial.print(F(" timeouts:"));
-        Serial.println(timeoutCount);
+        Serial.print(timeoutCount);
+        Serial.print(F(" reply:"));
+        Serial.print(DW1000Ng::getReplyDelay());
+        Serial.print(DW1000Ng::isReplyDelayTuning() ? F("us (tuning)") : F("us"));
+#ifdef TWR_SINGLE_SIDED
+        for (uint8_t i = 0; i < neighborCount; i++) {
+            Serial.print(F(" clock#"));
+            Serial.print(neighborAddress[i]);
+            Serial.print(F(":"));
+            Serial.print(neighborOffsetPpb[i]);
+            Serial.print(F("ppb"));
+        }
+#endif
+        Serial.println();
     }
 }
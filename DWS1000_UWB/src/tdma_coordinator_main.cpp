@@ -0,0 +1,417 @@
+/**
+ * TDMA Coordinator — DW1000-ng
+ *
+ * Runs the superframe of the TDMA swarm (tdma_node_main.cpp):
+ *   coordinator  BEACON (sequence, slot count, first slot, slot width, the
+ *                address of the node owning each slot)
+ *   node n       POLL at BEACON RX + first slot + n * slot width
+ *   coordinator  RESPONSE (reply time) TDMA_REPLY_DELAY_US after the POLL RX
+ *   new node     JOIN (its address) in the last slot, open to all
+ * Each node ranges once per superframe with single-sided TWR.
+ *
+ * Slots are handed out at run time: a JOIN takes the next free slot, listed
+ * in the following beacon, which also answers the JOIN. A JOIN for an address
+ * whose slot is still being polled is denied: another node has that address,
+ * and the joining node draws a new one. A slot that brought no POLL
+ * for TDMA_SLOT_TIMEOUT superframes is reclaimed and the ones after it move
+ * up, so the superframe is as long as the nodes present, not TDMA_MAX_SLOTS.
+ * Nodes look their slot up in every beacon, so a new node is only flashed
+ * with the same node firmware.
+ *
+ * Slots are timed on the DW1000 clocks, not millis(): the beacons go out
+ * exactly one superframe apart on this clock (delayed TX from the previous
+ * beacon), the nodes count from its RX timestamp. The slot width is the
+ * RESPONSE air time from DW1000Ng::getFrameDuration() plus the reply delay
+ * and TDMA_SLOT_GUARD_US (config.h), so it follows the radio configuration
+ * and the nodes take it from the beacon.
+ *
+ * Uses config.h for antenna delay and pin assignments.
+ * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgUtils.hpp>
+#include <DW1000NgRTLS.hpp>
+#include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
+#include "config.h"
+#include "display.h"
+
+// TDMA message types
+#define TDMA_BEACON 0x40
+#define TDMA_POLL 0x41
+#define TDMA_RESPONSE 0x42
+#define TDMA_JOIN 0x43
+#define MAX_SLOTS 16
+
+// TDMA_BEACON: type, superframe (DW1000NgRTLS::writeSuperframe()), then the
+// owner address of each node slot; the last slot, the JOIN slot, has none.
+// After a JOIN, the answer follows the owners: granted or denied, address.
+#define BEACON_SUPERFRAME_OFFSET 1
+#define BEACON_OWNERS_OFFSET (1 + LEN_SUPERFRAME)
+#define LEN_JOIN_ANSWER 3
+#define LEN_BEACON (BEACON_OWNERS_OFFSET + 2 * MAX_SLOTS + LEN_JOIN_ANSWER)
+#define JOIN_GRANTED 0x01
+#define JOIN_DENIED 0x02
+// TDMA_POLL: type, superframe sequence, slot, node address
+#define POLL_SEQUENCE_OFFSET 1
+#define POLL_SLOT_OFFSET 2
+#define POLL_ADDRESS_OFFSET 3
+#define LEN_POLL 5
+// TDMA_RESPONSE: type, superframe sequence, slot, reply time
+#define RESPONSE_SEQUENCE_OFFSET 1
+#define RESPONSE_REPLY_OFFSET 3
+#define LEN_REPLY_TIME 4
+#define LEN_RESPONSE 7
+// TDMA_JOIN: type, superframe sequence, node address
+#define JOIN_ADDRESS_OFFSET 2
+#define LEN_JOIN 4
+
+#if TDMA_MAX_SLOTS > MAX_SLOTS
+#error "TDMA_MAX_SLOTS is at most 16"
+#endif
+
+volatile boolean sentAck = false;
+volatile boolean receivedAck = false;
+volatile uint32_t sentAt;
+
+// Superframe
+Superframe superframe;
+uint32_t periodUs;                  // this beacon to the next
+uint32_t nextBeaconAt;              // micros() to start the next one
+boolean beaconInFlight = false;     // its TX done re-times nextBeaconAt
+
+// Slot table: slot i belongs to slotOwner[i], the next beacon lists them
+uint16_t slotOwner[MAX_SLOTS];
+uint8_t slotIdle[MAX_SLOTS];        // superframes since its last POLL
+boolean slotPolled[MAX_SLOTS];      // in the current superframe
+uint8_t ownerCount = 0;
+
+// Answer to the last JOIN, sent with the next beacon
+byte joinAnswer = 0;
+uint16_t joinAnswerAddress;
+uint16_t joinDeniedAddress;         // printed once while it keeps asking
+
+// Data buffer
+#define LEN_DATA LEN_BEACON
+byte data[LEN_DATA];
+
+// Frames staged in TX_BUFFER once
+const tx_template_t BEACON_FRAME = {0, LEN_BEACON};
+const tx_template_t RESPONSE_FRAME = {LEN_BEACON, LEN_RESPONSE};
+
+// Timing
+uint32_t lastActivity;
+uint32_t resetPeriod = 1000;
+
+// Stats
+uint32_t beaconCount = 0;
+uint32_t responseCount = 0;
+uint32_t joinCount = 0;
+uint32_t deniedCount = 0;
+uint32_t leaveCount = 0;
+uint32_t lateCount = 0;
+uint32_t resetCount = 0;
+
+device_configuration_t DEFAULT_CONFIG = {
+    false,                       // extendedFrameLength
+    true,                        // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
+    true,   // interruptOnSent, the beacon TX re-times the next one
+    true,   // interruptOnReceived
+    true,   // interruptOnReceiveFailed
+    false,  // interruptOnReceiveTimeout
+    true    // interruptOnReceiveTimestampAvailable
+};
+
+void handleSent() { sentAt = micros(); sentAck = true; }
+void handleReceived() { receivedAck = true; }
+void noteActivity() { lastActivity = millis(); }
+
+void receiver() {
+    DW1000Ng::forceTRxOff();
+    DW1000Ng::startReceive();
+}
+
+void resetInactive() {
+    resetCount++;
+    receiver();
+    noteActivity();
+}
+
+void stageFrames() {
+    memset(data, 0, LEN_BEACON);
+    data[0] = TDMA_BEACON;
+    DW1000Ng::writeTransmitTemplate(BEACON_FRAME, data);
+    memset(data, 0, LEN_RESPONSE);
+    data[0] = TDMA_RESPONSE;
+    DW1000Ng::writeTransmitTemplate(RESPONSE_FRAME, data);
+}
+
+void printSlots() {
+    Serial.print(F("("));
+    Serial.print(ownerCount);
+    Serial.print(F(" nodes, superframe "));
+    Serial.print(DW1000NgRTLS::getSuperframeDuration(superframe) + TDMA_BEACON_LEAD_US);
+    Serial.println(F(" us)"));
+}
+
+// A slot that brought no POLL for TDMA_SLOT_TIMEOUT superframes is given
+// back, the later ones move up and the superframe shrinks by a slot
+void reclaimSlots() {
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < ownerCount; i++) {
+        slotIdle[i] = slotPolled[i] ? 0 : slotIdle[i] + 1;
+        if (slotIdle[i] >= TDMA_SLOT_TIMEOUT) {
+            leaveCount++;
+            Serial.print(F("LEAVE "));
+            Serial.print(slotOwner[i], HEX);
+            Serial.print(F(" "));
+            continue;
+        }
+        slotOwner[kept] = slotOwner[i];
+        slotIdle[kept] = slotIdle[i];
+        kept++;
+    }
+    boolean changed = kept != ownerCount;
+    ownerCount = kept;
+    memset(slotPolled, 0, sizeof(slotPolled));
+    // one slot per node, and the JOIN slot
+    superframe.slotCount = ownerCount + 1;
+    if (changed) {
+        printSlots();
+    }
+}
+
+void answerJoin(byte answer, uint16_t address) {
+    joinAnswer = answer;
+    joinAnswerAddress = address;
+}
+
+void joinSlot(uint16_t address) {
+    if (address == 0 || address == 0xFFFF) {
+        return;
+    }
+    for (uint8_t i = 0; i < ownerCount; i++) {
+        if (slotOwner[i] != address) {
+            continue;
+        }
+        if (slotPolled[i] || slotIdle[i] == 0) {
+            // polled this superframe or the last: a second node with that address
+            if (deniedCount++ == 0 || address != joinDeniedAddress) {
+                Serial.print(F("JOIN "));
+                Serial.print(address, HEX);
+                Serial.println(F(" denied, address in use"));
+            }
+            joinDeniedAddress = address;
+            answerJoin(JOIN_DENIED, address);
+            return;
+        }
+        // the beacon granting it got lost, or the node restarted
+        answerJoin(JOIN_GRANTED, address);
+        return;
+    }
+    if (ownerCount == TDMA_MAX_SLOTS) {
+        // no answer, it tries again after its backoff
+        return;
+    }
+    answerJoin(JOIN_GRANTED, address);
+    slotOwner[ownerCount] = address;
+    slotIdle[ownerCount] = 0;
+    slotPolled[ownerCount] = false;
+    ownerCount++;
+    joinCount++;
+    Serial.print(F("JOIN "));
+    Serial.print(address, HEX);
+    Serial.print(F(" slot "));
+    Serial.println(ownerCount - 1);
+}
+
+// Beacons exactly one superframe apart on the DW1000 clock, each started
+// TDMA_BEACON_LEAD_US ahead, after the last slot
+void transmitBeacon() {
+    DW1000Ng::forceTRxOff();
+    reclaimSlots();
+    superframe.sequence++;
+    // timed from the previous beacon by the length it announced
+    uint64_t timeBeacon = DW1000Ng::scheduleReplyAfterRx(superframe.beaconTime, periodUs);
+    DW1000NgRTLS::writeSuperframe(superframe, data + BEACON_SUPERFRAME_OFFSET);
+    for (uint8_t i = 0; i < ownerCount; i++) {
+        DW1000NgUtils::writeValueToBytes(data + BEACON_OWNERS_OFFSET + 2 * i, slotOwner[i], 2);
+    }
+    tx_template_t beaconFrame = {BEACON_FRAME.bufferOffset, (uint16_t)(BEACON_OWNERS_OFFSET + 2 * ownerCount)};
+    if (joinAnswer != 0) {
+        data[beaconFrame.length] = joinAnswer;
+        DW1000NgUtils::writeValueToBytes(data + beaconFrame.length + 1, joinAnswerAddress, 2);
+        beaconFrame.length += LEN_JOIN_ANSWER;
+        joinAnswer = 0;
+    }
+    DW1000Ng::patchTransmitTemplate(beaconFrame, BEACON_SUPERFRAME_OFFSET, data + BEACON_SUPERFRAME_OFFSET,
+        beaconFrame.length - BEACON_SUPERFRAME_OFFSET);
+    DW1000Ng::selectTransmitTemplate(beaconFrame);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    periodUs = DW1000NgRTLS::getSuperframeDuration(superframe) + TDMA_BEACON_LEAD_US;
+    // until the TX done tells better, micros() runs on its own crystal
+    nextBeaconAt += periodUs;
+    if (DW1000Ng::isTransmitLate()) {
+        // lost the beat: start a new one from now
+        lateCount++;
+        superframe.beaconTime = DW1000Ng::getSystemTimestamp();
+        nextBeaconAt = micros() + periodUs - TDMA_BEACON_LEAD_US;
+        DW1000Ng::startReceive();
+        return;
+    }
+    superframe.beaconTime = timeBeacon;
+    beaconInFlight = true;
+    beaconCount++;
+}
+
+void transmitResponse(const frame_snapshot_t& frame) {
+    uint8_t slot = data[POLL_SLOT_OFFSET];
+    uint16_t address = DW1000NgUtils::bytesAsValue(data + POLL_ADDRESS_OFFSET, 2);
+    if (data[POLL_SEQUENCE_OFFSET] != superframe.sequence || slot >= superframe.slotCount - 1 ||
+        slotOwner[slot] != address) {
+        // a POLL of another superframe, its slot is over, or of a reclaimed slot
+        DW1000Ng::startReceive();
+        return;
+    }
+    slotPolled[slot] = true;
+    uint64_t timeResponseSent = DW1000Ng::scheduleReplyAfterRx(frame.timestamp, TDMA_REPLY_DELAY_US);
+    byte reply[2 + LEN_REPLY_TIME];
+    reply[0] = superframe.sequence;
+    reply[1] = slot;
+    DW1000NgUtils::writeValueToBytes(reply + 2, (timeResponseSent - frame.timestamp) & TIME_MAX, LEN_REPLY_TIME);
+    DW1000Ng::patchTransmitTemplate(RESPONSE_FRAME, RESPONSE_SEQUENCE_OFFSET, reply, sizeof(reply));
+    DW1000Ng::selectTransmitTemplate(RESPONSE_FRAME);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    if (DW1000Ng::isTransmitLate()) {
+        lateCount++;
+        DW1000Ng::startReceive();
+        return;
+    }
+    responseCount++;
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    displayInit();
+
+    Serial.println(F("\n=== TDMA Coordinator ==="));
+
+    DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
+    DW1000Ng::applyConfiguration(DEFAULT_CONFIG);
+    DW1000Ng::applyInterruptConfiguration(DEFAULT_INTERRUPT_CONFIG);
+
+    DW1000Ng::setDeviceAddress(1);
+    DW1000Ng::setNetworkId(10);
+    DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+    // listening again right after every beacon and RESPONSE
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+
+    // no node yet, the JOIN slot only
+    superframe.sequence = 0;
+    superframe.slotCount = 1;
+    superframe.firstSlotUs = TDMA_FIRST_SLOT_US;
+    superframe.slotUs = DW1000NgRTLS::getSlotWidth(LEN_RESPONSE, TDMA_REPLY_DELAY_US, TDMA_SLOT_GUARD_US);
+    periodUs = DW1000NgRTLS::getSuperframeDuration(superframe) + TDMA_BEACON_LEAD_US;
+    stageFrames();
+
+    char msg[128];
+    DW1000Ng::getPrintableDeviceIdentifier(msg);
+    Serial.print(F("Device: ")); Serial.println(msg);
+    DW1000Ng::getPrintableDeviceMode(msg);
+    Serial.print(F("Mode: ")); Serial.println(msg);
+    Serial.print(F("Antenna delay: ")); Serial.println(ANTENNA_DELAY);
+    Serial.print(F("Slots: up to ")); Serial.print(TDMA_MAX_SLOTS);
+    Serial.print(F("  slot: ")); Serial.print(superframe.slotUs);
+    Serial.println(F(" us"));
+
+    DW1000Ng::attachSentHandler(handleSent);
+    DW1000Ng::attachReceivedHandler(handleReceived);
+
+    Serial.println(F("Beaconing...\n"));
+    displayStatus("TDMA COORD", "Beaconing...");
+
+    receiver();
+    noteActivity();
+    superframe.beaconTime = DW1000Ng::getSystemTimestamp();
+    nextBeaconAt = micros() + periodUs - TDMA_BEACON_LEAD_US;
+}
+
+void loop() {
+    static uint32_t lastReport = 0;
+
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
+
+    if ((int32_t)(micros() - nextBeaconAt) >= 0) {
+        transmitBeacon();
+        noteActivity();
+    }
+
+    if (sentAck) {
+        sentAck = false;
+        if (beaconInFlight) {
+            // the beacon just went out: the next one is a period after it
+            beaconInFlight = false;
+            nextBeaconAt = sentAt + periodUs - TDMA_BEACON_LEAD_US;
+        }
+    }
+
+    if (receivedAck) {
+        receivedAck = false;
+        frame_snapshot_t frame = DW1000Ng::readFrameSnapshot(data, LEN_DATA);
+        if (data[0] == TDMA_POLL && frame.length >= LEN_POLL) {
+            transmitResponse(frame);
+        } else {
+            DW1000Ng::startReceive();
+            if (data[0] == TDMA_JOIN && frame.length >= LEN_JOIN) {
+                joinSlot(DW1000NgUtils::bytesAsValue(data + JOIN_ADDRESS_OFFSET, 2));
+            }
+        }
+        noteActivity();
+    } else if (millis() - lastActivity > resetPeriod) {
+        resetInactive();
+    }
+
+    if (millis() - lastReport >= 10000) {
+        lastReport = millis();
+        Serial.print(F("["));
+        Serial.print(millis() / 1000);
+        Serial.print(F("s] beacons:"));
+        Serial.print(beaconCount);
+        Serial.print(F(" responses:"));
+        Serial.print(responseCount);
+        Serial.print(F(" nodes:"));
+        Serial.print(ownerCount);
+        Serial.print(F(" joins:"));
+        Serial.print(joinCount);
+        Serial.print(F(" denied:"));
+        Serial.print(deniedCount);
+        Serial.print(F(" leaves:"));
+        Serial.print(leaveCount);
+        Serial.print(F(" late:"));
+        Serial.print(lateCount);
+        Serial.print(F(" reset:"));
+        Serial.println(resetCount);
+    }
+}
@@ -0,0 +1,418 @@
+/**
+ * TDMA Node — DW1000-ng
+ *
+ * Ranges against the TDMA coordinator (tdma_coordinator_main.cpp) once per
+ * superframe, in its own slot:
+ *   coordinator  BEACON (sequence, slot count, first slot, slot width, slot owners)
+ *   node         POLL, delayed TX at BEACON RX + first slot + slot * slot width
+ *   coordinator  RESPONSE (reply time) TDMA_REPLY_DELAY_US after the POLL RX
+ * The range is single-sided TWR: the coordinator's reply time is scaled to
+ * this clock with its offset from the carrier integrator.
+ *
+ * The slot is timed from the beacon RX timestamp on the DW1000 clock, so it
+ * needs no guard for millis() drift: a few microseconds, not milliseconds.
+ *
+ * The slot is the position of our address in the beacon's owner list, looked
+ * up in every beacon since it moves up when a node before it leaves. Until a
+ * beacon grants our own JOIN, a listed address may be another node's, so the
+ * node sends a JOIN in the last slot, after a random backoff of up to
+ * TDMA_JOIN_BACKOFF superframes in case another node joins too.
+ *
+ * Every node runs the same build. The short address is folded from the part
+ * and lot ID in the chip's OTP, or set with NODE_ADDRESS:
+ *   PLATFORMIO_BUILD_FLAGS="-D NODE_ADDRESS=0x0102" pio run -e uno_tdma_node
+ * A JOIN denied because another node polls with that address makes the node
+ * fold a new one; with NODE_ADDRESS it keeps asking until the other leaves.
+ *
+ * Uses config.h for antenna delay and pin assignments.
+ * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgUtils.hpp>
+#include <DW1000NgRanging.hpp>
+#include <DW1000NgRTLS.hpp>
+#include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
+#include "config.h"
+#include "display.h"
+
+// TDMA message types, see tdma_coordinator_main.cpp for the layouts
+#define TDMA_BEACON 0x40
+#define TDMA_POLL 0x41
+#define TDMA_RESPONSE 0x42
+#define TDMA_JOIN 0x43
+#define MAX_SLOTS 16
+
+#define BEACON_SUPERFRAME_OFFSET 1
+#define BEACON_OWNERS_OFFSET (1 + LEN_SUPERFRAME)
+#define LEN_JOIN_ANSWER 3
+#define LEN_BEACON (BEACON_OWNERS_OFFSET + 2 * MAX_SLOTS + LEN_JOIN_ANSWER)
+#define JOIN_GRANTED 0x01
+#define JOIN_DENIED 0x02
+#define POLL_SEQUENCE_OFFSET 1
+#define POLL_SLOT_OFFSET 2
+#define POLL_ADDRESS_OFFSET 3
+#define LEN_POLL 5
+#define RESPONSE_SEQUENCE_OFFSET 1
+#define RESPONSE_SLOT_OFFSET 2
+#define RESPONSE_REPLY_OFFSET 3
+#define LEN_REPLY_TIME 4
+#define LEN_RESPONSE 7
+#define JOIN_SEQUENCE_OFFSET 1
+#define JOIN_ADDRESS_OFFSET 2
+#define LEN_JOIN 4
+#define NO_SLOT 0xFF
+
+#define CLOCK_OFFSET_SMOOTHING 3   // each RESPONSE moves the estimate by 1/8
+
+volatile boolean receivedAck = false;
+
+// Superframe and the exchange in our slot
+uint16_t address;
+uint8_t addressSalt = 0;            // new addresses drawn after a denied JOIN
+Superframe superframe;
+uint8_t slot = NO_SLOT;             // from the last beacon
+boolean joined = false;             // a beacon granted our JOIN
+boolean joinSent = false;           // JOIN out, the next beacon answers it
+uint8_t joinBackoff = 0;            // superframes to skip before the next JOIN
+boolean polled = false;             // POLL out, RESPONSE due
+uint64_t timePollSent;
+int32_t clockOffsetPpb;
+boolean clockOffsetKnown = false;
+
+// Data buffer
+#define LEN_DATA LEN_BEACON
+byte data[LEN_DATA];
+
+// Staged once, the sequence and slot patched in
+const tx_template_t POLL_FRAME = {0, LEN_POLL};
+const tx_template_t JOIN_FRAME = {LEN_POLL, LEN_JOIN};
+
+// Timing
+uint32_t lastActivity;
+uint32_t resetPeriod = 1000;
+
+// Stats
+uint32_t beaconCount = 0;
+uint32_t joinCount = 0;
+uint32_t deniedCount = 0;
+uint32_t rangeCount = 0;
+uint32_t missedCount = 0;
+uint32_t lateCount = 0;
+uint32_t resetCount = 0;
+
+device_configuration_t DEFAULT_CONFIG = {
+    false,                       // extendedFrameLength
+    true,                        // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
+    false,  // interruptOnSent
+    true,   // interruptOnReceived
+    true,   // interruptOnReceiveFailed
+    false,  // interruptOnReceiveTimeout
+    true    // interruptOnReceiveTimestampAvailable
+};
+
+void handleReceived() { receivedAck = true; }
+void noteActivity() { lastActivity = millis(); }
+
+void receiver() {
+    DW1000Ng::forceTRxOff();
+    DW1000Ng::startReceive();
+}
+
+void resetInactive() {
+    resetCount++;
+    polled = false;
+    receiver();
+    noteActivity();
+}
+
+// Own buffer, so a new address can be staged while data holds a beacon
+void stageFrames() {
+    byte frame[LEN_POLL];
+    memset(frame, 0, LEN_POLL);
+    frame[0] = TDMA_POLL;
+    DW1000NgUtils::writeValueToBytes(frame + POLL_ADDRESS_OFFSET, address, 2);
+    DW1000Ng::writeTransmitTemplate(POLL_FRAME, frame);
+    memset(frame, 0, LEN_JOIN);
+    frame[0] = TDMA_JOIN;
+    DW1000NgUtils::writeValueToBytes(frame + JOIN_ADDRESS_OFFSET, address, 2);
+    DW1000Ng::writeTransmitTemplate(JOIN_FRAME, frame);
+}
+
+// The part and lot ID tell chips apart where the clock at power up does not:
+// after reset it reads nearly the same on every node. Each denied JOIN salts
+// the fold once more. False if the OTP is blank and there is nothing to fold.
+boolean drawAddress() {
+#ifdef NODE_ADDRESS
+    address = NODE_ADDRESS;
+#else
+    uint32_t partId, lotId;
+    DW1000Ng::getPartAndLotId(partId, lotId);
+    if (partId == 0 && lotId == 0) {
+        return false;
+    }
+    uint32_t id = partId ^ (lotId * 0x9E3779B1UL) ^ (addressSalt++ * 0x85EBCA6BUL);
+    address = (uint16_t)(id ^ (id >> 16));
+    if (address == 0 || address == 0xFFFF) {
+        address ^= 0x5A5A;
+    }
+#endif
+    DW1000Ng::setDeviceAddress(address);
+    return true;
+}
+
+// The JOIN answer after the owner list, if it is for our address
+byte readJoinAnswer(const frame_snapshot_t& frame) {
+    uint8_t end = BEACON_OWNERS_OFFSET + 2 * (superframe.slotCount - 1);
+    if (superframe.slotCount == 0 || superframe.slotCount > MAX_SLOTS + 1 ||
+        frame.length < end + LEN_JOIN_ANSWER ||
+        DW1000NgUtils::bytesAsValue(data + end + 1, 2) != address) {
+        return 0;
+    }
+    return data[end];
+}
+
+// Our slot in the beacon just read, NO_SLOT if it lists no slot of ours
+uint8_t findSlot(const frame_snapshot_t& frame) {
+    if (superframe.slotCount == 0 || superframe.slotCount > MAX_SLOTS + 1) {
+        return NO_SLOT;
+    }
+    uint8_t owners = superframe.slotCount - 1;
+    if (frame.length < BEACON_OWNERS_OFFSET + 2 * owners) {
+        return NO_SLOT;
+    }
+    for (uint8_t i = 0; i < owners; i++) {
+        if (DW1000NgUtils::bytesAsValue(data + BEACON_OWNERS_OFFSET + 2 * i, 2) == address) {
+            return i;
+        }
+    }
+    return NO_SLOT;
+}
+
+// In the last slot, open to every node without one
+void transmitJoin() {
+    if (joinBackoff > 0) {
+        joinBackoff--;
+        DW1000Ng::startReceive();
+        return;
+    }
+    joinBackoff = random(TDMA_JOIN_BACKOFF + 1);
+    DW1000NgRTLS::scheduleSlot(superframe, superframe.slotCount - 1);
+    DW1000Ng::patchTransmitTemplate(JOIN_FRAME, JOIN_SEQUENCE_OFFSET, &superframe.sequence, 1);
+    DW1000Ng::selectTransmitTemplate(JOIN_FRAME);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    if (DW1000Ng::isTransmitLate()) {
+        lateCount++;
+        DW1000Ng::startReceive();
+        return;
+    }
+    // listening again after it, WAIT4RESP
+    joinSent = true;
+    joinCount++;
+}
+
+void handleBeacon(const frame_snapshot_t& frame) {
+    if (polled) {
+        // the RESPONSE of the last superframe never came
+        missedCount++;
+        polled = false;
+    }
+    DW1000NgRTLS::readSuperframe(superframe, data + BEACON_SUPERFRAME_OFFSET, frame.timestamp);
+    beaconCount++;
+    if (joinSent) {
+        // no answer: the JOIN was lost, sent again after the backoff
+        joinSent = false;
+        byte answer = readJoinAnswer(frame);
+        if (answer == JOIN_GRANTED) {
+            joined = true;
+        } else if (answer == JOIN_DENIED) {
+            deniedCount++;
+#ifdef NODE_ADDRESS
+            if (deniedCount == 1) {
+                Serial.println(F("JOIN denied, NODE_ADDRESS in use, waiting for its slot"));
+            }
+#else
+            Serial.print(F("JOIN denied, "));
+            Serial.print(address, HEX);
+            drawAddress();
+            stageFrames();
+            Serial.print(F(" in use, now "));
+            Serial.println(address, HEX);
+#endif
+        }
+    }
+    uint8_t granted = joined ? findSlot(frame) : NO_SLOT;
+    // reclaimed, or never ours: JOIN (again)
+    joined = granted != NO_SLOT;
+    if (granted != slot) {
+        slot = granted;
+        Serial.print(F("SLOT "));
+        if (slot == NO_SLOT) {
+            Serial.println(F("none"));
+        } else {
+            Serial.print(slot);
+            Serial.print(F(" of "));
+            Serial.println(superframe.slotCount - 1);
+        }
+    }
+    if (slot == NO_SLOT) {
+        transmitJoin();
+        return;
+    }
+    timePollSent = DW1000NgRTLS::scheduleSlot(superframe, slot);
+    byte poll[2] = {superframe.sequence, slot};
+    DW1000Ng::patchTransmitTemplate(POLL_FRAME, POLL_SEQUENCE_OFFSET, poll, sizeof(poll));
+    DW1000Ng::selectTransmitTemplate(POLL_FRAME);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    if (DW1000Ng::isTransmitLate()) {
+        // missed the slot, sit this superframe out
+        lateCount++;
+        DW1000Ng::startReceive();
+        return;
+    }
+    polled = true;
+}
+
+void computeRange(const frame_snapshot_t& frame) {
+    polled = false;
+    int32_t offsetPpb = DW1000Ng::getClockOffsetPpb();
+    if (!clockOffsetKnown) {
+        clockOffsetPpb = offsetPpb;
+        clockOffsetKnown = true;
+    } else {
+        clockOffsetPpb += (offsetPpb - clockOffsetPpb) / (1 << CLOCK_OFFSET_SMOOTHING);
+    }
+    uint64_t replyTime = DW1000NgUtils::bytesAsValue(data + RESPONSE_REPLY_OFFSET, LEN_REPLY_TIME);
+    // only the reply time counts, so POLL RX is 0 and RESPONSE TX is the reply time
+    double distance = DW1000NgRanging::computeRangeSingleSided(
+        timePollSent, 0, replyTime, frame.timestamp, clockOffsetPpb);
+    int16_t rxPower = DW1000Ng::getReceivePowerQ8(frame);
+    distance = DW1000NgRanging::correctRange(distance, rxPower);
+
+    rangeCount++;
+    Serial.print(F("S#"));
+    Serial.print(superframe.sequence);
+    Serial.print(F(" dist="));
+    Serial.print(distance, 2);
+    Serial.print(F(" m  pwr="));
+    Serial.print(rxPower / 256.0f, 1);
+    Serial.println(F(" dBm"));
+
+    displayDistance(distance, rangeCount);
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    displayInit();
+
+    Serial.println(F("\n=== TDMA Node ==="));
+
+    DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
+    DW1000Ng::applyConfiguration(DEFAULT_CONFIG);
+    DW1000Ng::applyInterruptConfiguration(DEFAULT_INTERRUPT_CONFIG);
+
+    if (!drawAddress()) {
+        Serial.println(F("No part/lot ID in OTP, build with -D NODE_ADDRESS=0x...."));
+        displayStatus("TDMA NODE", "No address");
+        while (true) {
+            delay(1000);
+        }
+    }
+    // JOIN backoffs differ between nodes as their addresses do
+    randomSeed(address);
+    DW1000Ng::setNetworkId(10);
+    DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+    // the receiver comes on by itself after the POLL
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+    stageFrames();
+
+    char msg[128];
+    DW1000Ng::getPrintableDeviceIdentifier(msg);
+    Serial.print(F("Device: ")); Serial.println(msg);
+    DW1000Ng::getPrintableDeviceMode(msg);
+    Serial.print(F("Mode: ")); Serial.println(msg);
+    Serial.print(F("Antenna delay: ")); Serial.println(ANTENNA_DELAY);
+    Serial.print(F("Address: ")); Serial.println(address, HEX);
+
+    DW1000Ng::attachReceivedHandler(handleReceived);
+
+    Serial.println(F("Joining...\n"));
+    displayStatus("TDMA NODE", "Joining...");
+
+    receiver();
+    noteActivity();
+}
+
+void loop() {
+    static uint32_t lastReport = 0;
+
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
+
+    if (!receivedAck) {
+        if (millis() - lastActivity > resetPeriod) {
+            resetInactive();
+        }
+        return;
+    }
+
+    receivedAck = false;
+    frame_snapshot_t frame = DW1000Ng::readFrameSnapshot(data, LEN_DATA);
+
+    if (data[0] == TDMA_BEACON && frame.length >= BEACON_OWNERS_OFFSET) {
+        handleBeacon(frame);
+        noteActivity();
+    } else if (data[0] == TDMA_RESPONSE && frame.length >= LEN_RESPONSE && polled &&
+               data[RESPONSE_SEQUENCE_OFFSET] == superframe.sequence &&
+               data[RESPONSE_SLOT_OFFSET] == slot) {
+        // back to listening first, the next beacon is less than a superframe away
+        DW1000Ng::startReceive();
+        computeRange(frame);
+    } else {
+        // POLL or RESPONSE of another slot
+        DW1000Ng::startReceive();
+    }
+
+    if (millis() - lastReport >= 10000) {
+        lastReport = millis();
+        Serial.print(F("["));
+        Serial.print(millis() / 1000);
+        Serial.print(F("s] beacons:"));
+        Serial.print(beaconCount);
+        Serial.print(F(" joins:"));
+        Serial.print(joinCount);
+        Serial.print(F(" denied:"));
+        Serial.print(deniedCount);
+        Serial.print(F(" ranges:"));
+        Serial.print(rangeCount);
+        Serial.print(F(" missed:"));
+        Serial.print(missedCount);
+        Serial.print(F(" late:"));
+        Serial.print(lateCount);
+        Serial.print(F(" clock:"));
+        Serial.print(clockOffsetPpb);
+        Serial.print(F("ppb reset:"));
+        Serial.println(resetCount);
+    }
+}
@@ -0,0 +1,268 @@
+/**
+ * TDOA Anchor — DW1000-ng
+ *
+ * Time difference of arrival: tags only blink (tdoa_tag_main.cpp), anchors
+ * timestamp every blink on a common time base and a host-side solver
+ * (host/tdoa/tdoa_solver.cpp) turns the differences into positions.
+ *
+ *   anchor 0  reference: SYNC beacon every TDOA_SYNC_PERIOD_MS, carrying its
+ *             own TX timestamp; its clock is the common time base
+ *   anchor n  keeps a clock model (offset and skew) against the reference
+ *             from the beacons, DW1000NgRTLS::updateClockModel()
+ *   all       print each blink in reference time, one line per blink:
+ *             TDOA <anchor> <tag EUI> <sequence> <reference time, hex ticks>
+ *
+ * A tag costs one blink per position update, whatever the number of anchors.
+ *
+ * ANCHOR_INDEX (0-15) picks the anchor, 0 is the reference:
+ *   PLATFORMIO_BUILD_FLAGS="-D ANCHOR_INDEX=2" pio run -e uno_tdoa_anchor
+ *
+ * Uses config.h for antenna delay and pin assignments.
+ * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgUtils.hpp>
+#include <DW1000NgRTLS.hpp>
+#include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
+#include "config.h"
+#include "display.h"
+
+#ifndef ANCHOR_INDEX
+#define ANCHOR_INDEX 0
+#endif
+#define REFERENCE_ANCHOR (ANCHOR_INDEX == 0)
+
+// SYNC: type, sequence, TX timestamp (reference clock)
+#define SYNC 0x30
+#define SYNC_SEQUENCE_OFFSET 1
+#define SYNC_TIME_OFFSET 2
+#define LEN_SYNC 7
+// Blink of DW1000NgRTLS::transmitTwrShortBlink(): frame control, sequence, EUI
+#define BLINK_SEQUENCE_OFFSET 1
+#define BLINK_EUI_OFFSET 2
+#define LEN_BLINK_EUI 8
+#define LEN_BLINK 12
+
+volatile boolean sentAck = false;
+volatile boolean receivedAck = false;
+volatile uint32_t sentAt;
+
+// Reference clock
+ClockModel clockModel;
+byte syncSequence = 0;
+uint64_t timeSyncSent;              // reference: of the last beacon
+uint32_t nextSyncAt;                // reference: micros() to start the next one
+boolean syncInFlight = false;       // reference: its TX done re-times nextSyncAt
+
+// Data buffer
+#define LEN_DATA 16
+byte data[LEN_DATA];
+
+const tx_template_t SYNC_FRAME = {0, LEN_SYNC};
+
+// Timing
+uint32_t lastActivity;
+uint32_t resetPeriod = 1000;
+
+// Stats
+uint32_t blinkCount = 0;
+uint32_t syncCount = 0;
+uint32_t unsyncedCount = 0;
+uint32_t lateCount = 0;
+uint32_t resetCount = 0;
+
+device_configuration_t DEFAULT_CONFIG = {
+    false,                       // extendedFrameLength
+    true,                        // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
+    true,   // interruptOnSent, the reference's beacon TX re-times the next one
+    true,   // interruptOnReceived
+    true,   // interruptOnReceiveFailed
+    false,  // interruptOnReceiveTimeout
+    true    // interruptOnReceiveTimestampAvailable
+};
+
+void handleSent() { sentAt = micros(); sentAck = true; }
+void handleReceived() { receivedAck = true; }
+void noteActivity() { lastActivity = millis(); }
+
+void receiver() {
+    DW1000Ng::forceTRxOff();
+    DW1000Ng::startReceive();
+}
+
+void resetInactive() {
+    resetCount++;
+    receiver();
+    noteActivity();
+}
+
+// Reference: beacons exactly TDOA_SYNC_PERIOD_MS apart on its own clock, each
+// started TDOA_SYNC_LEAD_US ahead so the receiver is off only that long
+void transmitSync() {
+    DW1000Ng::forceTRxOff();
+    syncSequence++;
+    // timed from the previous beacon, a TX timestamp the caller holds
+    uint64_t timeSync = DW1000Ng::scheduleReplyAfterRx(timeSyncSent, TDOA_SYNC_PERIOD_MS * 1000UL);
+    byte sync[LEN_SYNC - 1];
+    sync[0] = syncSequence;
+    DW1000NgUtils::writeValueToBytes(sync + 1, timeSync, LENGTH_TIMESTAMP);
+    DW1000Ng::patchTransmitTemplate(SYNC_FRAME, SYNC_SEQUENCE_OFFSET, sync, sizeof(sync));
+    DW1000Ng::selectTransmitTemplate(SYNC_FRAME);
+    DW1000Ng::startTransmit(TransmitMode::DELAYED);
+    // until the TX done tells better, micros() runs on its own crystal
+    nextSyncAt += TDOA_SYNC_PERIOD_MS * 1000UL;
+    if (DW1000Ng::isTransmitLate()) {
+        // lost the beat: start a new one from now
+        lateCount++;
+        timeSyncSent = DW1000Ng::getSystemTimestamp();
+        nextSyncAt = micros() + TDOA_SYNC_PERIOD_MS * 1000UL - TDOA_SYNC_LEAD_US;
+        DW1000Ng::startReceive();
+        return;
+    }
+    timeSyncSent = timeSync;
+    syncInFlight = true;
+    syncCount++;
+}
+
+void reportBlink(uint64_t referenceTime) {
+    blinkCount++;
+    char line[64];
+    char* p = line + sprintf(line, "TDOA %d ", ANCHOR_INDEX);
+    for (int8_t i = LEN_BLINK_EUI - 1; i >= 0; i--) {
+        p += sprintf(p, "%02X", data[BLINK_EUI_OFFSET + i]);
+    }
+    // 40 bit time in hex, the AVR printf has no 64 bit conversion
+    sprintf(p, " %u %02X%08lX", data[BLINK_SEQUENCE_OFFSET],
+            (unsigned)(referenceTime >> 32), (unsigned long)(referenceTime & 0xFFFFFFFFUL));
+    Serial.println(line);
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    displayInit();
+
+    Serial.println(F("\n=== TDOA Anchor ==="));
+
+    DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
+    DW1000Ng::applyConfiguration(DEFAULT_CONFIG);
+    DW1000Ng::applyInterruptConfiguration(DEFAULT_INTERRUPT_CONFIG);
+
+    DW1000Ng::setDeviceAddress(1 + ANCHOR_INDEX);
+    DW1000Ng::setNetworkId(10);
+    DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+    // the reference listens again right after its beacon
+    DW1000Ng::setWait4Response(RESPONSE_RX_DELAY_US);
+
+    memset(data, 0, LEN_DATA);
+    data[0] = SYNC;
+    DW1000Ng::writeTransmitTemplate(SYNC_FRAME, data);
+
+    char msg[128];
+    DW1000Ng::getPrintableDeviceIdentifier(msg);
+    Serial.print(F("Device: ")); Serial.println(msg);
+    DW1000Ng::getPrintableDeviceMode(msg);
+    Serial.print(F("Mode: ")); Serial.println(msg);
+    Serial.print(F("Antenna delay: ")); Serial.println(ANTENNA_DELAY);
+    Serial.print(F("Anchor: ")); Serial.print(ANCHOR_INDEX);
+    Serial.println(REFERENCE_ANCHOR ? F(" (reference)") : F(""));
+
+    DW1000Ng::attachSentHandler(handleSent);
+    DW1000Ng::attachReceivedHandler(handleReceived);
+
+    Serial.println(F("Listening for blinks...\n"));
+    displayStatus("TDOA ANCHOR", "Listening...");
+
+    receiver();
+    noteActivity();
+    if (REFERENCE_ANCHOR) {
+        timeSyncSent = DW1000Ng::getSystemTimestamp();
+        nextSyncAt = micros() + TDOA_SYNC_PERIOD_MS * 1000UL - TDOA_SYNC_LEAD_US;
+    }
+}
+
+void loop() {
+    static uint32_t lastReport = 0;
+
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
+
+    if (REFERENCE_ANCHOR && (int32_t)(micros() - nextSyncAt) >= 0) {
+        transmitSync();
+        noteActivity();
+    }
+
+    if (sentAck) {
+        sentAck = false;
+        if (syncInFlight) {
+            // the beacon just went out: the next one is a period after it
+            syncInFlight = false;
+            nextSyncAt = sentAt + TDOA_SYNC_PERIOD_MS * 1000UL - TDOA_SYNC_LEAD_US;
+        }
+    }
+
+    if (!receivedAck) {
+        if (millis() - lastActivity > resetPeriod) {
+            resetInactive();
+        }
+        return;
+    }
+
+    receivedAck = false;
+    frame_snapshot_t frame = DW1000Ng::readFrameSnapshot(data, LEN_DATA);
+    DW1000Ng::startReceive();
+    noteActivity();
+
+    if (data[0] == SYNC && frame.length >= LEN_SYNC && !REFERENCE_ANCHOR) {
+        DW1000NgRTLS::updateClockModel(clockModel, frame.timestamp,
+            DW1000NgUtils::bytesAsValue(data + SYNC_TIME_OFFSET, LENGTH_TIMESTAMP));
+        syncCount++;
+    } else if (data[0] == BLINK && frame.length >= LEN_BLINK) {
+        if (REFERENCE_ANCHOR) {
+            reportBlink(frame.timestamp);
+        } else if (clockModel.valid) {
+            reportBlink(DW1000NgRTLS::toReferenceTime(clockModel, frame.timestamp));
+        } else {
+            unsyncedCount++;
+        }
+    }
+
+    if (millis() - lastReport >= 10000) {
+        lastReport = millis();
+        Serial.print(F("["));
+        Serial.print(millis() / 1000);
+        Serial.print(F("s] blinks:"));
+        Serial.print(blinkCount);
+        Serial.print(F(" syncs:"));
+        Serial.print(syncCount);
+        Serial.print(F(" unsynced:"));
+        Serial.print(unsyncedCount);
+        Serial.print(F(" late:"));
+        Serial.print(lateCount);
+        Serial.print(F(" skew:"));
+        Serial.print(clockModel.skewPpb);
+        Serial.print(F("ppb reset:"));
+        Serial.println(resetCount);
+    }
+}
@@ -0,0 +1,145 @@
+/**
+ * TDOA Tag — DW1000-ng
+ *
+ * Time difference of arrival: the tag only blinks, one frame per position
+ * update and no receiver at all. The anchors (tdoa_anchor_main.cpp) time the
+ * blink on the reference clock, the host solver turns the differences into a
+ * position.
+ *
+ * Blinks go out every TDOA_BLINK_PERIOD_MS plus a random jitter of up to
+ * TDOA_BLINK_JITTER_MS, so two tags on the same period do not collide on
+ * every blink.
+ *
+ * TAG_INDEX (0-255) is the last byte of the EUI, build each tag with its own:
+ *   PLATFORMIO_BUILD_FLAGS="-D TAG_INDEX=2" pio run -e uno_tdoa_tag
+ *
+ * Uses config.h for antenna delay and pin assignments.
+ * DWS1000 shield: PIN_RST=7, D8->D2 wire for IRQ.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <DW1000Ng.hpp>
+#include <DW1000NgUtils.hpp>
+#include <DW1000NgRTLS.hpp>
+#include <DW1000NgConstants.hpp>
+#include <SPIporting.hpp>
+#include "config.h"
+#include "display.h"
+
+#ifndef TAG_INDEX
+#define TAG_INDEX 1
+#endif
+
+volatile boolean sentAck = false;
+
+// Timing
+uint32_t nextBlinkAt;
+
+// Stats
+uint32_t blinkCount = 0;
+uint32_t busyCount = 0;
+
+device_configuration_t DEFAULT_CONFIG = {
+    false,                       // extendedFrameLength
+    false,                       // receiverAutoReenable
+    true,                        // smartPower
+    true,                        // frameCheck
+    false,                       // nlos
+    SFDMode::STANDARD_SFD,       // sfd
+    Channel::CHANNEL_5,          // channel
+    DataRate::RATE_850KBPS,      // dataRate
+    PulseFrequency::FREQ_16MHZ,  // pulseFreq
+    PreambleLength::LEN_256,     // preambleLen
+    PreambleCode::CODE_3         // preaCode
+};
+
+interrupt_configuration_t DEFAULT_INTERRUPT_CONFIG = {
+    true,   // interruptOnSent
+    false,  // interruptOnReceived
+    false,  // interruptOnReceiveFailed
+    false,  // interruptOnReceiveTimeout
+    false   // interruptOnReceiveTimestampAvailable
+};
+
+void handleSent() { sentAck = true; }
+
+void scheduleBlink() {
+    nextBlinkAt += TDOA_BLINK_PERIOD_MS + random(TDOA_BLINK_JITTER_MS + 1);
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(1000);
+
+    displayInit();
+
+    Serial.println(F("\n=== TDOA Tag ==="));
+
+    DW1000Ng::initialize(SS, PIN_IRQ, PIN_RST);
+    DW1000Ng::applyConfiguration(DEFAULT_CONFIG);
+    DW1000Ng::applyInterruptConfiguration(DEFAULT_INTERRUPT_CONFIG);
+
+    byte eui[8] = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00, TAG_INDEX};
+    DW1000Ng::setEUI(eui);
+    DW1000Ng::setNetworkId(10);
+    DW1000Ng::setAntennaDelay(ANTENNA_DELAY);
+
+    char msg[128];
+    DW1000Ng::getPrintableDeviceIdentifier(msg);
+    Serial.print(F("Device: ")); Serial.println(msg);
+    DW1000Ng::getPrintableDeviceMode(msg);
+    Serial.print(F("Mode: ")); Serial.println(msg);
+    Serial.print(F("Antenna delay: ")); Serial.println(ANTENNA_DELAY);
+    Serial.print(F("Tag: ")); Serial.println(TAG_INDEX);
+
+    DW1000Ng::attachSentHandler(handleSent);
+
+    Serial.println(F("Blinking...\n"));
+    displayStatus("TDOA TAG", "Blinking...");
+
+    // tags powered up together still drift apart
+    randomSeed(micros() ^ TAG_INDEX);
+    nextBlinkAt = millis();
+    scheduleBlink();
+}
+
+void loop() {
+    static uint32_t lastReport = 0;
+    static boolean sending = false;
+
+#if DW1000NG_SPI_PROFILER
+    // 'p' on the serial console dumps the SPI profile
+    if (Serial.available() && Serial.read() == 'p') {
+        SPIporting::dumpProfile();
+    }
+#endif
+
+    if (sentAck) {
+        sentAck = false;
+        sending = false;
+        DW1000Ng::clearTransmitStatus();
+        blinkCount++;
+    }
+
+    if ((int32_t)(millis() - nextBlinkAt) >= 0) {
+        if (sending) {
+            // the previous blink never completed
+            busyCount++;
+            DW1000Ng::forceTRxOff();
+        }
+        DW1000NgRTLS::transmitTwrShortBlink();
+        sending = true;
+        scheduleBlink();
+    }
+
+    if (millis() - lastReport >= 10000) {
+        lastReport = millis();
+        Serial.print(F("["));
+        Serial.print(millis() / 1000);
+        Serial.print(F("s] blinks:"));
+        Serial.print(blinkCount);
+        Serial.print(F(" busy:"));
+        Serial.println(busyCount);
+    }
+}
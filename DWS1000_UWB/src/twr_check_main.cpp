@@ -0,0 +1,245 @@
+/**
+ * DS-TWR Kernel Check — DW1000-ng (host only)
+ *
+ * Cross-checks DW1000NgRanging::computeTofAsymmetric() against a 128-bit
+ * integer reference over randomized asymmetric DS-TWR exchanges:
+ *   - random 40-bit start times, so a share of the exchanges wraps the
+ *     counter between messages, plus a set forced across the wrap
+ *   - reply times from 200 us to 10 s, clock offsets up to +-20 ppm,
+ *     times of flight up to 1 km, timestamps quantized to whole ticks
+ * The kernel must match the reference bit for bit. The pre-change double
+ * implementation (32-bit truncated timestamps) is reproduced and its error
+ * against the reference reported alongside, with the time per call of each.
+ *
+ * computeTofSingleSided() is checked against the true time of flight, with
+ * the clock offset the carrier integrator would report (rounded to 1 ppb)
+ * and, for comparison, with none.
+ *
+ * Exits 0 when every exchange matches and every single-sided one is within
+ * SS_TOLERANCE_TICKS, 1 otherwise.
+ */
+
+#include <Arduino.h>
+#include <DW1000NgConstants.hpp>
+#include <DW1000NgRanging.hpp>
+
+#define CHECK_EXCHANGES 200000
+#define WRAP_EXCHANGES 20000
+#define SPEED_ITERATIONS 100000
+#define SS_EXCHANGES 200000
+#define SS_TOLERANCE_TICKS 2.0
+
+const uint64_t TICKS_PER_SECOND = 63897600000ULL;
+const double MAX_TOF_TICKS = 1000.0 * DISTANCE_OF_RADIO_INV;
+
+struct Exchange {
+    uint64_t pollSent, pollReceived, pollAckSent, pollAckReceived, rangeSent, rangeReceived;
+};
+
+uint64_t rngState = 0x9E3779B97F4A7C15ULL;
+
+uint64_t nextRandom() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+double uniform(double lo, double hi) {
+    return lo + (hi - lo) * (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// log-uniform, so short and long reply times are equally represented
+double logUniform(double lo, double hi) {
+    return lo * pow(hi / lo, uniform(0, 1));
+}
+
+uint64_t toTimestamp(double ticks) {
+    return static_cast<uint64_t>(llround(ticks)) & static_cast<uint64_t>(TIME_MAX);
+}
+
+// Tag (initiator) and anchor (responder) clocks, each with its own start and offset
+Exchange randomExchange(boolean forceWrap) {
+    double tof = uniform(0, MAX_TOF_TICKS);
+    double reply1 = logUniform(0.0002, 10.0) * TICKS_PER_SECOND;
+    double reply2 = logUniform(0.0002, 10.0) * TICKS_PER_SECOND;
+    double tagRate = 1.0 + uniform(-20e-6, 20e-6);
+    double anchorRate = 1.0 + uniform(-20e-6, 20e-6);
+    double span = 2 * tof + reply1 + reply2;
+    double tagStart, anchorStart;
+    if (forceWrap) {
+        // both clocks overflow somewhere inside the exchange
+        tagStart = TIME_OVERFLOW - uniform(0, span);
+        anchorStart = TIME_OVERFLOW - uniform(0, span);
+    } else {
+        tagStart = static_cast<double>(nextRandom() & TIME_MAX);
+        anchorStart = static_cast<double>(nextRandom() & TIME_MAX);
+    }
+
+    // true times, tag poll sent at 0
+    double pollReceived = tof;
+    double pollAckSent = pollReceived + reply1;
+    double pollAckReceived = pollAckSent + tof;
+    double rangeSent = pollAckReceived + reply2;
+    double rangeReceived = rangeSent + tof;
+
+    Exchange e;
+    e.pollSent = toTimestamp(tagStart);
+    e.pollReceived = toTimestamp(anchorStart + pollReceived * anchorRate);
+    e.pollAckSent = toTimestamp(anchorStart + pollAckSent * anchorRate);
+    e.pollAckReceived = toTimestamp(tagStart + pollAckReceived * tagRate);
+    e.rangeSent = toTimestamp(tagStart + rangeSent * tagRate);
+    e.rangeReceived = toTimestamp(anchorStart + rangeReceived * anchorRate);
+    return e;
+}
+
+// Exact reference: 128-bit products and a rounded 128-bit division
+int64_t referenceTof(const Exchange &e) {
+    typedef __int128 int128;
+    const int128 mask = TIME_MAX;
+    int128 round1 = (static_cast<int128>(e.pollAckReceived) - e.pollSent) & mask;
+    int128 reply1 = (static_cast<int128>(e.pollAckSent) - e.pollReceived) & mask;
+    int128 round2 = (static_cast<int128>(e.rangeReceived) - e.pollAckSent) & mask;
+    int128 reply2 = (static_cast<int128>(e.rangeSent) - e.pollAckReceived) & mask;
+    int128 numerator = (round1 * round2 - reply1 * reply2) << DW1000NgRanging::TOF_FRACTIONAL_BITS;
+    int128 denominator = round1 + round2 + reply1 + reply2;
+    int128 magnitude = numerator < 0 ? -numerator : numerator;
+    int128 tof = (magnitude + denominator / 2) / denominator;
+    return static_cast<int64_t>(numerator < 0 ? -tof : tof);
+}
+
+// Pre-change double implementation, kept here as the baseline (result in ticks)
+double legacyTof(const Exchange &e) {
+    uint32_t pollSent = static_cast<uint32_t>(e.pollSent);
+    uint32_t pollReceived = static_cast<uint32_t>(e.pollReceived);
+    uint32_t pollAckSent = static_cast<uint32_t>(e.pollAckSent);
+    uint32_t pollAckReceived = static_cast<uint32_t>(e.pollAckReceived);
+    uint32_t rangeSent = static_cast<uint32_t>(e.rangeSent);
+    uint32_t rangeReceived = static_cast<uint32_t>(e.rangeReceived);
+    double round1 = static_cast<double>(pollAckReceived - pollSent);
+    double reply1 = static_cast<double>(pollAckSent - pollReceived);
+    double round2 = static_cast<double>(rangeReceived - pollAckSent);
+    double reply2 = static_cast<double>(rangeSent - pollAckReceived);
+    return static_cast<double>(static_cast<int64_t>((round1 * round2 - reply1 * reply2) / (round1 + round2 + reply1 + reply2)));
+}
+
+struct CheckStats {
+    uint32_t exchanges;
+    uint32_t mismatches;
+    uint32_t wrapped;
+    double legacyMaxError;
+    uint32_t legacyOver1m;
+};
+
+// either clock overflowed between two of its own timestamps
+boolean wraps(const Exchange &e) {
+    return e.pollAckReceived < e.pollSent || e.rangeSent < e.pollAckReceived ||
+           e.pollAckSent < e.pollReceived || e.rangeReceived < e.pollAckSent;
+}
+
+void runCheck(const __FlashStringHelper *name, uint32_t count, boolean forceWrap) {
+    CheckStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (uint32_t i = 0; i < count; i++) {
+        Exchange e = randomExchange(forceWrap);
+        int64_t reference = referenceTof(e);
+        int32_t tof = DW1000NgRanging::computeTofAsymmetric(
+            e.pollSent, e.pollReceived, e.pollAckSent, e.pollAckReceived, e.rangeSent, e.rangeReceived);
+        stats.exchanges++;
+        if (wraps(e)) stats.wrapped++;
+        if (tof != reference) {
+            if (stats.mismatches < 5) {
+                Serial.print(F("  mismatch: kernel "));
+                Serial.print(tof);
+                Serial.print(F(" reference "));
+                Serial.println((long long)reference);
+            }
+            stats.mismatches++;
+        }
+        double legacyError = fabs(legacyTof(e) - reference / 256.0);
+        if (legacyError > stats.legacyMaxError) stats.legacyMaxError = legacyError;
+        if (legacyError * DISTANCE_OF_RADIO > 1.0) stats.legacyOver1m++;
+    }
+    Serial.print(name);
+    Serial.print(F("  exchanges ")); Serial.print(stats.exchanges);
+    Serial.print(F("  wrapped ")); Serial.print(stats.wrapped);
+    Serial.print(F("  mismatches ")); Serial.print(stats.mismatches);
+    Serial.print(F("  | legacy max err ")); Serial.print(stats.legacyMaxError, 2);
+    Serial.print(F(" ticks, >1 m off ")); Serial.println(stats.legacyOver1m);
+    if (stats.mismatches > 0) {
+        exit(1);
+    }
+}
+
+// POLL and response of SS-TWR, reply times from 200 us to 20 ms
+void runSingleSidedCheck() {
+    double maxError = 0;
+    double maxUncompensated = 0;
+    for (uint32_t i = 0; i < SS_EXCHANGES; i++) {
+        double tof = uniform(0, MAX_TOF_TICKS);
+        double reply = logUniform(0.0002, 0.02) * TICKS_PER_SECOND;
+        double tagRate = 1.0 + uniform(-20e-6, 20e-6);
+        double anchorRate = 1.0 + uniform(-20e-6, 20e-6);
+        double tagStart = static_cast<double>(nextRandom() & TIME_MAX);
+        double anchorStart = static_cast<double>(nextRandom() & TIME_MAX);
+
+        uint64_t pollSent = toTimestamp(tagStart);
+        uint64_t pollReceived = toTimestamp(anchorStart + tof * anchorRate);
+        uint64_t responseSent = toTimestamp(anchorStart + (tof + reply) * anchorRate);
+        uint64_t responseReceived = toTimestamp(tagStart + (2 * tof + reply) * tagRate);
+        // the tag measures in its own ticks: true TOF scaled by its rate
+        double expected = tof * tagRate;
+        int32_t offsetPpb = static_cast<int32_t>(llround((anchorRate / tagRate - 1.0) * 1e9));
+
+        double error = fabs(DW1000NgRanging::computeTofSingleSided(
+            pollSent, pollReceived, responseSent, responseReceived, offsetPpb) / 256.0 - expected);
+        double uncompensated = fabs(DW1000NgRanging::computeTofSingleSided(
+            pollSent, pollReceived, responseSent, responseReceived, 0) / 256.0 - expected);
+        if (error > maxError) maxError = error;
+        if (uncompensated > maxUncompensated) maxUncompensated = uncompensated;
+    }
+    Serial.print(F("single-sided  exchanges ")); Serial.print(SS_EXCHANGES);
+    Serial.print(F("  max err ")); Serial.print(maxError, 2);
+    Serial.print(F(" ticks | without offset ")); Serial.print(maxUncompensated, 0);
+    Serial.println(F(" ticks"));
+    if (maxError > SS_TOLERANCE_TICKS) {
+        exit(1);
+    }
+}
+
+volatile int32_t sinkTof;
+volatile double sinkLegacy;
+
+void runSpeed() {
+    Exchange e = randomExchange(false);
+    uint32_t start = micros();
+    for (uint32_t i = 0; i < SPEED_ITERATIONS; i++) {
+        e.rangeReceived++;
+        sinkTof = DW1000NgRanging::computeTofAsymmetric(
+            e.pollSent, e.pollReceived, e.pollAckSent, e.pollAckReceived, e.rangeSent, e.rangeReceived);
+    }
+    uint32_t kernel = micros() - start;
+    start = micros();
+    for (uint32_t i = 0; i < SPEED_ITERATIONS; i++) {
+        e.rangeReceived++;
+        sinkLegacy = legacyTof(e);
+    }
+    uint32_t legacy = micros() - start;
+    Serial.print(F("time per call, integer kernel: "));
+    Serial.print((float)kernel * 1000 / SPEED_ITERATIONS, 1);
+    Serial.print(F(" ns  legacy double: "));
+    Serial.print((float)legacy * 1000 / SPEED_ITERATIONS, 1);
+    Serial.println(F(" ns"));
+}
+
+void setup() {
+    Serial.println(F("\n=== DS-TWR Kernel Check (DW1000-ng, host) ==="));
+    runCheck(F("random start  "), CHECK_EXCHANGES, false);
+    runCheck(F("forced wrap   "), WRAP_EXCHANGES, true);
+    runSingleSidedCheck();
+    runSpeed();
+    exit(0);
+}
+
+void loop() {
+}
@@ -31,6 +31,7 @@
 #include <SPI.h>
 #include <EEPROM.h>
 #include "DW1000Ranging.h"
+#include <Multilateration.hpp>
 #include "config.h"
 
 // ============================================================================
@@ -353,66 +354,26 @@ void inactiveDevice(DW1000Device* device) {
 // ============================================================================
 
 void updatePosition() {
-    // For now, implement simple 2D trilateration with coordinator as reference
-    // Need at least 3 valid ranges for positioning
-
-    int validRangeCount = 0;
+    // 2D weighted least squares over every anchor with a valid range,
+    // tag height pinned (lib/Multilateration)
+    Multilateration::AnchorRange anchors[MAX_NODES];
+    uint8_t count = 0;
     for (int i = 0; i < MAX_NODES; i++) {
         if (ranges[i].valid && anchorPositions[i].valid) {
-            validRangeCount++;
-        }
-    }
-
-    if (validRangeCount < 3) {
-        // Not enough anchors for trilateration
-        myPosition.valid = false;
-        return;
-    }
-
-    // Simple 2D trilateration using first 3 valid anchors
-    // In a real implementation, use least-squares with all available anchors
-
-    int anchorIdx[3] = {-1, -1, -1};
-    int count = 0;
-    for (int i = 0; i < MAX_NODES && count < 3; i++) {
-        if (ranges[i].valid && anchorPositions[i].valid) {
-            anchorIdx[count++] = i;
+            anchors[count].x = anchorPositions[i].x;
+            anchors[count].y = anchorPositions[i].y;
+            anchors[count].z = anchorPositions[i].z;
+            anchors[count].range = ranges[i].distance;
+            anchors[count].rxPower = ranges[i].rxPower;
+            count++;
         }
     }
 
-    if (count < 3) {
-        myPosition.valid = false;
-        return;
-    }
-
-    // Get anchor positions and ranges
-    float x1 = anchorPositions[anchorIdx[0]].x;
-    float y1 = anchorPositions[anchorIdx[0]].y;
-    float r1 = ranges[anchorIdx[0]].distance;
-
-    float x2 = anchorPositions[anchorIdx[1]].x;
-    float y2 = anchorPositions[anchorIdx[1]].y;
-    float r2 = ranges[anchorIdx[1]].distance;
-
-    float x3 = anchorPositions[anchorIdx[2]].x;
-    float y3 = anchorPositions[anchorIdx[2]].y;
-    float r3 = ranges[anchorIdx[2]].distance;
-
-    // Trilateration equations
-    float A = 2 * (x2 - x1);
-    float B = 2 * (y2 - y1);
-    float C = r1*r1 - r2*r2 - x1*x1 + x2*x2 - y1*y1 + y2*y2;
-
-    float D = 2 * (x3 - x2);
-    float E = 2 * (y3 - y2);
-    float F = r2*r2 - r3*r3 - x2*x2 + x3*x3 - y2*y2 + y3*y3;
-
-    float denom = (E*A - B*D);
-
-    if (abs(denom) > 0.001) {
-        myPosition.x = (C*E - F*B) / denom;
-        myPosition.y = (C*D - A*F) / (B*D - A*E);
-        myPosition.z = DEFAULT_TAG_HEIGHT;
+    Multilateration::Solution solution;
+    if (Multilateration::solve(anchors, count, 2, DEFAULT_TAG_HEIGHT, solution)) {
+        myPosition.x = solution.x;
+        myPosition.y = solution.y;
+        myPosition.z = solution.z;
         myPosition.valid = true;
         myPosition.timestamp = millis();
 
@@ -10,6 +10,7 @@
 #   ./dev.sh calibrate            Flash calibration firmware to both devices
 #   ./dev.sh envs                 List available PIO environments
 #   ./dev.sh ports                List connected serial ports
+#   ./dev.sh sim [ARGS]           Build + run the swarm simulator (host)
 
 set -e
 SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
@@ -35,13 +36,33 @@ usage() {
     echo "  calibrate            Flash calibration firmware to both"
     echo "  envs                 List PIO environments"
     echo "  ports                List connected serial ports"
+    echo "  sim [ARGS]           Build + run the swarm simulator (--help for options)"
     echo ""
     echo "Environments:"
     echo "  uno_anchor           Anchor/responder (flash to ACM0)"
     echo "  uno_tag              Tag/initiator (flash to ACM1, default)"
+    echo "  uno_multi_tag        One-to-many DS-TWR tag, up to 16 anchors"
+    echo "  uno_multi_anchor     One-to-many anchor (-D ANCHOR_INDEX=n per board)"
+    echo "  uno_tdoa_anchor      TDOA anchor, 0 is the clock reference (-D ANCHOR_INDEX=n)"
+    echo "  uno_tdoa_tag         TDOA tag, blinks only (-D TAG_INDEX=n)"
+    echo "  uno_tdma_coordinator TDMA superframe beacon + SS-TWR responder"
+    echo "  uno_tdma_node        TDMA node, joins a slot and ranges in it"
     echo "  uno_calibration      Antenna delay calibration + OLED"
+    echo "  uno_spi_benchmark    SPI transactions/s, legacy vs buffered transfers"
+    echo "  uno_signal_benchmark Q8.8 vs float rx/fp power: accuracy and us per call"
+    echo "  uno_multilateration_benchmark  Position solvers: error per geometry, solves/s"
     echo "  uno_ng               DW1000-ng base (manual test files)"
     echo "  uno                  Legacy thotro library (deprecated)"
+    echo "  native_anchor/tag    Host builds against the emulated DW1000"
+    echo "  native_multi_tag/anchor  One-to-many DS-TWR against the emulator"
+    echo "  native_tdoa_anchor/tag   TDOA against the emulator (DW1000_EMU_POSITION)"
+    echo "  native_tdma_coordinator/node  TDMA superframe against the emulator"
+    echo "  native_isr_benchmark ISR time and SPI transactions per radio event"
+    echo "  native_signal_benchmark  Q8.8 rx/fp power accuracy against float log10"
+    echo "  native_multilateration_benchmark  Weighted LS multilateration vs 3-anchor closed form"
+    echo "  native_twr_check     Integer DS-TWR kernel vs 128-bit reference, wraparound"
+    echo "  native_swarm_sim     Discrete-event swarm simulator"
+    echo "  native_tdoa_solver   TDOA positions from the anchor logs"
 }
 
 cmd_build() {
@@ -123,6 +144,12 @@ cmd_ports() {
     ls /dev/ttyACM* /dev/ttyUSB* 2>/dev/null || echo "  (none found)"
 }
 
+cmd_sim() {
+    cd "$PROJECT_DIR"
+    pio run -e native_swarm_sim
+    .pio/build/native_swarm_sim/program "$@"
+}
+
 # Parse command
 case "${1:-}" in
     build)      cmd_build "$2" ;;
@@ -133,6 +160,7 @@ case "${1:-}" in
     calibrate)  cmd_calibrate ;;
     envs)       cmd_envs ;;
     ports)      cmd_ports ;;
+    sim)        shift; cmd_sim "$@" ;;
     -h|--help|help|"")  usage ;;
     *)
         echo "Unknown command: $1"